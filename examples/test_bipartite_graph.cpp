@@ -0,0 +1,245 @@
+/***************************************************************************
+ * Unit Tests: Bipartite Graph
+ *
+ * Tests the structural analysis of constraint systems: maximum matching,
+ * the coarse Dulmage-Mendelsohn parts, the square blocks sorted by level,
+ * and their use by the structural diagnosis and the block solve of System.
+ ***************************************************************************/
+
+#include "../src/GCS.h"
+#include "../src/BipartiteGraph.h"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+using namespace GCS;
+
+static VEC_I sorted(VEC_I v)
+{
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+void testBlockTriangular() {
+    std::cout << "=== Unit Test: Block-Triangular System ===" << std::endl;
+
+    // r0: c0             block {r0}      level 0
+    // r1: c1 c2          block {r1, r2}  level 0
+    // r2: c1 c2
+    // r3: c0 c1 c3       block {r3}      level 1
+    // r4: c3 c4          block {r4}      level 2
+    BipartiteGraph graph(5, 5);
+    graph.addEdge(0, 0);
+    graph.addEdge(1, 1); graph.addEdge(1, 2);
+    graph.addEdge(2, 1); graph.addEdge(2, 2);
+    graph.addEdge(3, 0); graph.addEdge(3, 1); graph.addEdge(3, 3);
+    graph.addEdge(4, 3); graph.addEdge(4, 4);
+
+    int rank = graph.maximumMatching();
+    assert(rank == 5 && "The square system should be fully matched");
+    for (int row=0; row < 5; row++) {
+        int col = graph.rowMatch(row);
+        assert(col != -1 && graph.colMatch(col) == row && "The matching should be consistent");
+    }
+    std::cout << "[PASS] Maximum matching of a regular system" << std::endl;
+
+    std::vector<bool> overRows, overCols, underRows, underCols;
+    graph.overdeterminedPart(overRows, overCols);
+    graph.underdeterminedPart(underRows, underCols);
+    for (int i=0; i < 5; i++)
+        assert(!overRows[i] && !overCols[i] && !underRows[i] && !underCols[i] &&
+               "A regular system has no over- or under-determined part");
+    std::cout << "[PASS] No over- or under-determined part" << std::endl;
+
+    std::vector<bool> subset(5, true);
+    std::vector<VEC_I> blocks;
+    VEC_I levels;
+    graph.squareBlocks(subset, blocks, levels);
+    assert(blocks.size() == 4 && levels.size() == 4 && "The system should have four blocks");
+
+    VEC_I blockOf(5, -1);
+    for (std::size_t k=0; k < blocks.size(); k++) {
+        if (k > 0)
+            assert(levels[k-1] <= levels[k] && "The blocks should be sorted by level");
+        for (std::size_t i=0; i < blocks[k].size(); i++)
+            blockOf[blocks[k][i]] = int(k);
+    }
+    assert(blockOf[1] == blockOf[2] && "The coupled rows should form one block");
+    assert(sorted(blocks[blockOf[1]]) == VEC_I({1, 2}) && "The coupled block should be square");
+    assert(levels[blockOf[0]] == 0 && levels[blockOf[1]] == 0 && "The independent blocks should be on level 0");
+    assert(levels[blockOf[3]] == 1 && "The block depending on level 0 should be on level 1");
+    assert(levels[blockOf[4]] == 2 && "The block depending on level 1 should be on level 2");
+
+    // a block only reads the columns matched in blocks of lower levels
+    for (int row=0; row < 5; row++) {
+        const VEC_I &cols = graph.rowAdjacency(row);
+        for (std::size_t j=0; j < cols.size(); j++) {
+            int mate = graph.colMatch(cols[j]);
+            assert((blockOf[mate] == blockOf[row] || levels[blockOf[mate]] < levels[blockOf[row]]) &&
+                   "A block should only depend on blocks of lower levels");
+        }
+    }
+    std::cout << "[PASS] Square blocks sorted by level" << std::endl;
+
+    // the blocks of a subset only contain its rows
+    subset[4] = false;
+    graph.squareBlocks(subset, blocks, levels);
+    assert(blocks.size() == 3 && "The row outside of the subset should be dropped");
+    for (std::size_t k=0; k < blocks.size(); k++)
+        for (std::size_t i=0; i < blocks[k].size(); i++)
+            assert(blocks[k][i] != 4 && "The row outside of the subset should be dropped");
+    std::cout << "[PASS] Square blocks of a subset" << std::endl;
+}
+
+void testOverdeterminedSubset() {
+    std::cout << "\n=== Unit Test: Over-Determined Subset ===" << std::endl;
+
+    // r0 and r1 both only fix c0, r2 and r3 fix c1 and c2, c3 is only in r4 with c2
+    // and c4 is in no row
+    BipartiteGraph graph(5, 5);
+    graph.addEdge(0, 0);
+    graph.addEdge(1, 0);
+    graph.addEdge(2, 1); graph.addEdge(2, 2);
+    graph.addEdge(3, 2);
+    graph.addEdge(4, 2); graph.addEdge(4, 3);
+
+    int rank = graph.maximumMatching();
+    assert(rank == 4 && "One of the rows fixing c0 should be left unmatched");
+
+    std::vector<bool> overRows, overCols;
+    graph.overdeterminedPart(overRows, overCols);
+    assert(overRows[0] && overRows[1] && overCols[0] && "The rows fixing c0 should be over-determined");
+    assert(!overRows[2] && !overRows[3] && !overRows[4] && "The other rows should not be over-determined");
+    for (int col=1; col < 5; col++)
+        assert(!overCols[col] && "Only c0 should be over-determined");
+
+    std::vector<bool> underRows, underCols;
+    graph.underdeterminedPart(underRows, underCols);
+    assert(underCols[4] && "The column in no row should be under-determined");
+    assert(!underRows[0] && !underRows[1] && !underCols[0] && "The over-determined part should not be under-determined");
+    std::cout << "[PASS] Over- and under-determined parts" << std::endl;
+}
+
+void testDiagnoseStructure() {
+    std::cout << "\n=== Unit Test: Structural Diagnosis ===" << std::endl;
+
+    // a segment with a fixed start, a length and a doubly given direction,
+    // and a free point
+    double values[6] = { 0., 0., 3., 1., 5., 5. };
+    Point p, q, r;
+    p.x = &values[0]; p.y = &values[1];
+    q.x = &values[2]; q.y = &values[3];
+    r.x = &values[4]; r.y = &values[5];
+    Line l;
+    l.p1 = p; l.p2 = q;
+    double zero = 0., length = 4.;
+
+    System system;
+    system.addConstraintCoordinateX(p, &zero, 1);
+    system.addConstraintCoordinateY(p, &zero, 2);
+    system.addConstraintP2PDistance(p, q, &length, 3);
+    system.addConstraintHorizontal(l, 4);
+    system.addConstraintHorizontal(l, 5);
+    VEC_pD params;
+    for (int i=0; i < 6; i++)
+        params.push_back(&values[i]);
+    system.declareUnknowns(params);
+
+    int dofs = system.diagnoseStructure();
+    assert(dofs == 2 && "Only the free point should be left free");
+    VEC_I conflicting;
+    system.getStructurallyConflicting(conflicting);
+    // the start's y and the two directions are three equations on the two y coordinates
+    const int over[3] = { 2, 4, 5 };
+    for (int i=0; i < 3; i++)
+        assert(std::find(conflicting.begin(), conflicting.end(), over[i]) != conflicting.end() &&
+               "The duplicated direction should be structurally conflicting");
+    assert(std::find(conflicting.begin(), conflicting.end(), 1) == conflicting.end() &&
+           std::find(conflicting.begin(), conflicting.end(), 3) == conflicting.end() &&
+           "The start's x and the length should not be structurally conflicting");
+    std::cout << "[PASS] Structural dofs and conflicting tags" << std::endl;
+}
+
+void testParallelBlocks() {
+    std::cout << "\n=== Unit Test: Parallel Blocks ===" << std::endl;
+
+    // a rectangle with a fixed corner: the coordinates of the corners are blocks of
+    // their own, several of which share a level
+    double solved[2][16];
+    for (int run=0; run < 2; run++) {
+        const double corners[4][2] = { {0.,0.}, {4.2,0.3}, {3.9,3.1}, {-0.2,2.8} };
+        double values[16];
+        Line lines[4];
+        for (int i=0; i < 4; i++) {
+            int j = (i+1) % 4;
+            values[4*i] = corners[i][0];
+            values[4*i+1] = corners[i][1];
+            values[4*i+2] = corners[j][0];
+            values[4*i+3] = corners[j][1];
+            lines[i].p1.x = &values[4*i];
+            lines[i].p1.y = &values[4*i+1];
+            lines[i].p2.x = &values[4*i+2];
+            lines[i].p2.y = &values[4*i+3];
+        }
+        double width = 4., height = 3., zero = 0.;
+
+        System system;
+        system.analyticSolving = false;
+        system.blockDecomposition = (run == 1);
+        system.blockParallelThreshold = 0; // every level with several blocks runs in parallel
+        int tag = 1;
+        for (int i=0; i < 4; i++)
+            system.addConstraintP2PCoincident(lines[i].p2, lines[(i+1) % 4].p1, tag++);
+        system.addConstraintHorizontal(lines[0], tag++);
+        system.addConstraintVertical(lines[1], tag++);
+        system.addConstraintHorizontal(lines[2], tag++);
+        system.addConstraintVertical(lines[3], tag++);
+        system.addConstraintCoordinateX(lines[0].p1, &zero, tag++);
+        system.addConstraintCoordinateY(lines[0].p1, &zero, tag++);
+        system.addConstraintP2PDistance(lines[0].p1, lines[0].p2, &width, tag++);
+        system.addConstraintP2PDistance(lines[1].p1, lines[1].p2, &height, tag++);
+        VEC_pD params;
+        for (int i=0; i < 16; i++)
+            params.push_back(&values[i]);
+        system.declareUnknowns(params);
+        system.initSolution();
+
+        // solved twice, so that the pool is reused
+        for (int k=0; k < 2; k++) {
+            int res = system.solve();
+            assert(res == Success && "The rectangle should be solved");
+        }
+        system.applySolution();
+        for (int i=0; i < 16; i++)
+            solved[run][i] = values[i];
+    }
+
+    for (int i=0; i < 16; i++)
+        assert(std::abs(solved[0][i] - solved[1][i]) < 1e-8 &&
+               "The block solve should find the solution of the whole component");
+    assert(std::abs(solved[1][2] - 4.) < 1e-8 && std::abs(solved[1][7] - 3.) < 1e-8 &&
+           "The rectangle should have the given width and height");
+    std::cout << "[PASS] Blocks solved in parallel on the thread pool" << std::endl;
+}
+
+int main() {
+    std::cout << "========================================" << std::endl;
+    std::cout << "     Unit Tests: Bipartite Graph       " << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    try {
+        testBlockTriangular();
+        testOverdeterminedSubset();
+        testDiagnoseStructure();
+        testParallelBlocks();
+
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "     ALL BIPARTITE GRAPH TESTS PASSED!  " << std::endl;
+        std::cout << "========================================" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\nX TEST FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,269 @@
+/***************************************************************************
+ * Unit Tests: B-Spline
+ *
+ * Tests the evaluation of rational B-splines (basis, flattened knots and
+ * the derivatives on u, on the poles and on the weights) of clamped and
+ * periodic splines, and solves point on spline and tangency constraints.
+ ***************************************************************************/
+
+#include "../src/GCS.h"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+using namespace GCS;
+
+// A cubic spline of five poles, clamped or periodic, with its own storage
+struct Spline {
+    std::vector<double> poles, weights, knots;
+    double ends[4];
+    BSpline spline;
+
+    explicit Spline(bool periodic)
+      : poles({ 0.,0.,  1.,2.,  2.5,-1.,  3.5,1.5,  5.,0.5 }),
+        weights({ 1., 0.7, 1.4, 0.9, 1.2 })
+    {
+        if (periodic) {
+            knots = { 0., 0.2, 0.5, 0.6, 0.8, 1. };
+            spline.mult = { 1, 1, 1, 1, 1, 1 };
+        }
+        else {
+            knots = { 0., 0.4, 1. };
+            spline.mult = { 4, 1, 4 };
+        }
+        spline.degree = 3;
+        spline.periodic = periodic;
+        for (int i=0; i < 5; i++) {
+            Point p;
+            p.x = &poles[2*i];
+            p.y = &poles[2*i+1];
+            spline.poles.push_back(p);
+            spline.weights.push_back(&weights[i]);
+        }
+        for (std::size_t i=0; i < knots.size(); i++)
+            spline.knots.push_back(&knots[i]);
+        ends[0] = ends[1] = ends[2] = ends[3] = 0.;
+        spline.start.x = &ends[0]; spline.start.y = &ends[1];
+        spline.end.x = &ends[2];   spline.end.y = &ends[3];
+    }
+};
+
+// Cox-de Boor recursion on a flat knot vector
+static double basis(const std::vector<double> &flat, int i, int p, double u)
+{
+    if (p == 0)
+        return (flat[i] <= u && u < flat[i+1]) ? 1. : 0.;
+    double value = 0.;
+    if (flat[i+p] > flat[i])
+        value += (u - flat[i]) / (flat[i+p] - flat[i]) * basis(flat, i, p-1, u);
+    if (flat[i+p+1] > flat[i+1])
+        value += (flat[i+p+1] - u) / (flat[i+p+1] - flat[i+1]) * basis(flat, i+1, p-1, u);
+    return value;
+}
+
+static bool near(double a, double b, double tolerance)
+{
+    return std::abs(a - b) <= tolerance * std::max(1., std::abs(b));
+}
+
+// d/du, d/dpole and d/dweight of the value and of the tangent against central
+// differences at u
+static void checkDerivatives(Spline &s, double u)
+{
+    const double h = 1e-6, tolerance = 1e-6;
+    BSpline &b = s.spline;
+
+    DeriVector2 value = b.Value(u, 1.);
+    DeriVector2 tangent = b.Tangent(u, 1.);
+    DeriVector2 plus = b.Value(u + h, 0.), minus = b.Value(u - h, 0.);
+    assert(near(value.dx, (plus.x - minus.x)/(2*h), tolerance) &&
+           near(value.dy, (plus.y - minus.y)/(2*h), tolerance) && "d/du of the value should match");
+    plus = b.Tangent(u + h, 0.);
+    minus = b.Tangent(u - h, 0.);
+    assert(near(tangent.x, value.dx, 1e-12) && near(tangent.y, value.dy, 1e-12) &&
+           "The tangent should be d/du of the value");
+    // the third derivative jumps at a knot, where the differences of the tangent are less exact
+    assert(near(tangent.dx, (plus.x - minus.x)/(2*h), 100*tolerance) &&
+           near(tangent.dy, (plus.y - minus.y)/(2*h), 100*tolerance) && "d/du of the tangent should match");
+
+    std::vector<double *> params;
+    for (int i=0; i < 5; i++) {
+        params.push_back(b.poles[i].x);
+        params.push_back(b.poles[i].y);
+        params.push_back(b.weights[i]);
+    }
+    for (std::size_t k=0; k < params.size(); k++) {
+        double *param = params[k];
+        DeriVector2 dvalue = b.Value(u, 0., param);
+        DeriVector2 dtangent = b.Tangent(u, 0., param);
+        double saved = *param;
+        *param = saved + h;
+        DeriVector2 valuePlus = b.Value(u, 0.), tangentPlus = b.Tangent(u, 0.);
+        *param = saved - h;
+        DeriVector2 valueMinus = b.Value(u, 0.), tangentMinus = b.Tangent(u, 0.);
+        *param = saved;
+        assert(near(dvalue.dx, (valuePlus.x - valueMinus.x)/(2*h), tolerance) &&
+               near(dvalue.dy, (valuePlus.y - valueMinus.y)/(2*h), tolerance) &&
+               "d/dpole and d/dweight of the value should match");
+        assert(near(dtangent.dx, (tangentPlus.x - tangentMinus.x)/(2*h), tolerance) &&
+               near(dtangent.dy, (tangentPlus.y - tangentMinus.y)/(2*h), tolerance) &&
+               "d/dpole and d/dweight of the tangent should match");
+    }
+}
+
+void testClamped() {
+    std::cout << "=== Unit Test: Clamped Spline ===" << std::endl;
+
+    Spline s(false);
+    BSpline &b = s.spline;
+
+    const std::vector<double> flat = { 0., 0., 0., 0., 0.4, 1., 1., 1., 1. };
+    const double us[6] = { 0., 0.13, 0.4, 0.55, 0.87, 0.999 };
+    for (int k=0; k < 6; k++) {
+        double ax = 0., ay = 0., w = 0.;
+        for (int i=0; i < 5; i++) {
+            double n = basis(flat, i, 3, us[k]) * s.weights[i];
+            ax += n * s.poles[2*i];
+            ay += n * s.poles[2*i+1];
+            w += n;
+        }
+        DeriVector2 value = b.Value(us[k], 0.);
+        assert(near(value.x, ax/w, 1e-12) && near(value.y, ay/w, 1e-12) &&
+               "The value should match the rational Cox-de Boor recursion");
+    }
+    DeriVector2 first = b.Value(0., 0.), last = b.Value(1., 0.);
+    assert(near(first.x, s.poles[0], 1e-12) && near(first.y, s.poles[1], 1e-12) &&
+           near(last.x, s.poles[8], 1e-12) && near(last.y, s.poles[9], 1e-12) &&
+           "A clamped spline should interpolate its end poles");
+    std::cout << "[PASS] Values of a clamped spline" << std::endl;
+
+    for (int k=0; k < 6; k++)
+        checkDerivatives(s, 0.01 + 0.98*us[k]);
+    std::cout << "[PASS] Derivatives on u, the poles and the weights" << std::endl;
+
+    // the cached basis follows a moved knot, at the same u
+    double before = b.Value(0.3, 0.).x;
+    s.knots[1] = 0.5;
+    Spline moved(false);
+    moved.knots[1] = 0.5;
+    double after = b.Value(0.3, 0.).x;
+    assert(after != before && near(after, moved.spline.Value(0.3, 0.).x, 1e-12) &&
+           "The basis should be updated when a knot moves");
+    std::cout << "[PASS] Basis updated on a moved knot" << std::endl;
+}
+
+void testPeriodic() {
+    std::cout << "\n=== Unit Test: Periodic Spline ===" << std::endl;
+
+    Spline s(true);
+    BSpline &b = s.spline;
+
+    const double us[5] = { 0.05, 0.3, 0.5, 0.71, 0.95 };
+    for (int k=0; k < 5; k++) {
+        DeriVector2 value = b.Value(us[k], 0.);
+        DeriVector2 next = b.Value(us[k] + 1., 0.), previous = b.Value(us[k] - 1., 0.);
+        assert(near(next.x, value.x, 1e-12) && near(next.y, value.y, 1e-12) &&
+               near(previous.x, value.x, 1e-12) && near(previous.y, value.y, 1e-12) &&
+               "The value should repeat after a period");
+    }
+    DeriVector2 first = b.Value(0., 1.), last = b.Value(1. - 1e-10, 1.);
+    assert(near(first.x, last.x, 1e-8) && near(first.y, last.y, 1e-8) &&
+           near(first.dx, last.dx, 1e-6) && near(first.dy, last.dy, 1e-6) &&
+           "The spline should be smooth across the seam");
+
+    // the poles are weighted averages: equal poles make a point
+    Spline point(true);
+    for (int i=0; i < 5; i++) {
+        point.poles[2*i] = 2.;
+        point.poles[2*i+1] = -3.;
+    }
+    for (int k=0; k < 5; k++) {
+        DeriVector2 value = point.spline.Value(us[k], 0.);
+        assert(near(value.x, 2., 1e-12) && near(value.y, -3., 1e-12) &&
+               "The basis should be a partition of unity");
+    }
+    std::cout << "[PASS] Values of a periodic spline" << std::endl;
+
+    for (int k=0; k < 5; k++)
+        checkDerivatives(s, us[k]);
+    checkDerivatives(s, 0.);  // across the seam
+    checkDerivatives(s, 1.3); // in the next period
+    std::cout << "[PASS] Derivatives on u, the poles and the weights" << std::endl;
+}
+
+void testSolve() {
+    std::cout << "\n=== Unit Test: Constraints on Splines ===" << std::endl;
+
+    for (int periodic=0; periodic < 2; periodic++) {
+        Spline s(periodic == 1);
+        BSpline &b = s.spline;
+
+        // a point on the spline at a given x
+        double values[8] = { 1.7, 0.3, 0.45 };
+        double x = 1.7;
+        Point p;
+        p.x = &values[0]; p.y = &values[1];
+        double *u = &values[2];
+
+        // a line through a fixed point and tangent to the spline near u0
+        double u0 = 0.62;
+        DeriVector2 c = b.Value(u0, 0.), t = b.Tangent(u0, 0.);
+        double origin[2] = { c.x - 0.5*t.x, c.y - 0.5*t.y };
+        values[3] = c.x + 0.3*t.x;
+        values[4] = c.y + 0.3*t.y + 0.2;
+        values[5] = u0 + 0.05;
+        double farX = values[3];
+        Line l;
+        l.p1.x = &origin[0]; l.p1.y = &origin[1];
+        l.p2.x = &values[3]; l.p2.y = &values[4];
+        double *v = &values[5];
+
+        System system;
+        system.addConstraintCoordinateX(p, &x, 1);
+        system.addConstraintPointOnBSpline(p, b, u, 2);
+        system.addConstraintCoordinateX(l.p2, &farX, 3);
+        system.addConstraintTangent(l, b, v, 4);
+        VEC_pD params;
+        for (int i=0; i < 6; i++)
+            params.push_back(&values[i]);
+        system.declareUnknowns(params);
+        system.initSolution();
+        int res = system.solve();
+        assert(res == Success && "The constraints on the spline should be solved");
+        system.applySolution();
+
+        DeriVector2 onSpline = b.Value(*u, 0.);
+        assert(std::abs(onSpline.x - x) < 1e-8 && std::abs(onSpline.y - values[1]) < 1e-8 &&
+               "The point should be on the spline");
+
+        double dx = values[3] - origin[0], dy = values[4] - origin[1];
+        double length = std::sqrt(dx*dx + dy*dy);
+        DeriVector2 touch = b.Value(*v, 0.), tangent = b.Tangent(*v, 0.);
+        double distance = (dx*(touch.y - origin[1]) - dy*(touch.x - origin[0])) / length;
+        double sine = (dx*tangent.y - dy*tangent.x) / (length * std::sqrt(tangent.x*tangent.x + tangent.y*tangent.y));
+        assert(std::abs(distance) < 1e-8 && std::abs(sine) < 1e-8 &&
+               "The line should touch the spline");
+    }
+    std::cout << "[PASS] Point on spline and tangent line solved" << std::endl;
+}
+
+int main() {
+    std::cout << "========================================" << std::endl;
+    std::cout << "        Unit Tests: B-Spline           " << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    try {
+        testClamped();
+        testPeriodic();
+        testSolve();
+
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "       ALL B-SPLINE TESTS PASSED!      " << std::endl;
+        std::cout << "========================================" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\nX TEST FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
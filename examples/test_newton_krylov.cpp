@@ -0,0 +1,141 @@
+/***************************************************************************
+ * Unit Tests: Newton-Krylov
+ *
+ * Solves a long chain of segments with the matrix free NewtonKrylov solver,
+ * with each of its preconditioners, and checks the solution against the
+ * closed form one.
+ ***************************************************************************/
+
+#include "../src/GCS.h"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+using namespace GCS;
+
+// A chain of links of given lengths and directions from a fixed origin, which
+// is started from a crumpled configuration
+struct Chain {
+    int size;
+    std::vector<double> values;
+    std::vector<double> lengths, angles;
+    double zero;
+    std::vector<Point> points;
+
+    explicit Chain(int size_)
+      : size(size_), values(2*(size_ + 1)), lengths(size_), angles(size_), zero(0.),
+        points(size_ + 1)
+    {
+        for (int i=0; i <= size; i++) {
+            values[2*i] = 0.9*i + 0.3*std::sin(1.7*i);
+            values[2*i+1] = 0.4*std::cos(2.3*i);
+            points[i].x = &values[2*i];
+            points[i].y = &values[2*i+1];
+        }
+        for (int i=0; i < size; i++) {
+            lengths[i] = 1. + 0.01*(i % 7);
+            angles[i] = 0.2*std::sin(0.1*i);
+        }
+    }
+
+    void addTo(System &system)
+    {
+        int tag = 1;
+        system.addConstraintCoordinateX(points[0], &zero, tag++);
+        system.addConstraintCoordinateY(points[0], &zero, tag++);
+        for (int i=0; i < size; i++) {
+            system.addConstraintP2PDistance(points[i], points[i+1], &lengths[i], tag++);
+            system.addConstraintP2PAngle(points[i], points[i+1], &angles[i], tag++);
+        }
+    }
+
+    VEC_pD unknowns()
+    {
+        VEC_pD params;
+        for (std::size_t i=0; i < values.size(); i++)
+            params.push_back(&values[i]);
+        return params;
+    }
+
+    double maxDeviation() const
+    {
+        double x = 0., y = 0., deviation = std::max(std::abs(values[0]), std::abs(values[1]));
+        for (int i=0; i < size; i++) {
+            x += lengths[i]*std::cos(angles[i]);
+            y += lengths[i]*std::sin(angles[i]);
+            deviation = std::max(deviation, std::abs(values[2*i+2] - x));
+            deviation = std::max(deviation, std::abs(values[2*i+3] - y));
+        }
+        return deviation;
+    }
+};
+
+void testChain() {
+    std::cout << "=== Unit Test: Chain ===" << std::endl;
+
+    const Preconditioner preconditioners[3] =
+        { BlockJacobiPreconditioner, NoPreconditioner, IncompleteCholeskyPreconditioner };
+    const char *names[3] = { "block-Jacobi", "none", "incomplete Cholesky" };
+    for (int k=0; k < 3; k++) {
+        Chain chain(200);
+        System system;
+        // the whole chain is solved as one subsystem by NewtonKrylov
+        system.blockDecomposition = false;
+        system.analyticSolving = false;
+        system.NK_preconditioner = preconditioners[k];
+        chain.addTo(system);
+        VEC_pD params = chain.unknowns();
+        system.declareUnknowns(params);
+        system.initSolution(NewtonKrylov);
+
+        int res = system.solve(true, NewtonKrylov);
+        assert(res == Success && "The chain should be solved");
+        system.applySolution();
+        assert(chain.maxDeviation() < 1e-8 && "The chain should reach the closed form solution");
+        std::cout << "[PASS] Chain of 200 links solved, preconditioner: " << names[k] << std::endl;
+    }
+}
+
+void testRepeatedSolve() {
+    std::cout << "\n=== Unit Test: Repeated Solve ===" << std::endl;
+
+    // the preconditioner is factored again by each solve, at its own start
+    Chain chain(50);
+    System system;
+    system.blockDecomposition = false;
+    system.analyticSolving = false;
+    chain.addTo(system);
+    VEC_pD params = chain.unknowns();
+    system.declareUnknowns(params);
+    system.initSolution(NewtonKrylov);
+
+    for (int k=0; k < 3; k++) {
+        for (int i=0; i < chain.size; i++)
+            chain.angles[i] = 0.2*std::sin(0.1*i) + 0.05*k;
+        int res = system.solve(true, NewtonKrylov);
+        assert(res == Success && "The chain should be solved for each set of angles");
+    }
+    system.applySolution();
+    assert(chain.maxDeviation() < 1e-8 && "The chain should reach the last angles");
+    std::cout << "[PASS] Chain solved again for new angles" << std::endl;
+}
+
+int main() {
+    std::cout << "========================================" << std::endl;
+    std::cout << "     Unit Tests: Newton-Krylov         " << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    try {
+        testChain();
+        testRepeatedSolve();
+
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "     ALL NEWTON-KRYLOV TESTS PASSED!    " << std::endl;
+        std::cout << "========================================" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\nX TEST FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
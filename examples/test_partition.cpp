@@ -0,0 +1,263 @@
+/***************************************************************************
+ * Unit Tests: Partition
+ *
+ * Tests that the decoupled components kept up to date by the union-find of
+ * System match the connected components computed from scratch, after edits
+ * that join and split components, after changes of the redundant constraints
+ * and after declaring other unknowns.
+ ***************************************************************************/
+
+#include "../src/GCS.h"
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <set>
+#include <deque>
+#include <algorithm>
+
+using namespace GCS;
+
+typedef std::set< std::set<double *> > Components;
+
+// The constraints of a system by their (unique) tags, with the parameters they read
+struct Model {
+    System system;
+    std::map<int, VEC_pD> constraints;
+    std::deque<double> differences; // does not move the values on growing
+    int nextTag;
+
+    Model() : nextTag(1) {}
+
+    // a difference that holds at the current values, so that a cycle of them is
+    // redundant rather than conflicting
+    int addDifference(double *param1, double *param2) {
+        differences.push_back(*param2 - *param1);
+        int tag = nextTag++;
+        system.addConstraintDifference(param1, param2, &differences.back(), tag);
+        constraints[tag] = { param1, param2 };
+        return tag;
+    }
+
+    int addCoordinateX(Point &p, double *x) {
+        int tag = nextTag++;
+        system.addConstraintCoordinateX(p, x, tag);
+        constraints[tag] = { p.x };
+        return tag;
+    }
+
+    void remove(int tag) {
+        system.clearByTag(tag);
+        constraints.erase(tag);
+    }
+};
+
+// The connected components of the unknowns through the constraints that are not redundant
+static Components fromScratch(const Model &model, const VEC_pD &unknowns)
+{
+    VEC_I redundant;
+    model.system.getRedundant(redundant);
+    std::set<int> redundantTags(redundant.begin(), redundant.end());
+
+    std::map<double *, double *> parent;
+    for (std::size_t i=0; i < unknowns.size(); i++)
+        parent[unknowns[i]] = unknowns[i];
+    struct {
+        std::map<double *, double *> *parent;
+        double *operator()(double *p) const {
+            while ((*parent)[p] != p)
+                p = (*parent)[p];
+            return p;
+        }
+    } root = { &parent };
+
+    for (std::map<int, VEC_pD>::const_iterator c=model.constraints.begin(); c != model.constraints.end(); ++c) {
+        if (redundantTags.count(c->first))
+            continue;
+        double *first = NULL;
+        for (std::size_t i=0; i < c->second.size(); i++) {
+            if (parent.count(c->second[i]) == 0)
+                continue;
+            double *r = root(c->second[i]);
+            if (!first)
+                first = r;
+            else
+                parent[r] = first;
+        }
+    }
+
+    std::map<double *, std::set<double *> > sets;
+    for (std::size_t i=0; i < unknowns.size(); i++)
+        sets[root(unknowns[i])].insert(unknowns[i]);
+    Components components;
+    for (std::map<double *, std::set<double *> >::const_iterator s=sets.begin(); s != sets.end(); ++s)
+        components.insert(s->second);
+    return components;
+}
+
+// initializes the system and compares its components with the ones from scratch
+static void check(Model &model, const VEC_pD &unknowns, const char *message)
+{
+    VEC_pD params(unknowns);
+    model.system.declareUnknowns(params);
+    model.system.initSolution();
+
+    std::vector<VEC_pD> plists;
+    model.system.getComponents(plists);
+    Components components;
+    for (std::size_t cid=0; cid < plists.size(); cid++)
+        if (!plists[cid].empty()) // constraints without unknowns are components of their own
+            components.insert(std::set<double *>(plists[cid].begin(), plists[cid].end()));
+    if (components != fromScratch(model, unknowns)) {
+        std::cerr << message << std::endl;
+        assert(false && "The components should match the ones computed from scratch");
+    }
+}
+
+void testJoinAndSplit() {
+    std::cout << "=== Unit Test: Join and Split ===" << std::endl;
+
+    double values[8] = { 0., 1., 2., 3., 4., 5., 6., 7. };
+    VEC_pD unknowns;
+    for (int i=0; i < 8; i++)
+        unknowns.push_back(&values[i]);
+
+    Model model;
+    int a = model.addDifference(&values[0], &values[1]);
+    int b = model.addDifference(&values[2], &values[3]);
+    model.addDifference(&values[4], &values[5]);
+    check(model, unknowns, "Three pairs");
+
+    int bridge = model.addDifference(&values[1], &values[2]);
+    check(model, unknowns, "Joined by a bridge");
+    model.addDifference(&values[3], &values[4]);
+    check(model, unknowns, "Joined into a chain");
+
+    model.remove(bridge);
+    check(model, unknowns, "Split at the bridge");
+    model.remove(a);
+    model.remove(b);
+    check(model, unknowns, "Split at both ends");
+    std::cout << "[PASS] Components joined and split by single edits" << std::endl;
+
+    // a deterministic random sequence of edits, with cycles that are redundant
+    unsigned int seed = 12345;
+    std::vector<int> tags;
+    for (int step=0; step < 200; step++) {
+        seed = seed*1103515245u + 12345u;
+        unsigned int r = (seed >> 16) & 0x7fff;
+        if (tags.empty() || r % 3 != 0) {
+            int i = int(r % 8), j = int((r / 8) % 8);
+            if (i == j)
+                j = (j + 1) % 8;
+            tags.push_back(model.addDifference(&values[i], &values[j]));
+        }
+        else {
+            std::size_t k = (r / 3) % tags.size();
+            model.remove(tags[k]);
+            tags.erase(tags.begin() + k);
+        }
+        if (step % 5 == 4)
+            check(model, unknowns, "Random sequence of edits");
+    }
+    std::cout << "[PASS] Components after a random sequence of edits" << std::endl;
+}
+
+void testRedundancy() {
+    std::cout << "\n=== Unit Test: Redundant Constraints ===" << std::endl;
+
+    // two fixed coordinates and their difference: one of the three is redundant,
+    // which either keeps the coordinates apart or joins them
+    double values[4] = { 0., 0., 1., 0. };
+    Point p, q;
+    p.x = &values[0]; p.y = &values[1];
+    q.x = &values[2]; q.y = &values[3];
+    double zero = 0., one = 1.;
+    VEC_pD unknowns(1, p.x);
+    unknowns.push_back(q.x);
+
+    Model model;
+    int fixP = model.addCoordinateX(p, &zero);
+    int fixQ = model.addCoordinateX(q, &one);
+    int difference = model.addDifference(p.x, q.x);
+    check(model, unknowns, "One of three redundant");
+
+    VEC_I redundant;
+    model.system.getRedundant(redundant);
+    assert(redundant.size() == 1 && "One of the three constraints should be redundant");
+    int wasRedundant = redundant[0];
+
+    // removing another one makes the redundant constraint a regular one again
+    int removed = (wasRedundant == difference) ? fixP : difference;
+    model.remove(removed);
+    check(model, unknowns, "Redundant becomes regular");
+    model.system.getRedundant(redundant);
+    assert(redundant.empty() && "No constraint should be redundant anymore");
+
+    // and adding it back makes one redundant again
+    if (removed == fixP)
+        model.addCoordinateX(p, &zero);
+    else
+        model.addDifference(p.x, q.x);
+    check(model, unknowns, "Regular becomes redundant");
+    model.system.getRedundant(redundant);
+    assert(redundant.size() == 1 && "One constraint should be redundant again");
+
+    model.remove(fixQ);
+    check(model, unknowns, "Redundant constraint removed");
+    std::cout << "[PASS] Components follow the redundant constraints" << std::endl;
+}
+
+void testOtherUnknowns() {
+    std::cout << "\n=== Unit Test: Other Unknowns ===" << std::endl;
+
+    double values[6] = { 0., 1., 2., 3., 4., 5. };
+    VEC_pD all;
+    for (int i=0; i < 6; i++)
+        all.push_back(&values[i]);
+
+    Model model;
+    model.addDifference(&values[0], &values[1]);
+    model.addDifference(&values[1], &values[2]);
+    model.addDifference(&values[3], &values[4]);
+    model.addDifference(&values[4], &values[5]);
+    model.addDifference(&values[2], &values[3]);
+    check(model, all, "All the unknowns");
+
+    // without the middle unknowns the chain falls apart
+    VEC_pD ends;
+    ends.push_back(&values[0]);
+    ends.push_back(&values[1]);
+    ends.push_back(&values[4]);
+    ends.push_back(&values[5]);
+    check(model, ends, "Fewer unknowns");
+
+    // an edit on the smaller set of unknowns
+    model.addDifference(&values[1], &values[4]);
+    check(model, ends, "Edit on fewer unknowns");
+
+    // unknowns in another order
+    VEC_pD reversed(all.rbegin(), all.rend());
+    check(model, reversed, "Reversed unknowns");
+    check(model, all, "All the unknowns again");
+    std::cout << "[PASS] Components after declaring other unknowns" << std::endl;
+}
+
+int main() {
+    std::cout << "========================================" << std::endl;
+    std::cout << "        Unit Tests: Partition          " << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    try {
+        testJoinAndSplit();
+        testRedundancy();
+        testOtherUnknowns();
+
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "       ALL PARTITION TESTS PASSED!     " << std::endl;
+        std::cout << "========================================" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\nX TEST FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
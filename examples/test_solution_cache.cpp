@@ -0,0 +1,138 @@
+/***************************************************************************
+ * Unit Tests: Solution Cache
+ *
+ * Tests the LRU cache of component solutions: lookups that only match the
+ * structure and inputs an entry was stored with, eviction of the least
+ * recently used entries, and the cache hits of System::solve.
+ ***************************************************************************/
+
+#include "../src/GCS.h"
+#include "../src/SolutionCache.h"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+
+using namespace GCS;
+
+void testLookup() {
+    std::cout << "=== Unit Test: Lookup ===" << std::endl;
+
+    SolutionCache cache;
+    cache.store(42, 7, VEC_D({1., 2.}), VEC_D({3., 4.}), 4);
+
+    const VEC_D *solution = cache.find(42, 7, VEC_D({1., 2.}));
+    assert(solution && *solution == VEC_D({3., 4.}) && "The stored solution should be found");
+    std::cout << "[PASS] Stored solution found" << std::endl;
+
+    // the same hash key for other values, or for another structure, is a collision
+    assert(!cache.find(42, 7, VEC_D({1., 2.5})) && "A key colliding with other inputs should be rejected");
+    assert(!cache.find(42, 7, VEC_D({1.})) && "A key colliding with other inputs should be rejected");
+    assert(!cache.find(42, 8, VEC_D({1., 2.})) && "A key colliding with another structure should be rejected");
+    assert(!cache.find(43, 7, VEC_D({1., 2.})) && "Another key should not be found");
+    std::cout << "[PASS] Colliding keys rejected" << std::endl;
+
+    // the colliding component replaces the entry of the key
+    cache.store(42, 8, VEC_D({5.}), VEC_D({6.}), 4);
+    assert(cache.size() == 1 && "A key should have a single entry");
+    assert(!cache.find(42, 7, VEC_D({1., 2.})) && "The replaced entry should be gone");
+    solution = cache.find(42, 8, VEC_D({5.}));
+    assert(solution && *solution == VEC_D({6.}) && "The replacing solution should be found");
+    std::cout << "[PASS] Entry of a key replaced" << std::endl;
+}
+
+void testEviction() {
+    std::cout << "\n=== Unit Test: LRU Eviction ===" << std::endl;
+
+    SolutionCache cache;
+    cache.store(1, 0, VEC_D({1.}), VEC_D({10.}), 2);
+    cache.store(2, 0, VEC_D({2.}), VEC_D({20.}), 2);
+    assert(cache.find(1, 0, VEC_D({1.})) && "The first entry should be found");
+    cache.store(3, 0, VEC_D({3.}), VEC_D({30.}), 2); // the second entry is the least recently used
+    assert(cache.size() == 2 && "The cache should be bounded");
+    assert(!cache.find(2, 0, VEC_D({2.})) && "The least recently used entry should be evicted");
+    assert(cache.find(1, 0, VEC_D({1.})) && cache.find(3, 0, VEC_D({3.})) &&
+           "The recently used entries should be kept");
+    std::cout << "[PASS] Least recently used entry evicted" << std::endl;
+
+    cache.store(4, 0, VEC_D({4.}), VEC_D({40.}), 1);
+    assert(cache.size() == 1 && cache.find(4, 0, VEC_D({4.})) && "A smaller capacity should drop the oldest entries");
+    cache.clear();
+    assert(cache.size() == 0 && !cache.find(4, 0, VEC_D({4.})) && "The cache should be cleared");
+    std::cout << "[PASS] Capacity reduced and cache cleared" << std::endl;
+}
+
+void testSystemHits() {
+    std::cout << "\n=== Unit Test: Cache Hits of a System ===" << std::endl;
+
+    // a segment with a fixed start and a given length and angle, solved for a few
+    // lengths from the same start values; once the solver may not iterate, only
+    // the cached lengths are solved
+    const double start[4] = { 0., 0., 2., 1. };
+    double values[4];
+    Point p, q;
+    p.x = &values[0]; p.y = &values[1];
+    q.x = &values[2]; q.y = &values[3];
+    double zero = 0., length = 1., angle = 0.5;
+
+    System system;
+    system.analyticSolving = false;
+    system.solutionCacheSize = 2;
+    system.addConstraintCoordinateX(p, &zero, 1);
+    system.addConstraintCoordinateY(p, &zero, 2);
+    system.addConstraintP2PDistance(p, q, &length, 3);
+    system.addConstraintP2PAngle(p, q, &angle, 4);
+    VEC_pD params;
+    for (int i=0; i < 4; i++)
+        params.push_back(&values[i]);
+    system.declareUnknowns(params);
+
+    const int iterations = system.maxIter;
+    auto solveFor = [&](double l, bool iterate) {
+        for (int i=0; i < 4; i++)
+            values[i] = start[i];
+        length = l;
+        system.maxIter = iterate ? iterations : 0;
+        system.initSolution();
+        int res = system.solve();
+        if (res == Success) {
+            system.applySolution();
+            assert(std::abs(std::hypot(values[2], values[3]) - l) < 1e-8 && "The solution should have the length");
+        }
+        return res == Success;
+    };
+
+    assert(!solveFor(3., false) && "A length that is not cached should need iterations");
+    assert(solveFor(3., true) && solveFor(4., true) && "The segment should be solved");
+    assert(solveFor(3., false) && "A cached length should be solved without iterations");
+    std::cout << "[PASS] Cached solution restored" << std::endl;
+
+    // 4 is the least recently used length now
+    assert(solveFor(5., true) && "The segment should be solved");
+    assert(!solveFor(4., false) && "The least recently used solution should be evicted");
+    assert(solveFor(3., false) && solveFor(5., false) && "The recently used solutions should be kept");
+    std::cout << "[PASS] Least recently used solution evicted" << std::endl;
+
+    system.clearSolutionCache();
+    assert(!solveFor(3., false) && "The cleared cache should not restore solutions");
+    std::cout << "[PASS] Solution cache cleared" << std::endl;
+}
+
+int main() {
+    std::cout << "========================================" << std::endl;
+    std::cout << "      Unit Tests: Solution Cache       " << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    try {
+        testLookup();
+        testEviction();
+        testSystemHits();
+
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "     ALL SOLUTION CACHE TESTS PASSED!   " << std::endl;
+        std::cout << "========================================" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\nX TEST FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
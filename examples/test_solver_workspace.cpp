@@ -0,0 +1,246 @@
+/***************************************************************************
+ * Unit Tests: Solver Workspace
+ *
+ * Counts the heap allocations of repeated solves of a warmed-up system:
+ * the solver buffers are kept by the subsystems, so that once the first
+ * solve has sized them, neither solve nor a drag update allocates.
+ ***************************************************************************/
+
+#include "../src/GCS.h"
+#include <iostream>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+using namespace GCS;
+
+// Counting allocator: every allocation is counted while countAllocations is set.
+// With glibc malloc itself is replaced, so that the buffers of Eigen, which are
+// allocated by malloc and not by operator new, are counted as well.
+static bool countAllocations = false;
+static long allocations = 0;
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(std::size_t size)
+{
+    if (countAllocations)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size)
+{
+    if (countAllocations)
+        allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, std::size_t size)
+{
+    if (countAllocations)
+        allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **ptr, std::size_t alignment, std::size_t size)
+{
+    if (countAllocations)
+        allocations++;
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size)
+{
+    if (countAllocations)
+        allocations++;
+    return __libc_memalign(alignment, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+}
+#else
+void *operator new(std::size_t size)
+{
+    if (countAllocations)
+        allocations++;
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+// A closed chain of four lines: a rectangle of given width and height with a
+// fixed corner, which leaves the corner opposite to it driven by width and height.
+struct Rectangle {
+    double values[16];
+    double width, height, zero;
+    Line lines[4];
+
+    Rectangle()
+      : width(4.), height(3.), zero(0.)
+    {
+        const double corners[4][2] = { {0.,0.}, {4.2,0.3}, {3.9,3.1}, {-0.2,2.8} };
+        for (int i=0; i < 4; i++) {
+            int j = (i+1) % 4;
+            values[4*i] = corners[i][0];
+            values[4*i+1] = corners[i][1];
+            values[4*i+2] = corners[j][0];
+            values[4*i+3] = corners[j][1];
+            lines[i].p1.x = &values[4*i];
+            lines[i].p1.y = &values[4*i+1];
+            lines[i].p2.x = &values[4*i+2];
+            lines[i].p2.y = &values[4*i+3];
+        }
+    }
+
+    void addTo(System &system)
+    {
+        int tag = 1;
+        for (int i=0; i < 4; i++)
+            system.addConstraintP2PCoincident(lines[i].p2, lines[(i+1) % 4].p1, tag++);
+        system.addConstraintHorizontal(lines[0], tag++);
+        system.addConstraintVertical(lines[1], tag++);
+        system.addConstraintHorizontal(lines[2], tag++);
+        system.addConstraintVertical(lines[3], tag++);
+        system.addConstraintCoordinateX(lines[0].p1, &zero, tag++);
+        system.addConstraintCoordinateY(lines[0].p1, &zero, tag++);
+        system.addConstraintP2PDistance(lines[0].p1, lines[0].p2, &width, tag++);
+        system.addConstraintP2PDistance(lines[1].p1, lines[1].p2, &height, tag++);
+    }
+
+    VEC_pD unknowns()
+    {
+        VEC_pD params;
+        for (int i=0; i < 16; i++)
+            params.push_back(&values[i]);
+        return params;
+    }
+};
+
+void testRepeatedSolves() {
+    std::cout << "=== Unit Test: Repeated Solves ===" << std::endl;
+
+    // NewtonKrylov with its default block-Jacobi preconditioner, the incomplete
+    // Cholesky one is an Eigen sparse factorization, which allocates its own storage
+    for (int alg=BFGS; alg <= NewtonKrylov; alg++) {
+        Rectangle rectangle;
+        System system;
+        system.analyticSolving = false; // the iterative solvers are the ones to check
+        rectangle.addTo(system);
+        VEC_pD params = rectangle.unknowns();
+        system.declareUnknowns(params);
+        system.initSolution(Algorithm(alg));
+
+        // warm-up: sizes the workspaces
+        int res = system.solve(true, Algorithm(alg));
+        assert(res == Success && "The rectangle should be solved");
+
+        // each solve starts from the reference and has a new width to reach
+        long counted = 0;
+        for (int k=1; k <= 20; k++) {
+            rectangle.width = 4. + 0.05*k;
+            allocations = 0;
+            countAllocations = true;
+            res = system.solve(true, Algorithm(alg));
+            countAllocations = false;
+            counted += allocations;
+            assert(res == Success && "The rectangle should be solved for each width");
+        }
+        system.applySolution();
+        assert(std::abs(rectangle.values[2] - 5.) < 1e-6 && "The last width should be applied");
+
+        std::cout << "  algorithm " << alg << ": " << counted << " allocations" << std::endl;
+        assert(counted == 0 && "Solving a warmed-up system should not allocate");
+    }
+    std::cout << "[PASS] Repeated solves do not allocate" << std::endl;
+}
+
+void testDragUpdates() {
+    std::cout << "\n=== Unit Test: Drag Updates ===" << std::endl;
+
+    Rectangle rectangle;
+    System system;
+    system.analyticSolving = false;
+    rectangle.addTo(system);
+    VEC_pD params = rectangle.unknowns();
+    system.declareUnknowns(params);
+    system.initSolution();
+    int res = system.solve();
+    assert(res == Success && "The rectangle should be solved");
+    system.applySolution();
+
+    // the driving width is dropped, the opposite corner is dragged
+    system.clearByTag(11);
+    system.declareUnknowns(params);
+    VEC_pD dragged(1, rectangle.lines[1].p2.x);
+    res = system.initDrag(dragged);
+    assert(res == Success && "The drag session should start");
+
+    VEC_D targets(1, 4.);
+    res = system.updateDrag(targets); // warm-up
+    assert(res == Success && "The first drag update should succeed");
+
+    long counted = 0;
+    for (int k=1; k <= 20; k++) {
+        targets[0] = 4. + 0.1*k;
+        allocations = 0;
+        countAllocations = true;
+        res = system.updateDrag(targets);
+        countAllocations = false;
+        counted += allocations;
+        assert(res == Success && "Each drag update should succeed");
+    }
+    assert(std::abs(*rectangle.lines[1].p2.x - 6.) < 1e-6 && "The corner should follow the drag");
+    system.finishDrag();
+
+    std::cout << "  " << counted << " allocations" << std::endl;
+    assert(counted == 0 && "Drag updates of a warmed-up session should not allocate");
+    std::cout << "[PASS] Drag updates do not allocate" << std::endl;
+}
+
+int main() {
+    std::cout << "========================================" << std::endl;
+    std::cout << "    Unit Tests: Solver Workspace       " << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    try {
+        testRepeatedSolves();
+        testDragUpdates();
+
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "     ALL SOLVER WORKSPACE TESTS PASSED!  " << std::endl;
+        std::cout << "========================================" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\nX TEST FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
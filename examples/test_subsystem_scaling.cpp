@@ -0,0 +1,105 @@
+/***************************************************************************
+ * Unit Tests: SubSystem Scaling
+ *
+ * Tests that the residuals, the jacobian and the gradients of an equilibrated
+ * subsystem are consistent: both variants of calcGrad are the product of the
+ * transposed scaled jacobian with the scaled residuals.
+ ***************************************************************************/
+
+#include "../src/GCS.h"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+
+using namespace GCS;
+
+void testScaledGradients() {
+    std::cout << "=== Unit Test: Scaled Gradients ===" << std::endl;
+
+    // a distance between points of a unit square and an angle to a point far
+    // away, whose jacobian rows differ by three orders of magnitude
+    double values[6] = { 0.1, -0.2,   1.3, 0.9,   1000., 420. };
+    Point p, q, f;
+    p.x = &values[0]; p.y = &values[1];
+    q.x = &values[2]; q.y = &values[3];
+    f.x = &values[4]; f.y = &values[5];
+    double distance = 2., angle = 0.3;
+
+    std::vector<Constraint *> clist;
+    clist.push_back(new ConstraintP2PDistance(p, q, &distance));
+    clist.push_back(new ConstraintP2PAngle(q, f, &angle));
+    VEC_pD params;
+    for (int i=0; i < 6; i++)
+        params.push_back(&values[i]);
+
+    SubSystem *subsys = new SubSystem(clist, params);
+    bool isScaled = subsys->equilibrate();
+    assert(isScaled && "The unbalanced rows should be equilibrated");
+    subsys->redirectParams(); // evaluated on its own copy, as by the solvers
+
+    Eigen::MatrixXd J(subsys->cSize(), subsys->pSize());
+    Eigen::VectorXd r(subsys->cSize());
+    subsys->calcJacobi(J);
+    subsys->calcResidual(r);
+    Eigen::VectorXd expected = J.transpose() * r;
+
+    // unscaled references, the residual of the angle has to be scaled up the most
+    Eigen::MatrixXd J0(subsys->cSize(), subsys->pSize());
+    subsys->calcJacobi(params, J0);
+    assert(std::abs(J(1,4)) > 4.*std::abs(J0(1,4)) && "The jacobian should be scaled");
+
+    Eigen::VectorXd grad(subsys->pSize());
+    subsys->calcGrad(grad);
+    assert((grad - expected).norm() <= 1e-12 * expected.norm() &&
+           "calcGrad should be the scaled J^T r");
+    std::cout << "[PASS] calcGrad without a parameter list" << std::endl;
+
+    Eigen::VectorXd gradParams(params.size());
+    subsys->calcGrad(params, gradParams);
+    assert((gradParams - expected).norm() <= 1e-12 * expected.norm() &&
+           "calcGrad with all the parameters should be the scaled J^T r");
+
+    // a subset in another order
+    VEC_pD subset;
+    subset.push_back(params[4]);
+    subset.push_back(params[1]);
+    Eigen::VectorXd gradSubset(subset.size());
+    subsys->calcGrad(subset, gradSubset);
+    assert(std::abs(gradSubset[0] - expected[4]) <= 1e-12 * expected.norm() &&
+           std::abs(gradSubset[1] - expected[1]) <= 1e-12 * expected.norm() &&
+           "calcGrad with a parameter list should pick the entries of J^T r");
+    std::cout << "[PASS] calcGrad with a parameter list" << std::endl;
+
+    subsys->clearScaling();
+    subsys->calcJacobi(J);
+    subsys->calcResidual(r);
+    expected = J.transpose() * r;
+    subsys->calcGrad(params, gradParams);
+    subsys->calcGrad(grad);
+    assert((grad - expected).norm() <= 1e-12 * expected.norm() &&
+           (gradParams - expected).norm() <= 1e-12 * expected.norm() &&
+           "Both variants should be J^T r without scaling");
+    std::cout << "[PASS] Both variants agree after clearScaling" << std::endl;
+
+    subsys->revertParams();
+    delete subsys;
+    free(clist);
+}
+
+int main() {
+    std::cout << "========================================" << std::endl;
+    std::cout << "    Unit Tests: SubSystem Scaling      " << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    try {
+        testScaledGradients();
+
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "    ALL SUBSYSTEM SCALING TESTS PASSED! " << std::endl;
+        std::cout << "========================================" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\nX TEST FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
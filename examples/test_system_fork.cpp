@@ -0,0 +1,161 @@
+/***************************************************************************
+ * Unit Tests: System Fork
+ *
+ * Tests that a fork solves on its own copies of the parameters, including
+ * components that the reduction of equality constraints leaves empty, and
+ * that constraints added to or removed from a fork leave its parent alone.
+ ***************************************************************************/
+
+#include "../src/GCS.h"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+
+using namespace GCS;
+
+void testEqualOnlyComponent() {
+    std::cout << "=== Unit Test: Equal-Only Component ===" << std::endl;
+
+    // a coincidence of two points apart, which the reduction removes entirely,
+    // and a segment that is solved as usual
+    double values[8] = { 1., 2., 7., -3.,   0., 0., 3., 4. };
+    Point a, b, p, q;
+    a.x = &values[0]; a.y = &values[1];
+    b.x = &values[2]; b.y = &values[3];
+    p.x = &values[4]; p.y = &values[5];
+    q.x = &values[6]; q.y = &values[7];
+    double length = 6.;
+
+    System system;
+    system.addConstraintP2PCoincident(a, b, 1);
+    system.addConstraintP2PDistance(p, q, &length, 2);
+    VEC_pD params;
+    for (int i=0; i < 8; i++)
+        params.push_back(&values[i]);
+    system.declareUnknowns(params);
+    system.initSolution();
+
+    // the fork of the unsolved system builds and solves both components itself
+    {
+        System *forked = system.fork();
+        int res = forked->solve();
+        assert(res == Success && "The fork should solve a component of reduced equalities");
+        forked->applySolution();
+
+        assert(forked->getValue(b.x) == forked->getValue(a.x) && "The fork should apply the reduction");
+        assert(forked->getValue(b.y) == forked->getValue(a.y) && "The fork should apply the reduction");
+        double dx = forked->getValue(q.x) - forked->getValue(p.x);
+        double dy = forked->getValue(q.y) - forked->getValue(p.y);
+        assert(std::abs(std::sqrt(dx*dx + dy*dy) - length) < 1e-6 && "The segment should be solved in the fork");
+        delete forked;
+
+        assert(values[2] == 7. && values[3] == -3. && values[6] == 3. &&
+               "The parent should not be changed by the fork");
+        std::cout << "[PASS] Equal-only component of an unsolved parent solved in the fork" << std::endl;
+    }
+
+    int res = system.solve();
+    assert(res == Success && "The parent should be solved");
+    system.applySolution();
+
+    // the fork moves b away from a and takes that as its reference
+    {
+        System *forked = system.fork();
+        forked->setValue(b.x, 5.);
+        forked->initSolution();
+        res = forked->solve();
+        assert(res == Success && "The fork should solve an edited component of reduced equalities");
+        forked->applySolution();
+        assert(forked->getValue(b.x) == forked->getValue(a.x) && "The fork should apply the reduction");
+        delete forked;
+
+        assert(values[2] == values[0] && "The parent should keep its solution");
+        std::cout << "[PASS] Edited Equal-only component solved in the fork" << std::endl;
+    }
+}
+
+void testStructureEdits() {
+    std::cout << "\n=== Unit Test: Structure Edits in a Fork ===" << std::endl;
+
+    // two segments with a fixed start each, apart from each other
+    double values[8] = { 0., 0., 3., 1.,   10., 0., 12., 3. };
+    Point p, q, r, s;
+    p.x = &values[0]; p.y = &values[1];
+    q.x = &values[2]; q.y = &values[3];
+    r.x = &values[4]; r.y = &values[5];
+    s.x = &values[6]; s.y = &values[7];
+    double zero = 0., ten = 10., length = 4., gap = 5.;
+
+    System system;
+    system.addConstraintCoordinateX(p, &zero, 1);
+    system.addConstraintCoordinateY(p, &zero, 1);
+    system.addConstraintP2PDistance(p, q, &length, 2);
+    system.addConstraintCoordinateX(r, &ten, 3);
+    system.addConstraintCoordinateY(r, &zero, 3);
+    system.addConstraintP2PDistance(r, s, &length, 4);
+    VEC_pD params;
+    for (int i=0; i < 8; i++)
+        params.push_back(&values[i]);
+    system.declareUnknowns(params);
+    system.initSolution();
+    int dofs = system.diagnose();
+    assert(dofs == 2 && "Each segment should be left free to turn");
+
+    // the first fork joins the segments and drops the length of the second one, the
+    // second fork, alive at the same time, still sees the structure of the parent
+    System *joined = system.fork();
+    System *plain = system.fork();
+    joined->addConstraintP2PDistance(q, s, &gap, 5);
+    joined->clearByTag(4);
+    joined->declareUnknowns(params);
+    joined->initSolution();
+    assert(joined->diagnose() == 2 && "The fork should see its own constraints");
+    int res = joined->solve();
+    assert(res == Success && "The fork should solve its own constraints");
+    joined->applySolution();
+    double dx = joined->getValue(s.x) - joined->getValue(q.x);
+    double dy = joined->getValue(s.y) - joined->getValue(q.y);
+    assert(std::abs(std::sqrt(dx*dx + dy*dy) - gap) < 1e-6 && "The added constraint should be solved in the fork");
+
+    assert(plain->diagnose() == 2 && "A fork should not see the edits of another one");
+    res = plain->solve();
+    assert(res == Success && "The other fork should be solved");
+    plain->applySolution();
+    dx = plain->getValue(s.x) - plain->getValue(r.x);
+    dy = plain->getValue(s.y) - plain->getValue(r.y);
+    assert(std::abs(std::sqrt(dx*dx + dy*dy) - length) < 1e-6 &&
+           "The constraint removed in a fork should be kept by the others");
+    delete joined; // deletes its own constraint, but not the ones of the parent
+    delete plain;
+    std::cout << "[PASS] Constraints added and removed in a fork" << std::endl;
+
+    assert(system.diagnose() == 2 && "The parent should keep its constraints");
+    res = system.solve();
+    assert(res == Success && "The parent should be solved");
+    system.applySolution();
+    assert(values[0] == 0. && values[4] == 10. && "The parent should be solved");
+    dx = values[6] - values[4];
+    dy = values[7] - values[5];
+    assert(std::abs(std::sqrt(dx*dx + dy*dy) - length) < 1e-6 &&
+           "The parent should keep the constraint removed in the fork");
+    std::cout << "[PASS] Parent unchanged by the edits of its forks" << std::endl;
+}
+
+int main() {
+    std::cout << "========================================" << std::endl;
+    std::cout << "       Unit Tests: System Fork         " << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    try {
+        testEqualOnlyComponent();
+        testStructureEdits();
+
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "       ALL SYSTEM FORK TESTS PASSED!   " << std::endl;
+        std::cout << "========================================" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\nX TEST FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
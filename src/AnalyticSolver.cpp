@@ -0,0 +1,370 @@
+/***************************************************************************
+ *   Copyright (c) 2025 PlaneGCS developers                                *
+ *                                                                         *
+ *   This file is part of the FreeCAD CAx development system.              *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU Library General Public           *
+ *   License as published by the Free Software Foundation; either          *
+ *   version 2 of the License, or (at your option) any later version.      *
+ *                                                                         *
+ *   This library  is distributed in the hope that it will be useful,      *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU Library General Public License for more details.                  *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this library; see the file COPYING.LIB. If not,    *
+ *   write to the Free Software Foundation, Inc., 59 Temple Place,         *
+ *   Suite 330, Boston, MA  02111-1307, USA                                *
+ *                                                                         *
+ ***************************************************************************/
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "AnalyticSolver.h"
+#include "SubSystem.h"
+
+namespace GCS
+{
+
+// larger subsystems hardly ever reduce to a single point
+static const int analyticMaxSize = 8;
+
+// relative tolerance on tangency, where the two roots of an intersection merge
+static const double tangencyTolerance = 1e-10;
+
+// either the line n.p = c, with |n| = 1, or the circle |p - center| = r
+struct Locus
+{
+    bool isLine;
+    double nx, ny, c;
+    double cx, cy, r;
+};
+
+// alternatives of a locus (two parallels at most) and roots of two loci
+static const int maxAlternatives = 2;
+static const int maxRoots = 2*maxAlternatives*maxAlternatives;
+
+static bool isKnown(const SET_pD &unknowns, double *param)
+{
+    return unknowns.find(param) == unknowns.end();
+}
+
+static Locus lineLocus(double nx, double ny, double c)
+{
+    Locus l;
+    l.isLine = true;
+    l.nx = nx;
+    l.ny = ny;
+    l.c = c;
+    l.cx = l.cy = l.r = 0.;
+    return l;
+}
+
+static Locus circleLocus(double cx, double cy, double r)
+{
+    Locus l;
+    l.isLine = false;
+    l.nx = l.ny = l.c = 0.;
+    l.cx = cx;
+    l.cy = cy;
+    l.r = r;
+    return l;
+}
+
+// lines parallel to p1p2 at the given (absolute) distance
+static int parallelLoci(double x1, double y1, double x2, double y2, double dist, Locus *loci)
+{
+    double dx = x2-x1, dy = y2-y1;
+    double d = sqrt(dx*dx+dy*dy);
+    if (d == 0. || dist < 0.)
+        return 0;
+    double nx = -dy/d, ny = dx/d;
+    double c = nx*x1 + ny*y1;
+    loci[0] = lineLocus(nx, ny, c + dist);
+    if (dist == 0.)
+        return 1;
+    loci[1] = lineLocus(nx, ny, c - dist);
+    return 2;
+}
+
+// the point of constr holding the unknowns, all other parameters must be known,
+// params are those of the view of constr in the subsystem
+static bool unknownPoint(Constraint *constr, const VEC_pD &params, const SET_pD &unknowns,
+                         double *&px, double *&py)
+{
+    int first; // position of the x coordinate of the point
+    switch (constr->getTypeId()) {
+        case P2PDistance:
+            first = (isKnown(unknowns, params[0]) && isKnown(unknowns, params[1])) ? 2 : 0;
+            break;
+        case PointOnLine:
+        case P2LDistance:
+            first = 0;
+            break;
+        default:
+            return false;
+    }
+    for (int i=0; i < int(params.size()); i++) {
+        if (i != first && i != first+1 && !isKnown(unknowns, params[i]))
+            return false;
+    }
+    px = params[first];
+    py = params[first+1];
+    return true;
+}
+
+// alternative loci of the point (px, py) constrained by constr, see unknownPoint
+static int pointLoci(Constraint *constr, const VEC_pD &params, double *px, double *py, Locus *loci)
+{
+    switch (constr->getTypeId()) {
+        case P2PDistance: {
+            int other = (params[0] == px && params[1] == py) ? 2 : 0;
+            double r = *params[4];
+            if (r < 0.)
+                return 0;
+            loci[0] = circleLocus(*params[other], *params[other+1], r);
+            return 1;
+        }
+        case PointOnLine:
+            return parallelLoci(*params[2], *params[3], *params[4], *params[5], 0., loci);
+        case P2LDistance:
+            return parallelLoci(*params[2], *params[3], *params[4], *params[5], *params[6], loci);
+        default:
+            return 0;
+    }
+}
+
+// square root of a discriminant, slightly negative values are taken as a tangency
+static bool rootOf(double h2, double scale, double &h)
+{
+    if (h2 < -tangencyTolerance*scale)
+        return false;
+    h = (h2 > 0.) ? sqrt(h2) : 0.;
+    return true;
+}
+
+// appends the intersections of a and b to roots, returns their new number
+static int intersect(const Locus &a, const Locus &b, Eigen::Vector2d *roots, int size)
+{
+    if (a.isLine && b.isLine) {
+        double det = a.nx*b.ny - a.ny*b.nx;
+        if (std::abs(det) < tangencyTolerance)
+            return size;
+        roots[size++] = Eigen::Vector2d((a.c*b.ny - a.ny*b.c)/det,
+                                        (a.nx*b.c - a.c*b.nx)/det);
+    }
+    else if (a.isLine || b.isLine) {
+        const Locus &l = a.isLine ? a : b;
+        const Locus &k = a.isLine ? b : a;
+        double s = l.nx*k.cx + l.ny*k.cy - l.c; // signed distance of the center to the line
+        double h;
+        if (!rootOf(k.r*k.r - s*s, k.r*k.r + s*s, h))
+            return size;
+        Eigen::Vector2d foot(k.cx - s*l.nx, k.cy - s*l.ny);
+        Eigen::Vector2d dir(-l.ny, l.nx);
+        roots[size++] = foot + h*dir;
+        if (h > 0.)
+            roots[size++] = foot - h*dir;
+    }
+    else {
+        Eigen::Vector2d c1(a.cx, a.cy), c2(b.cx, b.cy);
+        double d = (c2-c1).norm();
+        if (d == 0.)
+            return size;
+        double m = (a.r*a.r - b.r*b.r + d*d)/(2*d); // distance of the chord from c1
+        double h;
+        if (!rootOf(a.r*a.r - m*m, a.r*a.r + m*m, h))
+            return size;
+        Eigen::Vector2d dir = (c2-c1)/d;
+        Eigen::Vector2d base = c1 + m*dir;
+        Eigen::Vector2d perp(-dir.y(), dir.x());
+        roots[size++] = base + h*perp;
+        if (h > 0.)
+            roots[size++] = base - h*perp;
+    }
+    return size;
+}
+
+// looks for the pattern in the redirected constraints of subsys
+static void findPattern(SubSystem *subsys, AnalyticPattern &pattern)
+{
+    pattern.status = AnalyticPattern::None;
+    pattern.linear.clear();
+    pattern.linearParams.clear();
+    pattern.locatorsSize = 0;
+
+    int psize = subsys->pSize();
+    if (psize == 0 || psize > analyticMaxSize || subsys->cSize() != psize)
+        return;
+
+    std::vector<Constraint *> clist;
+    subsys->getConstraintList(clist);
+
+    // apart from the linear ones, at most two constraints can locate the point
+    int nonlinear = 0;
+    for (std::vector<Constraint *>::const_iterator constr=clist.begin();
+         constr != clist.end(); ++constr) {
+        ConstraintType type = (*constr)->getTypeId();
+        if (type != Equal && type != Difference)
+            nonlinear++;
+    }
+    if (nonlinear > 2)
+        return;
+
+    MAP_pD_pD pmap;
+    subsys->getParamMap(pmap);
+    SET_pD unknowns;
+    for (MAP_pD_pD::const_iterator it=pmap.begin(); it != pmap.end(); ++it)
+        unknowns.insert(it->second);
+
+    // Equal and Difference are linear, a single unknown is solved by one Newton step
+    VEC_I pending, rest;
+    for (int i=0; i < int(clist.size()); i++) {
+        const VEC_pD &params = subsys->cview(i).pvec;
+        for (VEC_pD::const_iterator param=params.begin(); param != params.end(); ++param) {
+            if (!isKnown(unknowns, *param)) {
+                pending.push_back(i);
+                break;
+            }
+        }
+    }
+    bool isProgress = true;
+    while (isProgress) {
+        isProgress = false;
+        rest.clear();
+        for (VEC_I::const_iterator ci=pending.begin(); ci != pending.end(); ++ci) {
+            const ParamView &v = subsys->cview(*ci);
+            SET_pD own;
+            for (VEC_pD::const_iterator param=v.pvec.begin(); param != v.pvec.end(); ++param) {
+                if (!isKnown(unknowns, *param))
+                    own.insert(*param);
+            }
+            if (own.empty())
+                continue;
+            ConstraintType type = clist[*ci]->getTypeId();
+            if (own.size() == 1 && (type == Equal || type == Difference) &&
+                clist[*ci]->grad(v, *own.begin()) != 0.) {
+                pattern.linear.push_back(*ci);
+                pattern.linearParams.push_back(*own.begin());
+                unknowns.erase(*own.begin());
+                isProgress = true;
+                continue;
+            }
+            rest.push_back(*ci);
+        }
+        pending.swap(rest);
+    }
+
+    if (unknowns.empty()) {
+        if (pending.empty())
+            pattern.status = AnalyticPattern::Found;
+        return;
+    }
+    if (unknowns.size() > 2 || pending.size() != unknowns.size())
+        return;
+
+    // what remains has to be a single point
+    double *px, *py;
+    if (!unknownPoint(clist[pending[0]], subsys->cview(pending[0]).pvec, unknowns, px, py))
+        return;
+    for (VEC_I::const_iterator ci=pending.begin()+1; ci != pending.end(); ++ci) {
+        double *qx, *qy;
+        if (!unknownPoint(clist[*ci], subsys->cview(*ci).pvec, unknowns, qx, qy) ||
+            qx != px || qy != py)
+            return;
+    }
+    for (SET_pD::const_iterator param=unknowns.begin(); param != unknowns.end(); ++param) {
+        if (*param != px && *param != py)
+            return;
+    }
+
+    pattern.status = AnalyticPattern::Found;
+    pattern.px = px;
+    pattern.py = py;
+    pattern.isXUnknown = !isKnown(unknowns, px);
+    pattern.isYUnknown = !isKnown(unknowns, py);
+    for (VEC_I::const_iterator ci=pending.begin(); ci != pending.end(); ++ci)
+        pattern.locators[pattern.locatorsSize++] = *ci;
+}
+
+// solves the redirected subsystem along the pattern
+static bool solvePattern(SubSystem *subsys, const AnalyticPattern &pattern, double tolerance)
+{
+    for (std::size_t i=0; i < pattern.linear.size(); i++) {
+        double *param = pattern.linearParams[i];
+        Constraint *constr = subsys->constraint(pattern.linear[i]);
+        const ParamView &v = subsys->cview(pattern.linear[i]);
+        *param -= constr->error(v)/constr->grad(v, param);
+    }
+    subsys->paramsChanged();
+    if (pattern.locatorsSize == 0)
+        return subsys->error() <= tolerance;
+
+    double *px = pattern.px, *py = pattern.py;
+    Locus loci[2][maxAlternatives];
+    int lociSize[2];
+    int k = 0;
+    if (!pattern.isXUnknown) {
+        loci[k][0] = lineLocus(1., 0., *px);
+        lociSize[k++] = 1;
+    }
+    else if (!pattern.isYUnknown) {
+        loci[k][0] = lineLocus(0., 1., *py);
+        lociSize[k++] = 1;
+    }
+    for (int i=0; i < pattern.locatorsSize; i++, k++) {
+        int ci = pattern.locators[i];
+        lociSize[k] = pointLoci(subsys->constraint(ci), subsys->cview(ci).pvec, px, py, loci[k]);
+        if (lociSize[k] == 0)
+            return false;
+    }
+
+    Eigen::Vector2d roots[maxRoots];
+    int rootsSize = 0;
+    for (int a=0; a < lociSize[0]; a++)
+        for (int b=0; b < lociSize[1]; b++)
+            rootsSize = intersect(loci[0][a], loci[1][b], roots, rootsSize);
+
+    Eigen::Vector2d start(*px, *py);
+    std::sort(roots, roots + rootsSize,
+              [&start](const Eigen::Vector2d &a, const Eigen::Vector2d &b)
+              { return (a-start).squaredNorm() < (b-start).squaredNorm(); });
+    for (int i=0; i < rootsSize; i++) {
+        if (pattern.isXUnknown)
+            *px = roots[i].x();
+        if (pattern.isYUnknown)
+            *py = roots[i].y();
+        subsys->paramsChanged();
+        if (subsys->error() <= tolerance)
+            return true;
+    }
+    return false;
+}
+
+bool solveAnalytic(SubSystem *subsys, double tolerance)
+{
+    AnalyticPattern &pattern = subsys->workspace.pattern;
+    if (pattern.status == AnalyticPattern::None)
+        return false;
+
+    subsys->redirectParams();
+    if (pattern.status == AnalyticPattern::Unknown)
+        findPattern(subsys, pattern);
+
+    bool isSolved = false;
+    if (pattern.status == AnalyticPattern::Found) {
+        Eigen::VectorXd &x0 = subsys->workspace.x0;
+        subsys->getParams(x0);
+        isSolved = solvePattern(subsys, pattern, tolerance);
+        if (!isSolved)
+            subsys->setParams(x0);
+    }
+    subsys->revertParams();
+    return isSolved;
+}
+
+} //namespace GCS
@@ -0,0 +1,72 @@
+/***************************************************************************
+ *   Copyright (c) 2025 PlaneGCS developers                                *
+ *                                                                         *
+ *   This file is part of the FreeCAD CAx development system.              *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU Library General Public           *
+ *   License as published by the Free Software Foundation; either          *
+ *   version 2 of the License, or (at your option) any later version.      *
+ *                                                                         *
+ *   This library  is distributed in the hope that it will be useful,      *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU Library General Public License for more details.                  *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this library; see the file COPYING.LIB. If not,    *
+ *   write to the Free Software Foundation, Inc., 59 Temple Place,         *
+ *   Suite 330, Boston, MA  02111-1307, USA                                *
+ *                                                                         *
+ ***************************************************************************/
+
+
+#ifndef PLANEGCS_ANALYTICSOLVER_H
+#define PLANEGCS_ANALYTICSOLVER_H
+
+#include <vector>
+#include "Constraints.h"
+
+namespace GCS
+{
+    class SubSystem;
+
+    // Pattern of a subsystem as found by solveAnalytic. It only depends on the
+    // structure of the subsystem, so it is looked for once and then replayed.
+    struct AnalyticPattern
+    {
+        enum Status {
+            Unknown = 0,  // not looked for yet
+            None = 1,     // the subsystem does not match
+            Found = 2
+        };
+        Status status;
+        VEC_I linear;                     // constraints (index in the subsystem) solved in this order for
+        VEC_pD linearParams;              // these parameters
+        int locators[2];                  // constraints locating the point
+        int locatorsSize;
+        double *px, *py;                  // the point, pointers to the values of the subsystem
+        bool isXUnknown, isYUnknown;
+
+        AnalyticPattern()
+          : status(Unknown), locatorsSize(0), px(NULL), py(NULL),
+            isXUnknown(false), isYUnknown(false) {}
+    };
+
+    // Closed form solution of the small subsystems that match a known pattern.
+    // Equal and Difference constraints on a single unknown are solved first, then
+    // what remains must be one point, located by the intersection of two loci:
+    // - a circle: distance to a fixed point (this covers point on a fixed circle),
+    // - a line: point on a fixed line, distance to a fixed line (two parallels),
+    //   or the fixed other coordinate of a point with a single unknown coordinate.
+    // Among the roots, the one closest to the values on entry is taken, provided
+    // that the error of the whole subsystem is below tolerance.
+    // Returns true if the subsystem was solved, its values then hold the solution
+    // like after any of the iterative solvers. On false they are left unchanged.
+    // The pattern is kept in the workspace of the subsystem, so that solving again
+    // does not allocate.
+    bool solveAnalytic(SubSystem *subsys, double tolerance);
+
+} //namespace GCS
+
+#endif // PLANEGCS_ANALYTICSOLVER_H
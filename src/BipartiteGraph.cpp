@@ -0,0 +1,275 @@
+/***************************************************************************
+ *   Copyright (c) 2025 PlaneGCS developers                                *
+ *                                                                         *
+ *   This file is part of the FreeCAD CAx development system.              *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU Library General Public           *
+ *   License as published by the Free Software Foundation; either          *
+ *   version 2 of the License, or (at your option) any later version.      *
+ *                                                                         *
+ *   This library  is distributed in the hope that it will be useful,      *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU Library General Public License for more details.                  *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this library; see the file COPYING.LIB. If not,    *
+ *   write to the Free Software Foundation, Inc., 59 Temple Place,         *
+ *   Suite 330, Boston, MA  02111-1307, USA                                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+
+#include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/strong_components.hpp>
+
+#include "BipartiteGraph.h"
+
+namespace GCS
+{
+
+typedef boost::adjacency_list <boost::vecS, boost::vecS, boost::directedS> DiGraph;
+
+static const int unreached = std::numeric_limits<int>::max();
+
+BipartiteGraph::BipartiteGraph(int rows, int cols)
+: nrows(rows)
+, ncols(cols)
+, rowadj(rows)
+, coladj(cols)
+, rowmate(rows, -1)
+, colmate(cols, -1)
+{
+}
+
+void BipartiteGraph::addEdge(int row, int col)
+{
+    rowadj[row].push_back(col);
+    coladj[col].push_back(row);
+}
+
+// breadth first search building the layers of the alternating forest rooted
+// at the unmatched rows, returns true if some unmatched column was reached
+bool BipartiteGraph::findLayers(VEC_I &dist) const
+{
+    std::deque<int> queue;
+    for (int row=0; row < nrows; row++) {
+        if (rowmate[row] == -1) {
+            dist[row] = 0;
+            queue.push_back(row);
+        }
+        else
+            dist[row] = unreached;
+    }
+
+    bool found = false;
+    while (!queue.empty()) {
+        int row = queue.front();
+        queue.pop_front();
+        for (VEC_I::const_iterator col=rowadj[row].begin(); col != rowadj[row].end(); ++col) {
+            int mate = colmate[*col];
+            if (mate == -1)
+                found = true;
+            else if (dist[mate] == unreached) {
+                dist[mate] = dist[row] + 1;
+                queue.push_back(mate);
+            }
+        }
+    }
+    return found;
+}
+
+// depth first search for an augmenting path along the layers, written
+// iteratively because paths can be as long as the number of rows
+bool BipartiteGraph::augment(int root, VEC_I &dist, VEC_I &next)
+{
+    VEC_I rowstack(1, root);
+    VEC_I colstack; // colstack[k] is the column joining rowstack[k] to rowstack[k+1]
+
+    while (!rowstack.empty()) {
+        int row = rowstack.back();
+        if (next[row] == int(rowadj[row].size())) {
+            dist[row] = unreached; // dead end for the rest of this phase
+            rowstack.pop_back();
+            if (!colstack.empty())
+                colstack.pop_back();
+            continue;
+        }
+        int col = rowadj[row][next[row]++];
+        int mate = colmate[col];
+        if (mate == -1) {
+            // flip the matching along the path
+            colstack.push_back(col);
+            for (int k=int(rowstack.size())-1; k >= 0; k--) {
+                rowmate[rowstack[k]] = colstack[k];
+                colmate[colstack[k]] = rowstack[k];
+            }
+            return true;
+        }
+        else if (dist[mate] == dist[row] + 1) {
+            colstack.push_back(col);
+            rowstack.push_back(mate);
+        }
+    }
+    return false;
+}
+
+int BipartiteGraph::maximumMatching()
+{
+    std::fill(rowmate.begin(), rowmate.end(), -1);
+    std::fill(colmate.begin(), colmate.end(), -1);
+
+    // greedy initialization, most rows get matched here already
+    int matching = 0;
+    for (int row=0; row < nrows; row++) {
+        for (VEC_I::const_iterator col=rowadj[row].begin(); col != rowadj[row].end(); ++col) {
+            if (colmate[*col] == -1) {
+                rowmate[row] = *col;
+                colmate[*col] = row;
+                matching++;
+                break;
+            }
+        }
+    }
+
+    VEC_I dist(nrows), next(nrows);
+    while (matching < std::min(nrows, ncols) && findLayers(dist)) {
+        std::fill(next.begin(), next.end(), 0);
+        for (int row=0; row < nrows; row++) {
+            if (rowmate[row] == -1 && augment(row, dist, next))
+                matching++;
+        }
+    }
+    return matching;
+}
+
+void BipartiteGraph::overdeterminedPart(std::vector<bool> &rowsOut, std::vector<bool> &colsOut) const
+{
+    rowsOut.assign(nrows, false);
+    colsOut.assign(ncols, false);
+
+    VEC_I stack;
+    for (int row=0; row < nrows; row++) {
+        if (rowmate[row] == -1) {
+            rowsOut[row] = true;
+            stack.push_back(row);
+        }
+    }
+    while (!stack.empty()) {
+        int row = stack.back();
+        stack.pop_back();
+        for (VEC_I::const_iterator col=rowadj[row].begin(); col != rowadj[row].end(); ++col) {
+            if (colsOut[*col])
+                continue;
+            colsOut[*col] = true;
+            int mate = colmate[*col];
+            if (mate != -1 && !rowsOut[mate]) {
+                rowsOut[mate] = true;
+                stack.push_back(mate);
+            }
+        }
+    }
+}
+
+void BipartiteGraph::underdeterminedPart(std::vector<bool> &rowsOut, std::vector<bool> &colsOut) const
+{
+    rowsOut.assign(nrows, false);
+    colsOut.assign(ncols, false);
+
+    VEC_I stack;
+    for (int col=0; col < ncols; col++) {
+        if (colmate[col] == -1) {
+            colsOut[col] = true;
+            stack.push_back(col);
+        }
+    }
+    while (!stack.empty()) {
+        int col = stack.back();
+        stack.pop_back();
+        for (VEC_I::const_iterator row=coladj[col].begin(); row != coladj[col].end(); ++row) {
+            if (rowsOut[*row])
+                continue;
+            rowsOut[*row] = true;
+            int mate = rowmate[*row];
+            if (mate != -1 && !colsOut[mate]) {
+                colsOut[mate] = true;
+                stack.push_back(mate);
+            }
+        }
+    }
+}
+
+void BipartiteGraph::squareBlocks(const std::vector<bool> &subset,
+                                  std::vector<VEC_I> &blocksOut, VEC_I &levelsOut) const
+{
+    blocksOut.clear();
+    levelsOut.clear();
+
+    // row r depends on row m if r involves the column matched to m
+    DiGraph g(nrows);
+    for (int row=0; row < nrows; row++) {
+        if (!subset[row])
+            continue;
+        for (VEC_I::const_iterator col=rowadj[row].begin(); col != rowadj[row].end(); ++col) {
+            int mate = colmate[*col];
+            if (mate != -1 && mate != row && subset[mate])
+                boost::add_edge(row, mate, g);
+        }
+    }
+
+    VEC_I component(nrows);
+    int componentsSize = boost::strong_components(g, &component[0]);
+
+    // rows outside of the subset form singleton components, they are dropped below
+    std::vector<VEC_I> members(componentsSize);
+    for (int row=0; row < nrows; row++) {
+        if (subset[row])
+            members[component[row]].push_back(row);
+    }
+
+    // level of each block in the condensed (acyclic) dependency graph
+    std::vector<VEC_I> dependents(componentsSize);
+    VEC_I pending(componentsSize, 0);
+    for (int row=0; row < nrows; row++) {
+        if (!subset[row])
+            continue;
+        for (VEC_I::const_iterator col=rowadj[row].begin(); col != rowadj[row].end(); ++col) {
+            int mate = colmate[*col];
+            if (mate != -1 && subset[mate] && component[mate] != component[row]) {
+                dependents[component[mate]].push_back(component[row]);
+                pending[component[row]]++;
+            }
+        }
+    }
+
+    VEC_I level(componentsSize, 0);
+    VEC_I ready;
+    for (int k=0; k < componentsSize; k++) {
+        if (!members[k].empty() && pending[k] == 0)
+            ready.push_back(k);
+    }
+    VEC_I order;
+    while (!ready.empty()) {
+        int k = ready.back();
+        ready.pop_back();
+        order.push_back(k);
+        for (VEC_I::const_iterator dep=dependents[k].begin(); dep != dependents[k].end(); ++dep) {
+            level[*dep] = std::max(level[*dep], level[k] + 1);
+            if (--pending[*dep] == 0)
+                ready.push_back(*dep);
+        }
+    }
+
+    std::stable_sort(order.begin(), order.end(),
+                     [&level](int a, int b) { return level[a] < level[b]; });
+    for (VEC_I::const_iterator k=order.begin(); k != order.end(); ++k) {
+        blocksOut.push_back(members[*k]);
+        levelsOut.push_back(level[*k]);
+    }
+}
+
+} //namespace GCS
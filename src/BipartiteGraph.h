@@ -0,0 +1,82 @@
+/***************************************************************************
+ *   Copyright (c) 2025 PlaneGCS developers                                *
+ *                                                                         *
+ *   This file is part of the FreeCAD CAx development system.              *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU Library General Public           *
+ *   License as published by the Free Software Foundation; either          *
+ *   version 2 of the License, or (at your option) any later version.      *
+ *                                                                         *
+ *   This library  is distributed in the hope that it will be useful,      *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU Library General Public License for more details.                  *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this library; see the file COPYING.LIB. If not,    *
+ *   write to the Free Software Foundation, Inc., 59 Temple Place,         *
+ *   Suite 330, Boston, MA  02111-1307, USA                                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PLANEGCS_BIPARTITEGRAPH_H
+#define PLANEGCS_BIPARTITEGRAPH_H
+
+#include <vector>
+#include "Util.h"
+
+namespace GCS
+{
+
+    // Incidence structure of a system of equations: rows are the equations
+    // (constraints), columns the unknowns (parameters). It provides the purely
+    // structural analysis of the system, i.e. the one that does not look at any
+    // numeric value: maximum matching and Dulmage-Mendelsohn decomposition.
+    class BipartiteGraph
+    {
+    private:
+        int nrows, ncols;
+        std::vector<VEC_I> rowadj; // row to column adjacency list
+        std::vector<VEC_I> coladj; // column to row adjacency list
+        VEC_I rowmate;             // matched column of each row, -1 if unmatched
+        VEC_I colmate;             // matched row of each column, -1 if unmatched
+
+        bool findLayers(VEC_I &dist) const;
+        bool augment(int root, VEC_I &dist, VEC_I &next);
+    public:
+        BipartiteGraph(int rows, int cols);
+
+        void addEdge(int row, int col);
+
+        int rows() const { return nrows; }
+        int cols() const { return ncols; }
+        const VEC_I &rowAdjacency(int row) const { return rowadj[row]; }
+        const VEC_I &colAdjacency(int col) const { return coladj[col]; }
+
+        // Hopcroft-Karp maximum matching, returns the structural rank
+        int maximumMatching();
+        int rowMatch(int row) const { return rowmate[row]; }
+        int colMatch(int col) const { return colmate[col]; }
+
+        // Coarse Dulmage-Mendelsohn decomposition, valid after maximumMatching():
+        // - the over-determined part is made of the rows and columns reachable through
+        //   alternating paths from unmatched rows,
+        // - the under-determined part is made of the rows and columns reachable through
+        //   alternating paths from unmatched columns.
+        // The flags are set to true for the members of the respective part.
+        void overdeterminedPart(std::vector<bool> &rowsOut, std::vector<bool> &colsOut) const;
+        void underdeterminedPart(std::vector<bool> &rowsOut, std::vector<bool> &colsOut) const;
+
+        // Fine decomposition of the rows flagged in subset (which must be matched and
+        // must not depend on columns of the under-determined part) into irreducible
+        // square blocks (strongly connected components). Blocks are returned sorted
+        // by level: a block only depends on columns of blocks with a lower level, so
+        // that blocks sharing a level are independent of each other.
+        void squareBlocks(const std::vector<bool> &subset,
+                          std::vector<VEC_I> &blocksOut, VEC_I &levelsOut) const;
+    };
+
+} //namespace GCS
+
+#endif // PLANEGCS_BIPARTITEGRAPH_H
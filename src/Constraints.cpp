@@ -36,27 +36,91 @@ namespace GCS
 // Constraints
 ///////////////////////////////////////
 
-Constraint::Constraint()
-: origpvec(0), pvec(0), scale(1.), tag(0), pvecChangedFlag(true), driving(true)
+#ifdef PROFILE_CONSTRAINTS
+ConstraintProfile::ConstraintProfile()
 {
+    reset();
 }
 
-void Constraint::redirectParams(MAP_pD_pD redirectionmap)
+ConstraintProfile &ConstraintProfile::profile()
 {
-    int i=0;
-    for (VEC_pD::iterator param=origpvec.begin();
-         param != origpvec.end(); ++param, i++) {
-        MAP_pD_pD::const_iterator it = redirectionmap.find(*param);
-        if (it != redirectionmap.end())
-            pvec[i] = it->second;
+    static ConstraintProfile theProfile;
+    return theProfile;
+}
+
+void ConstraintProfile::reset()
+{
+    for (int type=0; type < typesSize; type++) {
+        for (int evaluation=0; evaluation < evaluationsSize; evaluation++) {
+            callCounts[type][evaluation] = 0;
+            sampledNanoseconds[type][evaluation] = 0;
+        }
     }
-    pvecChangedFlag=true;
 }
 
-void Constraint::revertParams()
+long long ConstraintProfile::calls(ConstraintType type, Evaluation evaluation) const
 {
-    pvec = origpvec;
-    pvecChangedFlag=true;
+    return callCounts[type][evaluation];
+}
+
+double ConstraintProfile::seconds(ConstraintType type, Evaluation evaluation) const
+{
+    return 1e-9 * samplingPeriod * sampledNanoseconds[type][evaluation];
+}
+
+ConstraintProfile::Scope::Scope(ConstraintType type, Evaluation evaluation)
+: sampledTime(NULL)
+{
+    ConstraintProfile &p = profile();
+    p.callCounts[type][evaluation].fetch_add(1, std::memory_order_relaxed);
+
+    static thread_local int countdown = 0;
+    if (--countdown <= 0) {
+        countdown = samplingPeriod;
+        sampledTime = &p.sampledNanoseconds[type][evaluation];
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+ConstraintProfile::Scope::~Scope()
+{
+    if (sampledTime)
+        sampledTime->fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now() - start).count(),
+                               std::memory_order_relaxed);
+}
+#endif
+
+int ParamView::find(const double *param) const
+{
+    for (std::size_t i=0; i < pvec.size(); i++)
+        if (pvec[i] == param)
+            return i;
+    return -1;
+}
+
+Constraint::Constraint()
+: pvec(0), scale(1.), tag(0), driving(true)
+{
+}
+
+void Constraint::bindOwn()
+{
+    own.pvec = pvec;
+    own.curves.clear();
+    bindGeometry(own);
+}
+
+void Constraint::bind(ParamView &v, const MAP_pD_pD &redirectionmap) const
+{
+    v.pvec = pvec;
+    for (std::size_t i=0; i < v.pvec.size(); i++) {
+        MAP_pD_pD::const_iterator it = redirectionmap.find(v.pvec[i]);
+        if (it != redirectionmap.end())
+            v.pvec[i] = it->second;
+    }
+    v.curves.clear();
+    bindGeometry(v);
 }
 
 ConstraintType Constraint::getTypeId()
@@ -69,17 +133,17 @@ void Constraint::rescale(double coef)
     scale = coef * 1.;
 }
 
-double Constraint::error()
+double Constraint::evalError(const ParamView & /*v*/) const
 {
     return 0.;
 }
 
-double Constraint::grad(double * /*param*/)
+double Constraint::evalGrad(const ParamView & /*v*/, double * /*param*/) const
 {
     return 0.;
 }
 
-double Constraint::maxStep(MAP_pD_D & /*dir*/, double lim)
+double Constraint::evalMaxStep(const ParamView & /*v*/, MAP_pD_D & /*dir*/, double lim) const
 {
     return lim;
 }
@@ -102,7 +166,7 @@ ConstraintEqual::ConstraintEqual(double *p1, double *p2, double p1p2ratio)
     ratio = p1p2ratio;
     pvec.push_back(p1);
     pvec.push_back(p2);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -116,16 +180,16 @@ void ConstraintEqual::rescale(double coef)
     scale = coef * 1.;
 }
 
-double ConstraintEqual::error()
+double ConstraintEqual::evalError(const ParamView &v) const
 {
-    return scale * (*param1() - ratio *(*param2()));
+    return scale * (*param1(v) - ratio *(*param2(v)));
 }
 
-double ConstraintEqual::grad(double *param)
+double ConstraintEqual::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
-    if (param == param1()) deriv += 1;
-    if (param == param2()) deriv += -1;
+    if (param == param1(v)) deriv += 1;
+    if (param == param2(v)) deriv += -1;
     return scale * deriv;
 }
 
@@ -135,7 +199,7 @@ ConstraintDifference::ConstraintDifference(double *p1, double *p2, double *d)
     pvec.push_back(p1);
     pvec.push_back(p2);
     pvec.push_back(d);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -149,17 +213,17 @@ void ConstraintDifference::rescale(double coef)
     scale = coef * 1.;
 }
 
-double ConstraintDifference::error()
+double ConstraintDifference::evalError(const ParamView &v) const
 {
-    return scale * (*param2() - *param1() - *difference());
+    return scale * (*param2(v) - *param1(v) - *difference(v));
 }
 
-double ConstraintDifference::grad(double *param)
+double ConstraintDifference::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
-    if (param == param1()) deriv += -1;
-    if (param == param2()) deriv += 1;
-    if (param == difference()) deriv += -1;
+    if (param == param1(v)) deriv += -1;
+    if (param == param2(v)) deriv += 1;
+    if (param == difference(v)) deriv += -1;
     return scale * deriv;
 }
 
@@ -171,7 +235,7 @@ ConstraintP2PDistance::ConstraintP2PDistance(Point &p1, Point &p2, double *d)
     pvec.push_back(p2.x);
     pvec.push_back(p2.y);
     pvec.push_back(d);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -185,57 +249,57 @@ void ConstraintP2PDistance::rescale(double coef)
     scale = coef * 1.;
 }
 
-double ConstraintP2PDistance::error()
+double ConstraintP2PDistance::evalError(const ParamView &v) const
 {
-    double dx = (*p1x() - *p2x());
-    double dy = (*p1y() - *p2y());
+    double dx = (*p1x(v) - *p2x(v));
+    double dy = (*p1y(v) - *p2y(v));
     double d = sqrt(dx*dx + dy*dy);
-    double dist  = *distance();
+    double dist  = *distance(v);
     return scale * (d - dist);
 }
 
-double ConstraintP2PDistance::grad(double *param)
+double ConstraintP2PDistance::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
-    if (param == p1x() || param == p1y() ||
-        param == p2x() || param == p2y()) {
-        double dx = (*p1x() - *p2x());
-        double dy = (*p1y() - *p2y());
+    if (param == p1x(v) || param == p1y(v) ||
+        param == p2x(v) || param == p2y(v)) {
+        double dx = (*p1x(v) - *p2x(v));
+        double dy = (*p1y(v) - *p2y(v));
         double d = sqrt(dx*dx + dy*dy);
-        if (param == p1x()) deriv += dx/d;
-        if (param == p1y()) deriv += dy/d;
-        if (param == p2x()) deriv += -dx/d;
-        if (param == p2y()) deriv += -dy/d;
+        if (param == p1x(v)) deriv += dx/d;
+        if (param == p1y(v)) deriv += dy/d;
+        if (param == p2x(v)) deriv += -dx/d;
+        if (param == p2y(v)) deriv += -dy/d;
     }
-    if (param == distance()) deriv += -1.;
+    if (param == distance(v)) deriv += -1.;
 
     return scale * deriv;
 }
 
-double ConstraintP2PDistance::maxStep(MAP_pD_D &dir, double lim)
+double ConstraintP2PDistance::evalMaxStep(const ParamView &v, MAP_pD_D &dir, double lim) const
 {
     MAP_pD_D::iterator it;
-    // distance() >= 0
-    it = dir.find(distance());
+    // distance(v) >= 0
+    it = dir.find(distance(v));
     if (it != dir.end()) {
         if (it->second < 0.)
-            lim = std::min(lim, -(*distance()) / it->second);
+            lim = std::min(lim, -(*distance(v)) / it->second);
     }
     // restrict actual distance change
     double ddx=0.,ddy=0.;
-    it = dir.find(p1x());
+    it = dir.find(p1x(v));
     if (it != dir.end()) ddx += it->second;
-    it = dir.find(p1y());
+    it = dir.find(p1y(v));
     if (it != dir.end()) ddy += it->second;
-    it = dir.find(p2x());
+    it = dir.find(p2x(v));
     if (it != dir.end()) ddx -= it->second;
-    it = dir.find(p2y());
+    it = dir.find(p2y(v));
     if (it != dir.end()) ddy -= it->second;
     double dd = sqrt(ddx*ddx+ddy*ddy);
-    double dist  = *distance();
+    double dist  = *distance(v);
     if (dd > dist) {
-        double dx = (*p1x() - *p2x());
-        double dy = (*p1y() - *p2y());
+        double dx = (*p1x(v) - *p2x(v));
+        double dy = (*p1y(v) - *p2y(v));
         double d = sqrt(dx*dx + dy*dy);
         if (dd > d)
             lim = std::min(lim, std::max(d,dist)/dd);
@@ -252,7 +316,7 @@ ConstraintP2PAngle::ConstraintP2PAngle(Point &p1, Point &p2, double *a, double d
     pvec.push_back(p2.x);
     pvec.push_back(p2.y);
     pvec.push_back(a);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -266,11 +330,11 @@ void ConstraintP2PAngle::rescale(double coef)
     scale = coef * 1.;
 }
 
-double ConstraintP2PAngle::error()
+double ConstraintP2PAngle::evalError(const ParamView &v) const
 {
-    double dx = (*p2x() - *p1x());
-    double dy = (*p2y() - *p1y());
-    double a = *angle() + da;
+    double dx = (*p2x(v) - *p1x(v));
+    double dy = (*p2y(v) - *p1y(v));
+    double a = *angle(v) + da;
     double ca = cos(a);
     double sa = sin(a);
     double x = dx*ca + dy*sa;
@@ -278,14 +342,14 @@ double ConstraintP2PAngle::error()
     return scale * atan2(y,x);
 }
 
-double ConstraintP2PAngle::grad(double *param)
+double ConstraintP2PAngle::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
-    if (param == p1x() || param == p1y() ||
-        param == p2x() || param == p2y()) {
-        double dx = (*p2x() - *p1x());
-        double dy = (*p2y() - *p1y());
-        double a = *angle() + da;
+    if (param == p1x(v) || param == p1y(v) ||
+        param == p2x(v) || param == p2y(v)) {
+        double dx = (*p2x(v) - *p1x(v));
+        double dy = (*p2y(v) - *p1y(v));
+        double a = *angle(v) + da;
         double ca = cos(a);
         double sa = sin(a);
         double x = dx*ca + dy*sa;
@@ -293,20 +357,20 @@ double ConstraintP2PAngle::grad(double *param)
         double r2 = dx*dx+dy*dy;
         dx = -y/r2;
         dy = x/r2;
-        if (param == p1x()) deriv += (-ca*dx + sa*dy);
-        if (param == p1y()) deriv += (-sa*dx - ca*dy);
-        if (param == p2x()) deriv += ( ca*dx - sa*dy);
-        if (param == p2y()) deriv += ( sa*dx + ca*dy);
+        if (param == p1x(v)) deriv += (-ca*dx + sa*dy);
+        if (param == p1y(v)) deriv += (-sa*dx - ca*dy);
+        if (param == p2x(v)) deriv += ( ca*dx - sa*dy);
+        if (param == p2y(v)) deriv += ( sa*dx + ca*dy);
     }
-    if (param == angle()) deriv += -1;
+    if (param == angle(v)) deriv += -1;
 
     return scale * deriv;
 }
 
-double ConstraintP2PAngle::maxStep(MAP_pD_D &dir, double lim)
+double ConstraintP2PAngle::evalMaxStep(const ParamView &v, MAP_pD_D &dir, double lim) const
 {
-    // step(angle()) <= pi/18 = 10°
-    MAP_pD_D::iterator it = dir.find(angle());
+    // step(angle(v)) <= pi/18 = 10°
+    MAP_pD_D::iterator it = dir.find(angle(v));
     if (it != dir.end()) {
         double step = std::abs(it->second);
         if (step > M_PI/18.)
@@ -325,7 +389,7 @@ ConstraintP2LDistance::ConstraintP2LDistance(Point &p, Line &l, double *d)
     pvec.push_back(l.p2.x);
     pvec.push_back(l.p2.y);
     pvec.push_back(d);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -339,11 +403,11 @@ void ConstraintP2LDistance::rescale(double coef)
     scale = coef;
 }
 
-double ConstraintP2LDistance::error()
+double ConstraintP2LDistance::evalError(const ParamView &v) const
 {
-    double x0=*p0x(), x1=*p1x(), x2=*p2x();
-    double y0=*p0y(), y1=*p1y(), y2=*p2y();
-    double dist = *distance();
+    double x0=*p0x(v), x1=*p1x(v), x2=*p2x(v);
+    double y0=*p0y(v), y1=*p1y(v), y2=*p2y(v);
+    double dist = *distance(v);
     double dx = x2-x1;
     double dy = y2-y1;
     double d = sqrt(dx*dx+dy*dy);
@@ -351,67 +415,67 @@ double ConstraintP2LDistance::error()
     return scale * (area/d - dist);
 }
 
-double ConstraintP2LDistance::grad(double *param)
+double ConstraintP2LDistance::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
     // darea/dx0 = (y1-y2)      darea/dy0 = (x2-x1)
     // darea/dx1 = (y2-y0)      darea/dy1 = (x0-x2)
     // darea/dx2 = (y0-y1)      darea/dy2 = (x1-x0)
-    if (param == p0x() || param == p0y() ||
-        param == p1x() || param == p1y() ||
-        param == p2x() || param == p2y()) {
-        double x0=*p0x(), x1=*p1x(), x2=*p2x();
-        double y0=*p0y(), y1=*p1y(), y2=*p2y();
+    if (param == p0x(v) || param == p0y(v) ||
+        param == p1x(v) || param == p1y(v) ||
+        param == p2x(v) || param == p2y(v)) {
+        double x0=*p0x(v), x1=*p1x(v), x2=*p2x(v);
+        double y0=*p0y(v), y1=*p1y(v), y2=*p2y(v);
         double dx = x2-x1;
         double dy = y2-y1;
         double d2 = dx*dx+dy*dy;
         double d = sqrt(d2);
         double area = -x0*dy+y0*dx+x1*y2-x2*y1;
-        if (param == p0x()) deriv += (y1-y2) / d;
-        if (param == p0y()) deriv += (x2-x1) / d ;
-        if (param == p1x()) deriv += ((y2-y0)*d + (dx/d)*area) / d2;
-        if (param == p1y()) deriv += ((x0-x2)*d + (dy/d)*area) / d2;
-        if (param == p2x()) deriv += ((y0-y1)*d - (dx/d)*area) / d2;
-        if (param == p2y()) deriv += ((x1-x0)*d - (dy/d)*area) / d2;
+        if (param == p0x(v)) deriv += (y1-y2) / d;
+        if (param == p0y(v)) deriv += (x2-x1) / d ;
+        if (param == p1x(v)) deriv += ((y2-y0)*d + (dx/d)*area) / d2;
+        if (param == p1y(v)) deriv += ((x0-x2)*d + (dy/d)*area) / d2;
+        if (param == p2x(v)) deriv += ((y0-y1)*d - (dx/d)*area) / d2;
+        if (param == p2y(v)) deriv += ((x1-x0)*d - (dy/d)*area) / d2;
         if (area < 0)
             deriv *= -1;
     }
-    if (param == distance()) deriv += -1;
+    if (param == distance(v)) deriv += -1;
 
     return scale * deriv;
 }
 
-double ConstraintP2LDistance::maxStep(MAP_pD_D &dir, double lim)
+double ConstraintP2LDistance::evalMaxStep(const ParamView &v, MAP_pD_D &dir, double lim) const
 {
     MAP_pD_D::iterator it;
-    // distance() >= 0
-    it = dir.find(distance());
+    // distance(v) >= 0
+    it = dir.find(distance(v));
     if (it != dir.end()) {
         if (it->second < 0.)
-            lim = std::min(lim, -(*distance()) / it->second);
+            lim = std::min(lim, -(*distance(v)) / it->second);
     }
     // restrict actual area change
     double darea=0.;
-    double x0=*p0x(), x1=*p1x(), x2=*p2x();
-    double y0=*p0y(), y1=*p1y(), y2=*p2y();
-    it = dir.find(p0x());
+    double x0=*p0x(v), x1=*p1x(v), x2=*p2x(v);
+    double y0=*p0y(v), y1=*p1y(v), y2=*p2y(v);
+    it = dir.find(p0x(v));
     if (it != dir.end()) darea += (y1-y2) * it->second;
-    it = dir.find(p0y());
+    it = dir.find(p0y(v));
     if (it != dir.end()) darea += (x2-x1) * it->second;
-    it = dir.find(p1x());
+    it = dir.find(p1x(v));
     if (it != dir.end()) darea += (y2-y0) * it->second;
-    it = dir.find(p1y());
+    it = dir.find(p1y(v));
     if (it != dir.end()) darea += (x0-x2) * it->second;
-    it = dir.find(p2x());
+    it = dir.find(p2x(v));
     if (it != dir.end()) darea += (y0-y1) * it->second;
-    it = dir.find(p2y());
+    it = dir.find(p2y(v));
     if (it != dir.end()) darea += (x1-x0) * it->second;
 
     darea = std::abs(darea);
     if (darea > 0.) {
         double dx = x2-x1;
         double dy = y2-y1;
-        double area = 0.3*(*distance())*sqrt(dx*dx+dy*dy);
+        double area = 0.3*(*distance(v))*sqrt(dx*dx+dy*dy);
         if (darea > area) {
             area = std::max(area, 0.3*std::abs(-x0*dy+y0*dx+x1*y2-x2*y1));
             if (darea > area)
@@ -430,7 +494,7 @@ ConstraintPointOnLine::ConstraintPointOnLine(Point &p, Line &l)
     pvec.push_back(l.p1.y);
     pvec.push_back(l.p2.x);
     pvec.push_back(l.p2.y);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -442,7 +506,7 @@ ConstraintPointOnLine::ConstraintPointOnLine(Point &p, Point &lp1, Point &lp2)
     pvec.push_back(lp1.y);
     pvec.push_back(lp2.x);
     pvec.push_back(lp2.y);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -456,10 +520,10 @@ void ConstraintPointOnLine::rescale(double coef)
     scale = coef;
 }
 
-double ConstraintPointOnLine::error()
+double ConstraintPointOnLine::evalError(const ParamView &v) const
 {
-    double x0=*p0x(), x1=*p1x(), x2=*p2x();
-    double y0=*p0y(), y1=*p1y(), y2=*p2y();
+    double x0=*p0x(v), x1=*p1x(v), x2=*p2x(v);
+    double y0=*p0y(v), y1=*p1y(v), y2=*p2y(v);
     double dx = x2-x1;
     double dy = y2-y1;
     double d = sqrt(dx*dx+dy*dy);
@@ -467,28 +531,28 @@ double ConstraintPointOnLine::error()
     return scale * area/d;
 }
 
-double ConstraintPointOnLine::grad(double *param)
+double ConstraintPointOnLine::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
     // darea/dx0 = (y1-y2)      darea/dy0 = (x2-x1)
     // darea/dx1 = (y2-y0)      darea/dy1 = (x0-x2)
     // darea/dx2 = (y0-y1)      darea/dy2 = (x1-x0)
-    if (param == p0x() || param == p0y() ||
-        param == p1x() || param == p1y() ||
-        param == p2x() || param == p2y()) {
-        double x0=*p0x(), x1=*p1x(), x2=*p2x();
-        double y0=*p0y(), y1=*p1y(), y2=*p2y();
+    if (param == p0x(v) || param == p0y(v) ||
+        param == p1x(v) || param == p1y(v) ||
+        param == p2x(v) || param == p2y(v)) {
+        double x0=*p0x(v), x1=*p1x(v), x2=*p2x(v);
+        double y0=*p0y(v), y1=*p1y(v), y2=*p2y(v);
         double dx = x2-x1;
         double dy = y2-y1;
         double d2 = dx*dx+dy*dy;
         double d = sqrt(d2);
         double area = -x0*dy+y0*dx+x1*y2-x2*y1;
-        if (param == p0x()) deriv += (y1-y2) / d;
-        if (param == p0y()) deriv += (x2-x1) / d ;
-        if (param == p1x()) deriv += ((y2-y0)*d + (dx/d)*area) / d2;
-        if (param == p1y()) deriv += ((x0-x2)*d + (dy/d)*area) / d2;
-        if (param == p2x()) deriv += ((y0-y1)*d - (dx/d)*area) / d2;
-        if (param == p2y()) deriv += ((x1-x0)*d - (dy/d)*area) / d2;
+        if (param == p0x(v)) deriv += (y1-y2) / d;
+        if (param == p0y(v)) deriv += (x2-x1) / d ;
+        if (param == p1x(v)) deriv += ((y2-y0)*d + (dx/d)*area) / d2;
+        if (param == p1y(v)) deriv += ((x0-x2)*d + (dy/d)*area) / d2;
+        if (param == p2x(v)) deriv += ((y0-y1)*d - (dx/d)*area) / d2;
+        if (param == p2y(v)) deriv += ((x1-x0)*d - (dy/d)*area) / d2;
     }
     return scale * deriv;
 }
@@ -502,7 +566,7 @@ ConstraintPointOnPerpBisector::ConstraintPointOnPerpBisector(Point &p, Line &l)
     pvec.push_back(l.p1.y);
     pvec.push_back(l.p2.x);
     pvec.push_back(l.p2.y);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -514,7 +578,7 @@ ConstraintPointOnPerpBisector::ConstraintPointOnPerpBisector(Point &p, Point &lp
     pvec.push_back(lp1.y);
     pvec.push_back(lp2.x);
     pvec.push_back(lp2.y);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -528,11 +592,11 @@ void ConstraintPointOnPerpBisector::rescale(double coef)
     scale = coef;
 }
 
-void ConstraintPointOnPerpBisector::errorgrad(double *err, double *grad, double *param)
+void ConstraintPointOnPerpBisector::errorgrad(const ParamView &v, double *err, double *grad, double *param) const
 {
-    DeriVector2 p0(Point(p0x(),p0y()), param);
-    DeriVector2 p1(Point(p1x(),p1y()), param);
-    DeriVector2 p2(Point(p2x(),p2y()), param);
+    DeriVector2 p0(Point(p0x(v),p0y(v)), param);
+    DeriVector2 p1(Point(p1x(v),p1y(v)), param);
+    DeriVector2 p2(Point(p2x(v),p2y(v)), param);
     
     DeriVector2 d1 = p0.subtr(p1);
     DeriVector2 d2 = p0.subtr(p2);
@@ -550,20 +614,20 @@ void ConstraintPointOnPerpBisector::errorgrad(double *err, double *grad, double
         *grad = dprojd1+dprojd2;
 }
 
-double ConstraintPointOnPerpBisector::error()
+double ConstraintPointOnPerpBisector::evalError(const ParamView &v) const
 {
     double err;
-    errorgrad(&err,0,0);
+    errorgrad(v, &err,0,0);
     return scale * err;
 }
 
-double ConstraintPointOnPerpBisector::grad(double *param)
+double ConstraintPointOnPerpBisector::evalGrad(const ParamView &v, double *param) const
 {
     //first of all, check that we need to compute anything.
-    if ( findParamInPvec(param) == -1  ) return 0.0;
+    if ( v.find(param) == -1  ) return 0.0;
 
     double deriv;
-    errorgrad(0, &deriv, param);
+    errorgrad(v, 0, &deriv, param);
 
     return deriv*scale;
 }
@@ -579,7 +643,7 @@ ConstraintParallel::ConstraintParallel(Line &l1, Line &l2)
     pvec.push_back(l2.p1.y);
     pvec.push_back(l2.p2.x);
     pvec.push_back(l2.p2.y);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -590,34 +654,35 @@ ConstraintType ConstraintParallel::getTypeId()
 
 void ConstraintParallel::rescale(double coef)
 {
-    double dx1 = (*l1p1x() - *l1p2x());
-    double dy1 = (*l1p1y() - *l1p2y());
-    double dx2 = (*l2p1x() - *l2p2x());
-    double dy2 = (*l2p1y() - *l2p2y());
+    const ParamView &v = own;
+    double dx1 = (*l1p1x(v) - *l1p2x(v));
+    double dy1 = (*l1p1y(v) - *l1p2y(v));
+    double dx2 = (*l2p1x(v) - *l2p2x(v));
+    double dy2 = (*l2p1y(v) - *l2p2y(v));
     scale = coef / sqrt((dx1*dx1+dy1*dy1)*(dx2*dx2+dy2*dy2));
 }
 
-double ConstraintParallel::error()
+double ConstraintParallel::evalError(const ParamView &v) const
 {
-    double dx1 = (*l1p1x() - *l1p2x());
-    double dy1 = (*l1p1y() - *l1p2y());
-    double dx2 = (*l2p1x() - *l2p2x());
-    double dy2 = (*l2p1y() - *l2p2y());
+    double dx1 = (*l1p1x(v) - *l1p2x(v));
+    double dy1 = (*l1p1y(v) - *l1p2y(v));
+    double dx2 = (*l2p1x(v) - *l2p2x(v));
+    double dy2 = (*l2p1y(v) - *l2p2y(v));
     return scale * (dx1*dy2 - dy1*dx2);
 }
 
-double ConstraintParallel::grad(double *param)
+double ConstraintParallel::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
-    if (param == l1p1x()) deriv += (*l2p1y() - *l2p2y()); // = dy2
-    if (param == l1p2x()) deriv += -(*l2p1y() - *l2p2y()); // = -dy2
-    if (param == l1p1y()) deriv += -(*l2p1x() - *l2p2x()); // = -dx2
-    if (param == l1p2y()) deriv += (*l2p1x() - *l2p2x()); // = dx2
+    if (param == l1p1x(v)) deriv += (*l2p1y(v) - *l2p2y(v)); // = dy2
+    if (param == l1p2x(v)) deriv += -(*l2p1y(v) - *l2p2y(v)); // = -dy2
+    if (param == l1p1y(v)) deriv += -(*l2p1x(v) - *l2p2x(v)); // = -dx2
+    if (param == l1p2y(v)) deriv += (*l2p1x(v) - *l2p2x(v)); // = dx2
 
-    if (param == l2p1x()) deriv += -(*l1p1y() - *l1p2y()); // = -dy1
-    if (param == l2p2x()) deriv += (*l1p1y() - *l1p2y()); // = dy1
-    if (param == l2p1y()) deriv += (*l1p1x() - *l1p2x()); // = dx1
-    if (param == l2p2y()) deriv += -(*l1p1x() - *l1p2x()); // = -dx1
+    if (param == l2p1x(v)) deriv += -(*l1p1y(v) - *l1p2y(v)); // = -dy1
+    if (param == l2p2x(v)) deriv += (*l1p1y(v) - *l1p2y(v)); // = dy1
+    if (param == l2p1y(v)) deriv += (*l1p1x(v) - *l1p2x(v)); // = dx1
+    if (param == l2p2y(v)) deriv += -(*l1p1x(v) - *l1p2x(v)); // = -dx1
 
     return scale * deriv;
 }
@@ -633,7 +698,7 @@ ConstraintPerpendicular::ConstraintPerpendicular(Line &l1, Line &l2)
     pvec.push_back(l2.p1.y);
     pvec.push_back(l2.p2.x);
     pvec.push_back(l2.p2.y);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -648,7 +713,7 @@ ConstraintPerpendicular::ConstraintPerpendicular(Point &l1p1, Point &l1p2,
     pvec.push_back(l2p1.y);
     pvec.push_back(l2p2.x);
     pvec.push_back(l2p2.y);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -659,34 +724,35 @@ ConstraintType ConstraintPerpendicular::getTypeId()
 
 void ConstraintPerpendicular::rescale(double coef)
 {
-    double dx1 = (*l1p1x() - *l1p2x());
-    double dy1 = (*l1p1y() - *l1p2y());
-    double dx2 = (*l2p1x() - *l2p2x());
-    double dy2 = (*l2p1y() - *l2p2y());
+    const ParamView &v = own;
+    double dx1 = (*l1p1x(v) - *l1p2x(v));
+    double dy1 = (*l1p1y(v) - *l1p2y(v));
+    double dx2 = (*l2p1x(v) - *l2p2x(v));
+    double dy2 = (*l2p1y(v) - *l2p2y(v));
     scale = coef / sqrt((dx1*dx1+dy1*dy1)*(dx2*dx2+dy2*dy2));
 }
 
-double ConstraintPerpendicular::error()
+double ConstraintPerpendicular::evalError(const ParamView &v) const
 {
-    double dx1 = (*l1p1x() - *l1p2x());
-    double dy1 = (*l1p1y() - *l1p2y());
-    double dx2 = (*l2p1x() - *l2p2x());
-    double dy2 = (*l2p1y() - *l2p2y());
+    double dx1 = (*l1p1x(v) - *l1p2x(v));
+    double dy1 = (*l1p1y(v) - *l1p2y(v));
+    double dx2 = (*l2p1x(v) - *l2p2x(v));
+    double dy2 = (*l2p1y(v) - *l2p2y(v));
     return scale * (dx1*dx2 + dy1*dy2);
 }
 
-double ConstraintPerpendicular::grad(double *param)
+double ConstraintPerpendicular::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
-    if (param == l1p1x()) deriv += (*l2p1x() - *l2p2x()); // = dx2
-    if (param == l1p2x()) deriv += -(*l2p1x() - *l2p2x()); // = -dx2
-    if (param == l1p1y()) deriv += (*l2p1y() - *l2p2y()); // = dy2
-    if (param == l1p2y()) deriv += -(*l2p1y() - *l2p2y()); // = -dy2
+    if (param == l1p1x(v)) deriv += (*l2p1x(v) - *l2p2x(v)); // = dx2
+    if (param == l1p2x(v)) deriv += -(*l2p1x(v) - *l2p2x(v)); // = -dx2
+    if (param == l1p1y(v)) deriv += (*l2p1y(v) - *l2p2y(v)); // = dy2
+    if (param == l1p2y(v)) deriv += -(*l2p1y(v) - *l2p2y(v)); // = -dy2
 
-    if (param == l2p1x()) deriv += (*l1p1x() - *l1p2x()); // = dx1
-    if (param == l2p2x()) deriv += -(*l1p1x() - *l1p2x()); // = -dx1
-    if (param == l2p1y()) deriv += (*l1p1y() - *l1p2y()); // = dy1
-    if (param == l2p2y()) deriv += -(*l1p1y() - *l1p2y()); // = -dy1
+    if (param == l2p1x(v)) deriv += (*l1p1x(v) - *l1p2x(v)); // = dx1
+    if (param == l2p2x(v)) deriv += -(*l1p1x(v) - *l1p2x(v)); // = -dx1
+    if (param == l2p1y(v)) deriv += (*l1p1y(v) - *l1p2y(v)); // = dy1
+    if (param == l2p2y(v)) deriv += -(*l1p1y(v) - *l1p2y(v)); // = -dy1
 
     return scale * deriv;
 }
@@ -703,7 +769,7 @@ ConstraintL2LAngle::ConstraintL2LAngle(Line &l1, Line &l2, double *a)
     pvec.push_back(l2.p2.x);
     pvec.push_back(l2.p2.y);
     pvec.push_back(a);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -719,7 +785,7 @@ ConstraintL2LAngle::ConstraintL2LAngle(Point &l1p1, Point &l1p2,
     pvec.push_back(l2p2.x);
     pvec.push_back(l2p2.y);
     pvec.push_back(a);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -733,13 +799,13 @@ void ConstraintL2LAngle::rescale(double coef)
     scale = coef * 1.;
 }
 
-double ConstraintL2LAngle::error()
+double ConstraintL2LAngle::evalError(const ParamView &v) const
 {
-    double dx1 = (*l1p2x() - *l1p1x());
-    double dy1 = (*l1p2y() - *l1p1y());
-    double dx2 = (*l2p2x() - *l2p1x());
-    double dy2 = (*l2p2y() - *l2p1y());
-    double a = atan2(dy1,dx1) + *angle();
+    double dx1 = (*l1p2x(v) - *l1p1x(v));
+    double dy1 = (*l1p2y(v) - *l1p1y(v));
+    double dx2 = (*l2p2x(v) - *l2p1x(v));
+    double dy2 = (*l2p2y(v) - *l2p1y(v));
+    double a = atan2(dy1,dx1) + *angle(v);
     double ca = cos(a);
     double sa = sin(a);
     double x2 = dx2*ca + dy2*sa;
@@ -747,26 +813,26 @@ double ConstraintL2LAngle::error()
     return scale * atan2(y2,x2);
 }
 
-double ConstraintL2LAngle::grad(double *param)
+double ConstraintL2LAngle::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
-    if (param == l1p1x() || param == l1p1y() ||
-        param == l1p2x() || param == l1p2y()) {
-        double dx1 = (*l1p2x() - *l1p1x());
-        double dy1 = (*l1p2y() - *l1p1y());
+    if (param == l1p1x(v) || param == l1p1y(v) ||
+        param == l1p2x(v) || param == l1p2y(v)) {
+        double dx1 = (*l1p2x(v) - *l1p1x(v));
+        double dy1 = (*l1p2y(v) - *l1p1y(v));
         double r2 = dx1*dx1+dy1*dy1;
-        if (param == l1p1x()) deriv += -dy1/r2;
-        if (param == l1p1y()) deriv += dx1/r2;
-        if (param == l1p2x()) deriv += dy1/r2;
-        if (param == l1p2y()) deriv += -dx1/r2;
+        if (param == l1p1x(v)) deriv += -dy1/r2;
+        if (param == l1p1y(v)) deriv += dx1/r2;
+        if (param == l1p2x(v)) deriv += dy1/r2;
+        if (param == l1p2y(v)) deriv += -dx1/r2;
     }
-    if (param == l2p1x() || param == l2p1y() ||
-        param == l2p2x() || param == l2p2y()) {
-        double dx1 = (*l1p2x() - *l1p1x());
-        double dy1 = (*l1p2y() - *l1p1y());
-        double dx2 = (*l2p2x() - *l2p1x());
-        double dy2 = (*l2p2y() - *l2p1y());
-        double a = atan2(dy1,dx1) + *angle();
+    if (param == l2p1x(v) || param == l2p1y(v) ||
+        param == l2p2x(v) || param == l2p2y(v)) {
+        double dx1 = (*l1p2x(v) - *l1p1x(v));
+        double dy1 = (*l1p2y(v) - *l1p1y(v));
+        double dx2 = (*l2p2x(v) - *l2p1x(v));
+        double dy2 = (*l2p2y(v) - *l2p1y(v));
+        double a = atan2(dy1,dx1) + *angle(v);
         double ca = cos(a);
         double sa = sin(a);
         double x2 = dx2*ca + dy2*sa;
@@ -774,20 +840,20 @@ double ConstraintL2LAngle::grad(double *param)
         double r2 = dx2*dx2+dy2*dy2;
         dx2 = -y2/r2;
         dy2 = x2/r2;
-        if (param == l2p1x()) deriv += (-ca*dx2 + sa*dy2);
-        if (param == l2p1y()) deriv += (-sa*dx2 - ca*dy2);
-        if (param == l2p2x()) deriv += ( ca*dx2 - sa*dy2);
-        if (param == l2p2y()) deriv += ( sa*dx2 + ca*dy2);
+        if (param == l2p1x(v)) deriv += (-ca*dx2 + sa*dy2);
+        if (param == l2p1y(v)) deriv += (-sa*dx2 - ca*dy2);
+        if (param == l2p2x(v)) deriv += ( ca*dx2 - sa*dy2);
+        if (param == l2p2y(v)) deriv += ( sa*dx2 + ca*dy2);
     }
-    if (param == angle()) deriv += -1;
+    if (param == angle(v)) deriv += -1;
 
     return scale * deriv;
 }
 
-double ConstraintL2LAngle::maxStep(MAP_pD_D &dir, double lim)
+double ConstraintL2LAngle::evalMaxStep(const ParamView &v, MAP_pD_D &dir, double lim) const
 {
-    // step(angle()) <= pi/18 = 10°
-    MAP_pD_D::iterator it = dir.find(angle());
+    // step(angle(v)) <= pi/18 = 10°
+    MAP_pD_D::iterator it = dir.find(angle(v));
     if (it != dir.end()) {
         double step = std::abs(it->second);
         if (step > M_PI/18.)
@@ -807,7 +873,7 @@ ConstraintMidpointOnLine::ConstraintMidpointOnLine(Line &l1, Line &l2)
     pvec.push_back(l2.p1.y);
     pvec.push_back(l2.p2.x);
     pvec.push_back(l2.p2.y);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -821,7 +887,7 @@ ConstraintMidpointOnLine::ConstraintMidpointOnLine(Point &l1p1, Point &l1p2, Poi
     pvec.push_back(l2p1.y);
     pvec.push_back(l2p2.x);
     pvec.push_back(l2p2.y);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -835,12 +901,12 @@ void ConstraintMidpointOnLine::rescale(double coef)
     scale = coef * 1;
 }
 
-double ConstraintMidpointOnLine::error()
+double ConstraintMidpointOnLine::evalError(const ParamView &v) const
 {
-    double x0=((*l1p1x())+(*l1p2x()))/2;
-    double y0=((*l1p1y())+(*l1p2y()))/2;
-    double x1=*l2p1x(), x2=*l2p2x();
-    double y1=*l2p1y(), y2=*l2p2y();
+    double x0=((*l1p1x(v))+(*l1p2x(v)))/2;
+    double y0=((*l1p1y(v))+(*l1p2y(v)))/2;
+    double x1=*l2p1x(v), x2=*l2p2x(v);
+    double y1=*l2p1y(v), y2=*l2p2y(v);
     double dx = x2-x1;
     double dy = y2-y1;
     double d = sqrt(dx*dx+dy*dy);
@@ -848,33 +914,33 @@ double ConstraintMidpointOnLine::error()
     return scale * area/d;
 }
 
-double ConstraintMidpointOnLine::grad(double *param)
+double ConstraintMidpointOnLine::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
     // darea/dx0 = (y1-y2)      darea/dy0 = (x2-x1)
     // darea/dx1 = (y2-y0)      darea/dy1 = (x0-x2)
     // darea/dx2 = (y0-y1)      darea/dy2 = (x1-x0)
-    if (param == l1p1x() || param == l1p1y() ||
-        param == l1p2x() || param == l1p2y()||
-        param == l2p1x() || param == l2p1y() ||
-        param == l2p2x() || param == l2p2y()) {
-        double x0=((*l1p1x())+(*l1p2x()))/2;
-        double y0=((*l1p1y())+(*l1p2y()))/2;
-        double x1=*l2p1x(), x2=*l2p2x();
-        double y1=*l2p1y(), y2=*l2p2y();
+    if (param == l1p1x(v) || param == l1p1y(v) ||
+        param == l1p2x(v) || param == l1p2y(v)||
+        param == l2p1x(v) || param == l2p1y(v) ||
+        param == l2p2x(v) || param == l2p2y(v)) {
+        double x0=((*l1p1x(v))+(*l1p2x(v)))/2;
+        double y0=((*l1p1y(v))+(*l1p2y(v)))/2;
+        double x1=*l2p1x(v), x2=*l2p2x(v);
+        double y1=*l2p1y(v), y2=*l2p2y(v);
         double dx = x2-x1;
         double dy = y2-y1;
         double d2 = dx*dx+dy*dy;
         double d = sqrt(d2);
         double area = -x0*dy+y0*dx+x1*y2-x2*y1;
-        if (param == l1p1x()) deriv += (y1-y2) / (2*d);
-        if (param == l1p1y()) deriv += (x2-x1) / (2*d);
-        if (param == l1p2x()) deriv += (y1-y2) / (2*d);
-        if (param == l1p2y()) deriv += (x2-x1) / (2*d);
-        if (param == l2p1x()) deriv += ((y2-y0)*d + (dx/d)*area) / d2;
-        if (param == l2p1y()) deriv += ((x0-x2)*d + (dy/d)*area) / d2;
-        if (param == l2p2x()) deriv += ((y0-y1)*d - (dx/d)*area) / d2;
-        if (param == l2p2y()) deriv += ((x1-x0)*d - (dy/d)*area) / d2;
+        if (param == l1p1x(v)) deriv += (y1-y2) / (2*d);
+        if (param == l1p1y(v)) deriv += (x2-x1) / (2*d);
+        if (param == l1p2x(v)) deriv += (y1-y2) / (2*d);
+        if (param == l1p2y(v)) deriv += (x2-x1) / (2*d);
+        if (param == l2p1x(v)) deriv += ((y2-y0)*d + (dx/d)*area) / d2;
+        if (param == l2p1y(v)) deriv += ((x0-x2)*d + (dy/d)*area) / d2;
+        if (param == l2p2x(v)) deriv += ((y0-y1)*d - (dx/d)*area) / d2;
+        if (param == l2p2y(v)) deriv += ((x1-x0)*d - (dy/d)*area) / d2;
     }
     return scale * deriv;
 }
@@ -890,7 +956,7 @@ ConstraintTangentCircumf::ConstraintTangentCircumf(Point &p1, Point &p2,
     pvec.push_back(p2.y);
     pvec.push_back(rad1);
     pvec.push_back(rad2);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -904,36 +970,36 @@ void ConstraintTangentCircumf::rescale(double coef)
     scale = coef * 1;
 }
 
-double ConstraintTangentCircumf::error()
+double ConstraintTangentCircumf::evalError(const ParamView &v) const
 {
-    double dx = (*c1x() - *c2x());
-    double dy = (*c1y() - *c2y());
+    double dx = (*c1x(v) - *c2x(v));
+    double dy = (*c1y(v) - *c2y(v));
     if (internal)
-        return scale * (sqrt(dx*dx + dy*dy) - std::abs(*r1() - *r2()));
+        return scale * (sqrt(dx*dx + dy*dy) - std::abs(*r1(v) - *r2(v)));
     else
-        return scale * (sqrt(dx*dx + dy*dy) - (*r1() + *r2()));
+        return scale * (sqrt(dx*dx + dy*dy) - (*r1(v) + *r2(v)));
 }
 
-double ConstraintTangentCircumf::grad(double *param)
+double ConstraintTangentCircumf::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
-    if (param == c1x() || param == c1y() ||
-        param == c2x() || param == c2y()||
-        param == r1() || param == r2()) {
-        double dx = (*c1x() - *c2x());
-        double dy = (*c1y() - *c2y());
+    if (param == c1x(v) || param == c1y(v) ||
+        param == c2x(v) || param == c2y(v)||
+        param == r1(v) || param == r2(v)) {
+        double dx = (*c1x(v) - *c2x(v));
+        double dy = (*c1y(v) - *c2y(v));
         double d = sqrt(dx*dx + dy*dy);
-        if (param == c1x()) deriv += dx/d;
-        if (param == c1y()) deriv += dy/d;
-        if (param == c2x()) deriv += -dx/d;
-        if (param == c2y()) deriv += -dy/d;
+        if (param == c1x(v)) deriv += dx/d;
+        if (param == c1y(v)) deriv += dy/d;
+        if (param == c2x(v)) deriv += -dx/d;
+        if (param == c2y(v)) deriv += -dy/d;
         if (internal) {
-            if (param == r1()) deriv += (*r1() > *r2()) ? -1 : 1;
-            if (param == r2()) deriv += (*r1() > *r2()) ? 1 : -1;
+            if (param == r1(v)) deriv += (*r1(v) > *r2(v)) ? -1 : 1;
+            if (param == r2(v)) deriv += (*r1(v) > *r2(v)) ? 1 : -1;
         }
         else {
-            if (param == r1()) deriv += -1;
-            if (param == r2()) deriv += -1;
+            if (param == r1(v)) deriv += -1;
+            if (param == r2(v)) deriv += -1;
         }
     }
     return scale * deriv;
@@ -949,7 +1015,7 @@ ConstraintPointOnEllipse::ConstraintPointOnEllipse(Point &p, Ellipse &e)
     pvec.push_back(e.focus1.x);
     pvec.push_back(e.focus1.y);
     pvec.push_back(e.radmin);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -963,15 +1029,15 @@ void ConstraintPointOnEllipse::rescale(double coef)
     scale = coef * 1;
 }
 
-double ConstraintPointOnEllipse::error()
+double ConstraintPointOnEllipse::evalError(const ParamView &v) const
 {    
-    double X_0 = *p1x();
-    double Y_0 = *p1y();
-    double X_c = *cx();
-    double Y_c = *cy();     
-    double X_F1 = *f1x();
-    double Y_F1 = *f1y();
-    double b = *rmin();
+    double X_0 = *p1x(v);
+    double Y_0 = *p1y(v);
+    double X_c = *cx(v);
+    double Y_c = *cy(v);     
+    double X_F1 = *f1x(v);
+    double Y_F1 = *f1y(v);
+    double b = *rmin(v);
     
     double err=sqrt(pow(X_0 - X_F1, 2) + pow(Y_0 - Y_F1, 2)) + sqrt(pow(X_0 +
         X_F1 - 2*X_c, 2) + pow(Y_0 + Y_F1 - 2*Y_c, 2)) - 2*sqrt(pow(b, 2) +
@@ -979,49 +1045,49 @@ double ConstraintPointOnEllipse::error()
     return scale * err;
 }
 
-double ConstraintPointOnEllipse::grad(double *param)
+double ConstraintPointOnEllipse::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
-    if (param == p1x() || param == p1y() ||
-        param == f1x() || param == f1y() ||
-        param == cx() || param == cy() ||
-        param == rmin()) {
-
-        double X_0 = *p1x();
-        double Y_0 = *p1y();
-        double X_c = *cx();
-        double Y_c = *cy();
-        double X_F1 = *f1x();
-        double Y_F1 = *f1y();
-        double b = *rmin();
-
-        if (param == p1x())
+    if (param == p1x(v) || param == p1y(v) ||
+        param == f1x(v) || param == f1y(v) ||
+        param == cx(v) || param == cy(v) ||
+        param == rmin(v)) {
+
+        double X_0 = *p1x(v);
+        double Y_0 = *p1y(v);
+        double X_c = *cx(v);
+        double Y_c = *cy(v);
+        double X_F1 = *f1x(v);
+        double Y_F1 = *f1y(v);
+        double b = *rmin(v);
+
+        if (param == p1x(v))
             deriv += (X_0 - X_F1)/sqrt(pow(X_0 - X_F1, 2) + pow(Y_0 - Y_F1, 2)) +
                 (X_0 + X_F1 - 2*X_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) + pow(Y_0 + Y_F1 -
                 2*Y_c, 2));
-        if (param == p1y())
+        if (param == p1y(v))
             deriv += (Y_0 - Y_F1)/sqrt(pow(X_0 - X_F1, 2) + pow(Y_0 - Y_F1, 2)) +
                 (Y_0 + Y_F1 - 2*Y_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) + pow(Y_0 + Y_F1 -
                 2*Y_c, 2));
-        if (param == f1x())
+        if (param == f1x(v))
             deriv += -(X_0 - X_F1)/sqrt(pow(X_0 - X_F1, 2) + pow(Y_0 - Y_F1, 2)) -
                 2*(X_F1 - X_c)/sqrt(pow(b, 2) + pow(X_F1 - X_c, 2) + pow(Y_F1 - Y_c, 2))
                 + (X_0 + X_F1 - 2*X_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) + pow(Y_0 + Y_F1
                 - 2*Y_c, 2));
-        if (param == f1y())
+        if (param == f1y(v))
             deriv +=-(Y_0 - Y_F1)/sqrt(pow(X_0 - X_F1, 2) + pow(Y_0 - Y_F1, 2)) -
                 2*(Y_F1 - Y_c)/sqrt(pow(b, 2) + pow(X_F1 - X_c, 2) + pow(Y_F1 - Y_c, 2))
                 + (Y_0 + Y_F1 - 2*Y_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) + pow(Y_0 + Y_F1
                 - 2*Y_c, 2));
-        if (param == cx())
+        if (param == cx(v))
             deriv += 2*(X_F1 - X_c)/sqrt(pow(b, 2) + pow(X_F1 - X_c, 2) + pow(Y_F1
                 - Y_c, 2)) - 2*(X_0 + X_F1 - 2*X_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) +
                 pow(Y_0 + Y_F1 - 2*Y_c, 2));
-        if (param == cy())
+        if (param == cy(v))
             deriv +=2*(Y_F1 - Y_c)/sqrt(pow(b, 2) + pow(X_F1 - X_c, 2) + pow(Y_F1
                 - Y_c, 2)) - 2*(Y_0 + Y_F1 - 2*Y_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) +
                 pow(Y_0 + Y_F1 - 2*Y_c, 2));
-        if (param == rmin())
+        if (param == rmin(v))
             deriv += -2*b/sqrt(pow(b, 2) + pow(X_F1 - X_c, 2) + pow(Y_F1 - Y_c,
                 2));
     }
@@ -1036,17 +1102,17 @@ ConstraintEllipseTangentLine::ConstraintEllipseTangentLine(Line &l, Ellipse &e)
 
     this->e = e;
     this->e.PushOwnParams(pvec);//DeepSOIC: hopefully, this won't push arc's parameters
-    origpvec = pvec;
-    pvecChangedFlag = true;
+    bindOwn();
     rescale();
 }
 
-void ConstraintEllipseTangentLine::ReconstructGeomPointers()
+void ConstraintEllipseTangentLine::bindGeometry(ParamView &v) const
 {
     int i=0;
-    l.ReconstructOnNewPvec(pvec, i);
-    e.ReconstructOnNewPvec(pvec, i);
-    pvecChangedFlag = false;
+    v.curves.emplace_back(new Line(l));
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
+    v.curves.emplace_back(new Ellipse(e));
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
 }
 
 ConstraintType ConstraintEllipseTangentLine::getTypeId()
@@ -1059,12 +1125,13 @@ void ConstraintEllipseTangentLine::rescale(double coef)
     scale = coef * 1;
 }
 
-void ConstraintEllipseTangentLine::errorgrad(double *err, double *grad, double *param)
+void ConstraintEllipseTangentLine::errorgrad(const ParamView &v, double *err, double *grad, double *param) const
 {
+    Line &l = static_cast<Line&>(*v.curves[0]);
+    Ellipse &e = static_cast<Ellipse&>(*v.curves[1]);
+
     // DeepSOIC equation
     // http://forum.freecadweb.org/viewtopic.php?f=10&t=7520&start=140
-
-    if (pvecChangedFlag) ReconstructGeomPointers();
     DeriVector2 p1 (l.p1, param);
     DeriVector2 p2 (l.p2, param);
     DeriVector2 f1 (e.focus1, param);
@@ -1092,20 +1159,20 @@ void ConstraintEllipseTangentLine::errorgrad(double *err, double *grad, double *
         *grad = ddistF1mF2 - 2*dradmaj;
 }
 
-double ConstraintEllipseTangentLine::error()
+double ConstraintEllipseTangentLine::evalError(const ParamView &v) const
 {
     double err;
-    errorgrad(&err,0,0);
+    errorgrad(v, &err,0,0);
     return scale * err;
 }
 
-double ConstraintEllipseTangentLine::grad(double *param)
+double ConstraintEllipseTangentLine::evalGrad(const ParamView &v, double *param) const
 {      
     //first of all, check that we need to compute anything.
-    if ( findParamInPvec(param) == -1 ) return 0.0;
+    if ( v.find(param) == -1 ) return 0.0;
 
     double deriv;
-    errorgrad(0, &deriv, param);
+    errorgrad(v, 0, &deriv, param);
 
     //use numeric for testing
     #if 0
@@ -1137,17 +1204,15 @@ ConstraintInternalAlignmentPoint2Ellipse::ConstraintInternalAlignmentPoint2Ellip
     this->e = e;
     this->e.PushOwnParams(pvec);
     this->AlignmentType = alignmentType;
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
-void ConstraintInternalAlignmentPoint2Ellipse::ReconstructGeomPointers()
+void ConstraintInternalAlignmentPoint2Ellipse::bindGeometry(ParamView &v) const
 {
-    int i = 0;
-    p.x = pvec[i]; i++;
-    p.y = pvec[i]; i++;
-    e.ReconstructOnNewPvec(pvec, i);
-    pvecChangedFlag = false;
+    int i = 2; // after the point
+    v.curves.emplace_back(new Ellipse(e));
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
 }
 
 ConstraintType ConstraintInternalAlignmentPoint2Ellipse::getTypeId()
@@ -1160,15 +1225,16 @@ void ConstraintInternalAlignmentPoint2Ellipse::rescale(double coef)
     scale = coef * 1;
 }
 
-void ConstraintInternalAlignmentPoint2Ellipse::errorgrad(double *err, double *grad, double *param)
+void ConstraintInternalAlignmentPoint2Ellipse::errorgrad(const ParamView &v, double *err, double *grad, double *param) const
 {
-    if (pvecChangedFlag) ReconstructGeomPointers();
+    Point p(v.pvec[0], v.pvec[1]);
+    Ellipse &e = static_cast<Ellipse&>(*v.curves[0]);
 
     //todo: prefill only what's needed, not everything
 
     DeriVector2 c(e.center, param);
     DeriVector2 f1(e.focus1, param);
-    DeriVector2 emaj = f1.subtr(c).getNormalized();
+    DeriVector2 emaj = e.getMajorAxis(c, f1);
     DeriVector2 emin = emaj.rotate90ccw();
     DeriVector2 pv (p, param);
     double b, db;//minor radius
@@ -1217,21 +1283,21 @@ void ConstraintInternalAlignmentPoint2Ellipse::errorgrad(double *err, double *gr
         *grad = by_y_not_by_x ? pv.dy - poa.dy : pv.dx - poa.dx;
 }
 
-double ConstraintInternalAlignmentPoint2Ellipse::error()
+double ConstraintInternalAlignmentPoint2Ellipse::evalError(const ParamView &v) const
 {    
     double err;
-    errorgrad(&err,0,0);
+    errorgrad(v, &err,0,0);
     return scale * err;
 
 }
 
-double ConstraintInternalAlignmentPoint2Ellipse::grad(double *param)
+double ConstraintInternalAlignmentPoint2Ellipse::evalGrad(const ParamView &v, double *param) const
 {      
     //first of all, check that we need to compute anything.
-    if ( findParamInPvec(param) == -1  ) return 0.0;
+    if ( v.find(param) == -1  ) return 0.0;
 
     double deriv;
-    errorgrad(0, &deriv, param);
+    errorgrad(v, 0, &deriv, param);
 
     //use numeric for testing
     #if 0
@@ -1263,17 +1329,15 @@ ConstraintInternalAlignmentPoint2Hyperbola::ConstraintInternalAlignmentPoint2Hyp
     this->e = e;
     this->e.PushOwnParams(pvec);
     this->AlignmentType = alignmentType;
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
-void ConstraintInternalAlignmentPoint2Hyperbola::ReconstructGeomPointers()
+void ConstraintInternalAlignmentPoint2Hyperbola::bindGeometry(ParamView &v) const
 {
-    int i = 0;
-    p.x = pvec[i]; i++;
-    p.y = pvec[i]; i++;
-    e.ReconstructOnNewPvec(pvec, i);
-    pvecChangedFlag = false;
+    int i = 2; // after the point
+    v.curves.emplace_back(new Hyperbola(e));
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
 }
 
 ConstraintType ConstraintInternalAlignmentPoint2Hyperbola::getTypeId()
@@ -1286,15 +1350,16 @@ void ConstraintInternalAlignmentPoint2Hyperbola::rescale(double coef)
     scale = coef * 1;
 }
 
-void ConstraintInternalAlignmentPoint2Hyperbola::errorgrad(double *err, double *grad, double *param)
+void ConstraintInternalAlignmentPoint2Hyperbola::errorgrad(const ParamView &v, double *err, double *grad, double *param) const
 {
-    if (pvecChangedFlag) ReconstructGeomPointers();
+    Point p(v.pvec[0], v.pvec[1]);
+    Hyperbola &e = static_cast<Hyperbola&>(*v.curves[0]);
 
     //todo: prefill only what's needed, not everything
 
     DeriVector2 c(e.center, param);
     DeriVector2 f1(e.focus1, param);
-    DeriVector2 emaj = f1.subtr(c).getNormalized();
+    DeriVector2 emaj = e.getMajorAxis(c, f1);
     DeriVector2 emin = emaj.rotate90ccw();
     DeriVector2 pv (p, param);
 
@@ -1350,21 +1415,21 @@ void ConstraintInternalAlignmentPoint2Hyperbola::errorgrad(double *err, double *
         *grad = by_y_not_by_x ? pv.dy - poa.dy : pv.dx - poa.dx;
 }
 
-double ConstraintInternalAlignmentPoint2Hyperbola::error()
+double ConstraintInternalAlignmentPoint2Hyperbola::evalError(const ParamView &v) const
 {
     double err;
-    errorgrad(&err,0,0);
+    errorgrad(v, &err,0,0);
     return scale * err;
 
 }
 
-double ConstraintInternalAlignmentPoint2Hyperbola::grad(double *param)
+double ConstraintInternalAlignmentPoint2Hyperbola::evalGrad(const ParamView &v, double *param) const
 {
     //first of all, check that we need to compute anything.
-    if ( findParamInPvec(param) == -1  ) return 0.0;
+    if ( v.find(param) == -1  ) return 0.0;
 
     double deriv;
-    errorgrad(0, &deriv, param);
+    errorgrad(v, 0, &deriv, param);
 
     return deriv*scale;
 
@@ -1377,17 +1442,17 @@ ConstraintEqualMajorAxesConic:: ConstraintEqualMajorAxesConic(MajorRadiusConic *
     this->e1->PushOwnParams(pvec);
     this->e2 = a2;
     this->e2->PushOwnParams(pvec);
-    origpvec = pvec;
-    pvecChangedFlag = true;
+    bindOwn();
     rescale();
 }
 
-void ConstraintEqualMajorAxesConic::ReconstructGeomPointers()
+void ConstraintEqualMajorAxesConic::bindGeometry(ParamView &v) const
 {
     int i =0;
-    e1->ReconstructOnNewPvec(pvec, i);
-    e2->ReconstructOnNewPvec(pvec, i);
-    pvecChangedFlag = false;
+    v.curves.emplace_back(e1->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
+    v.curves.emplace_back(e2->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
 }
 
 ConstraintType ConstraintEqualMajorAxesConic::getTypeId()
@@ -1400,9 +1465,10 @@ void ConstraintEqualMajorAxesConic::rescale(double coef)
     scale = coef * 1;
 }
 
-void ConstraintEqualMajorAxesConic::errorgrad(double *err, double *grad, double *param)
+void ConstraintEqualMajorAxesConic::errorgrad(const ParamView &v, double *err, double *grad, double *param) const
 {
-    if (pvecChangedFlag) ReconstructGeomPointers();
+    MajorRadiusConic *e1 = static_cast<MajorRadiusConic*>(v.curves[0].get());
+    MajorRadiusConic *e2 = static_cast<MajorRadiusConic*>(v.curves[1].get());
     double a1, da1;
     a1 = e1->getRadMaj(param, da1);
     double a2, da2;
@@ -1413,20 +1479,20 @@ void ConstraintEqualMajorAxesConic::errorgrad(double *err, double *grad, double
         *grad = da2 - da1;
 }
 
-double ConstraintEqualMajorAxesConic::error()
+double ConstraintEqualMajorAxesConic::evalError(const ParamView &v) const
 {    
     double err;
-    errorgrad(&err,0,0);
+    errorgrad(v, &err,0,0);
     return scale * err;
 }
 
-double ConstraintEqualMajorAxesConic::grad(double *param)
+double ConstraintEqualMajorAxesConic::evalGrad(const ParamView &v, double *param) const
 {
     //first of all, check that we need to compute anything.
-    if ( findParamInPvec(param) == -1  ) return 0.0;
+    if ( v.find(param) == -1  ) return 0.0;
 
     double deriv;
-    errorgrad(0, &deriv, param);
+    errorgrad(v, 0, &deriv, param);
 
     return deriv * scale;
 }
@@ -1438,17 +1504,17 @@ ConstraintEqualFocalDistance:: ConstraintEqualFocalDistance(ArcOfParabola * a1,
     this->e1->PushOwnParams(pvec);
     this->e2 = a2;
     this->e2->PushOwnParams(pvec);
-    origpvec = pvec;
-    pvecChangedFlag = true;
+    bindOwn();
     rescale();
 }
 
-void ConstraintEqualFocalDistance::ReconstructGeomPointers()
+void ConstraintEqualFocalDistance::bindGeometry(ParamView &v) const
 {
     int i =0;
-    e1->ReconstructOnNewPvec(pvec, i);
-    e2->ReconstructOnNewPvec(pvec, i);
-    pvecChangedFlag = false;
+    v.curves.emplace_back(e1->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
+    v.curves.emplace_back(e2->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
 }
 
 ConstraintType ConstraintEqualFocalDistance::getTypeId()
@@ -1461,12 +1527,13 @@ void ConstraintEqualFocalDistance::rescale(double coef)
     scale = coef * 1;
 }
 
-void ConstraintEqualFocalDistance::errorgrad(double *err, double *grad, double *param)
+void ConstraintEqualFocalDistance::errorgrad(const ParamView &v, double *err, double *grad, double *param) const
 {
-    if (pvecChangedFlag) ReconstructGeomPointers();
+    ArcOfParabola *e1 = static_cast<ArcOfParabola*>(v.curves[0].get());
+    ArcOfParabola *e2 = static_cast<ArcOfParabola*>(v.curves[1].get());
 
-    DeriVector2 focus1(this->e1->focus1, param);
-    DeriVector2 vertex1(this->e1->vertex, param);
+    DeriVector2 focus1(e1->focus1, param);
+    DeriVector2 vertex1(e1->vertex, param);
 
     DeriVector2 focalvect1 = vertex1.subtr(focus1);
 
@@ -1474,8 +1541,8 @@ void ConstraintEqualFocalDistance::errorgrad(double *err, double *grad, double *
 
     focal1 = focalvect1.length(dfocal1);
 
-    DeriVector2 focus2(this->e2->focus1, param);
-    DeriVector2 vertex2(this->e2->vertex, param);
+    DeriVector2 focus2(e2->focus1, param);
+    DeriVector2 vertex2(e2->vertex, param);
 
     DeriVector2 focalvect2 = vertex2.subtr(focus2);
 
@@ -1489,20 +1556,20 @@ void ConstraintEqualFocalDistance::errorgrad(double *err, double *grad, double *
         *grad = dfocal2 - dfocal1;
 }
 
-double ConstraintEqualFocalDistance::error()
+double ConstraintEqualFocalDistance::evalError(const ParamView &v) const
 {    
     double err;
-    errorgrad(&err,0,0);
+    errorgrad(v, &err,0,0);
     return scale * err;
 }
 
-double ConstraintEqualFocalDistance::grad(double *param)
+double ConstraintEqualFocalDistance::evalGrad(const ParamView &v, double *param) const
 {
     //first of all, check that we need to compute anything.
-    if ( findParamInPvec(param) == -1  ) return 0.0;
+    if ( v.find(param) == -1  ) return 0.0;
 
     double deriv;
-    errorgrad(0, &deriv, param);
+    errorgrad(v, 0, &deriv, param);
 
     return deriv * scale;
 }
@@ -1516,8 +1583,8 @@ ConstraintCurveValue::ConstraintCurveValue(Point &p, double* pcoord, Curve& crv,
     pvec.push_back(u);
     crv.PushOwnParams(pvec);
     this->crv = crv.Copy();
-    pvecChangedFlag = true;
-    origpvec = pvec;
+    isSpline = dynamic_cast<BSpline *>(this->crv) != NULL;
+    bindOwn();
     rescale();
 }
 
@@ -1526,15 +1593,14 @@ ConstraintCurveValue::~ConstraintCurveValue()
     delete this->crv; this->crv = 0;
 }
 
-void ConstraintCurveValue::ReconstructGeomPointers()
+void ConstraintCurveValue::bindGeometry(ParamView &v) const
 {
     int i=0;
-    p.x=pvec[i]; i++;
-    p.y=pvec[i]; i++;
+    i++; i++;//the point
     i++;//we have an inline function for point coordinate
     i++;//we have an inline function for the parameterU
-    this->crv->ReconstructOnNewPvec(pvec, i);
-    pvecChangedFlag = false;
+    v.curves.emplace_back(this->crv->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
 }
 
 ConstraintType ConstraintCurveValue::getTypeId()
@@ -1547,26 +1613,27 @@ void ConstraintCurveValue::rescale(double coef)
     scale = coef * 1;
 }
 
-void ConstraintCurveValue::errorgrad(double *err, double *grad, double *param)
+void ConstraintCurveValue::errorgrad(const ParamView &v, double *err, double *grad, double *param) const
 {
-    if (pvecChangedFlag) ReconstructGeomPointers();
+    Point p(v.pvec[0], v.pvec[1]);
+    Curve *crv = v.curves[0].get();
 
     double u, du;
-    u = *(this->u()); du = ( param == this->u() )   ?   1.0 : 0.0;
+    u = *(this->u(v)); du = ( param == this->u(v) )   ?   1.0 : 0.0;
 
     DeriVector2 P_to; //point of curve at parameter value of u, in global coordinates
-    P_to = this->crv->Value(u,du,param);
+    P_to = crv->Value(u,du,param);
 
-    DeriVector2 P_from(this->p, param); //point to be constrained
+    DeriVector2 P_from(p, param); //point to be constrained
 
     DeriVector2 err_vec = P_from.subtr(P_to);
 
-    if (this->pcoord() == this->p.x){ //this constraint is for X projection
+    if (this->pcoord(v) == p.x){ //this constraint is for X projection
         if (err)
             *err = err_vec.x;
         if (grad)
             *grad = err_vec.dx;
-    } else if (this->pcoord() == this->p.y) {//this constraint is for Y projection
+    } else if (this->pcoord(v) == p.y) {//this constraint is for Y projection
         if (err)
             *err = err_vec.y;
         if (grad)
@@ -1577,29 +1644,30 @@ void ConstraintCurveValue::errorgrad(double *err, double *grad, double *param)
 
 }
 
-double ConstraintCurveValue::error()
+double ConstraintCurveValue::evalError(const ParamView &v) const
 {
     double err;
-    errorgrad(&err,0,0);
+    errorgrad(v, &err,0,0);
     return scale * err;
 }
 
-double ConstraintCurveValue::grad(double *param)
+double ConstraintCurveValue::evalGrad(const ParamView &v, double *param) const
 {
     //first of all, check that we need to compute anything.
-    if ( findParamInPvec(param) == -1  ) return 0.0;
-    
+    //(not for a spline, whose pvec is long and whose basis is cached anyway)
+    if ( !isSpline && v.find(param) == -1  ) return 0.0;
+
     double deriv;
-    errorgrad(0, &deriv, param);
+    errorgrad(v, 0, &deriv, param);
     
     return deriv*scale;
 }    
 
-double ConstraintCurveValue::maxStep(MAP_pD_D &/*dir*/, double lim)
+double ConstraintCurveValue::evalMaxStep(const ParamView &/*v*/, MAP_pD_D &/*dir*/, double lim) const
 {
-    // step(angle()) <= pi/18 = 10°
+    // step(angle(v)) <= pi/18 = 10°
     /* TODO: curve-dependent parameter change limiting??
-    MAP_pD_D::iterator it = dir.find(this->u());
+    MAP_pD_D::iterator it = dir.find(this->u(v));
     if (it != dir.end()) {
         double step = std::abs(it->second);
         if (step > M_PI/18.)
@@ -1619,7 +1687,7 @@ ConstraintPointOnHyperbola::ConstraintPointOnHyperbola(Point &p, Hyperbola &e)
     pvec.push_back(e.focus1.x);
     pvec.push_back(e.focus1.y);
     pvec.push_back(e.radmin);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -1632,7 +1700,7 @@ ConstraintPointOnHyperbola::ConstraintPointOnHyperbola(Point &p, ArcOfHyperbola
     pvec.push_back(e.focus1.x);
     pvec.push_back(e.focus1.y);
     pvec.push_back(e.radmin);
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -1646,15 +1714,15 @@ void ConstraintPointOnHyperbola::rescale(double coef)
     scale = coef * 1;
 }
 
-double ConstraintPointOnHyperbola::error()
+double ConstraintPointOnHyperbola::evalError(const ParamView &v) const
 {    
-    double X_0 = *p1x();
-    double Y_0 = *p1y();
-    double X_c = *cx();
-    double Y_c = *cy();     
-    double X_F1 = *f1x();
-    double Y_F1 = *f1y();
-    double b = *rmin();
+    double X_0 = *p1x(v);
+    double Y_0 = *p1y(v);
+    double X_c = *cx(v);
+    double Y_c = *cy(v);     
+    double X_F1 = *f1x(v);
+    double Y_F1 = *f1y(v);
+    double b = *rmin(v);
     
     // Full sage worksheet at:
     // http://forum.freecadweb.org/viewtopic.php?f=10&t=8038&p=110447#p110447
@@ -1675,49 +1743,49 @@ double ConstraintPointOnHyperbola::error()
     return scale * err;
 }
 
-double ConstraintPointOnHyperbola::grad(double *param)
+double ConstraintPointOnHyperbola::evalGrad(const ParamView &v, double *param) const
 {
     double deriv=0.;
-    if (param == p1x() || param == p1y() ||
-        param == f1x() || param == f1y() ||
-        param == cx() || param == cy() ||
-        param == rmin()) {
+    if (param == p1x(v) || param == p1y(v) ||
+        param == f1x(v) || param == f1y(v) ||
+        param == cx(v) || param == cy(v) ||
+        param == rmin(v)) {
         
-        double X_0 = *p1x();
-        double Y_0 = *p1y();
-        double X_c = *cx();
-        double Y_c = *cy();
-        double X_F1 = *f1x();
-        double Y_F1 = *f1y();
-        double b = *rmin();
+        double X_0 = *p1x(v);
+        double Y_0 = *p1y(v);
+        double X_c = *cx(v);
+        double Y_c = *cy(v);
+        double X_F1 = *f1x(v);
+        double Y_F1 = *f1y(v);
+        double b = *rmin(v);
         
-        if (param == p1x())
+        if (param == p1x(v))
             deriv += -(X_0 - X_F1)/sqrt(pow(X_0 - X_F1, 2) + pow(Y_0 - Y_F1, 2)) +
                 (X_0 + X_F1 - 2*X_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) + pow(Y_0 + Y_F1 -
                 2*Y_c, 2));
-        if (param == p1y())
+        if (param == p1y(v))
             deriv += -(Y_0 - Y_F1)/sqrt(pow(X_0 - X_F1, 2) + pow(Y_0 - Y_F1, 2)) +
                 (Y_0 + Y_F1 - 2*Y_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) + pow(Y_0 + Y_F1 -
                 2*Y_c, 2));
-        if (param == f1x())
+        if (param == f1x(v))
             deriv += (X_0 - X_F1)/sqrt(pow(X_0 - X_F1, 2) + pow(Y_0 - Y_F1, 2)) -
                 2*(X_F1 - X_c)/sqrt(-pow(b, 2) + pow(X_F1 - X_c, 2) + pow(Y_F1 - Y_c,
                 2)) + (X_0 + X_F1 - 2*X_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) + pow(Y_0 +
                 Y_F1 - 2*Y_c, 2));
-        if (param == f1y())
+        if (param == f1y(v))
             deriv +=(Y_0 - Y_F1)/sqrt(pow(X_0 - X_F1, 2) + pow(Y_0 - Y_F1, 2)) -
                 2*(Y_F1 - Y_c)/sqrt(-pow(b, 2) + pow(X_F1 - X_c, 2) + pow(Y_F1 - Y_c,
                 2)) + (Y_0 + Y_F1 - 2*Y_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) + pow(Y_0 +
                 Y_F1 - 2*Y_c, 2));
-        if (param == cx())
+        if (param == cx(v))
             deriv += 2*(X_F1 - X_c)/sqrt(-pow(b, 2) + pow(X_F1 - X_c, 2) + pow(Y_F1
                 - Y_c, 2)) - 2*(X_0 + X_F1 - 2*X_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) +
                 pow(Y_0 + Y_F1 - 2*Y_c, 2));
-        if (param == cy())
+        if (param == cy(v))
             deriv +=2*(Y_F1 - Y_c)/sqrt(-pow(b, 2) + pow(X_F1 - X_c, 2) + pow(Y_F1
                 - Y_c, 2)) - 2*(Y_0 + Y_F1 - 2*Y_c)/sqrt(pow(X_0 + X_F1 - 2*X_c, 2) +
                 pow(Y_0 + Y_F1 - 2*Y_c, 2));
-        if (param == rmin())
+        if (param == rmin(v))
             deriv += 2*b/sqrt(-pow(b, 2) + pow(X_F1 - X_c, 2) + pow(Y_F1 - Y_c,2));
         }
         return scale * deriv;
@@ -1730,8 +1798,7 @@ ConstraintPointOnParabola::ConstraintPointOnParabola(Point &p, Parabola &e)
     pvec.push_back(p.y);
     e.PushOwnParams(pvec);
     this->parab = e.Copy();
-    pvecChangedFlag = true;
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -1741,8 +1808,7 @@ ConstraintPointOnParabola::ConstraintPointOnParabola(Point &p, ArcOfParabola &e)
     pvec.push_back(p.y);
     e.PushOwnParams(pvec);
     this->parab = e.Copy();
-    pvecChangedFlag = true;
-    origpvec = pvec;
+    bindOwn();
     rescale();
 }
 
@@ -1751,13 +1817,12 @@ ConstraintPointOnParabola::~ConstraintPointOnParabola()
     delete this->parab; this->parab = 0;
 }
 
-void ConstraintPointOnParabola::ReconstructGeomPointers()
+void ConstraintPointOnParabola::bindGeometry(ParamView &v) const
 {
     int i=0;
-    p.x=pvec[i]; i++;
-    p.y=pvec[i]; i++;
-    this->parab->ReconstructOnNewPvec(pvec, i);
-    pvecChangedFlag = false;
+    i++; i++;//the point
+    v.curves.emplace_back(this->parab->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
 }
 
 ConstraintType ConstraintPointOnParabola::getTypeId()
@@ -1770,14 +1835,15 @@ void ConstraintPointOnParabola::rescale(double coef)
     scale = coef * 1;
 }
 
-void ConstraintPointOnParabola::errorgrad(double *err, double *grad, double *param)
+void ConstraintPointOnParabola::errorgrad(const ParamView &v, double *err, double *grad, double *param) const
 {
-    if (pvecChangedFlag) ReconstructGeomPointers();
+    Point p(v.pvec[0], v.pvec[1]);
+    Parabola *parab = static_cast<Parabola*>(v.curves[0].get());
 
-    DeriVector2 focus(this->parab->focus1, param);
-    DeriVector2 vertex(this->parab->vertex, param);
+    DeriVector2 focus(parab->focus1, param);
+    DeriVector2 vertex(parab->vertex, param);
 
-    DeriVector2 point(this->p, param); //point to be constrained to parabola
+    DeriVector2 point(p, param); //point to be constrained to parabola
     
     DeriVector2 focalvect = focus.subtr(vertex);
     
@@ -1804,20 +1870,20 @@ void ConstraintPointOnParabola::errorgrad(double *err, double *grad, double *par
 
 }
 
-double ConstraintPointOnParabola::error()
+double ConstraintPointOnParabola::evalError(const ParamView &v) const
 {
     double err;
-    errorgrad(&err,0,0);
+    errorgrad(v, &err,0,0);
     return scale * err;
 }
 
-double ConstraintPointOnParabola::grad(double *param)
+double ConstraintPointOnParabola::evalGrad(const ParamView &v, double *param) const
 {
     //first of all, check that we need to compute anything.
-    if ( findParamInPvec(param) == -1  ) return 0.0;
+    if ( v.find(param) == -1  ) return 0.0;
     
     double deriv;
-    errorgrad(0, &deriv, param);
+    errorgrad(v, 0, &deriv, param);
     
     return deriv*scale;
 }
@@ -1832,8 +1898,7 @@ ConstraintAngleViaPoint::ConstraintAngleViaPoint(Curve &acrv1, Curve &acrv2, Poi
     acrv2.PushOwnParams(pvec);
     crv1 = acrv1.Copy();
     crv2 = acrv2.Copy();
-    origpvec = pvec;
-    pvecChangedFlag=true;
+    bindOwn();
     rescale();
 }
 ConstraintAngleViaPoint::~ConstraintAngleViaPoint()
@@ -1842,15 +1907,15 @@ ConstraintAngleViaPoint::~ConstraintAngleViaPoint()
     delete crv2; crv2 = 0;
 }
 
-void ConstraintAngleViaPoint::ReconstructGeomPointers()
+void ConstraintAngleViaPoint::bindGeometry(ParamView &v) const
 {
     int cnt=0;
     cnt++;//skip angle - we have an inline function for that
-    poa.x = pvec[cnt]; cnt++;
-    poa.y = pvec[cnt]; cnt++;
-    crv1->ReconstructOnNewPvec(pvec,cnt);
-    crv2->ReconstructOnNewPvec(pvec,cnt);
-    pvecChangedFlag=false;
+    cnt++; cnt++;//the point of angle is made of v.pvec[1], v.pvec[2] where needed
+    v.curves.emplace_back(crv1->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec,cnt);
+    v.curves.emplace_back(crv2->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec,cnt);
 }
 
 ConstraintType ConstraintAngleViaPoint::getTypeId()
@@ -1863,12 +1928,12 @@ void ConstraintAngleViaPoint::rescale(double coef)
     scale = coef * 1.;
 }
 
-double ConstraintAngleViaPoint::error()
+double ConstraintAngleViaPoint::evalError(const ParamView &v) const
 {
-    if (pvecChangedFlag) ReconstructGeomPointers();
-    double ang=*angle();
-    DeriVector2 n1 = crv1->CalculateNormal(poa);
-    DeriVector2 n2 = crv2->CalculateNormal(poa);
+    Point poa(v.pvec[1], v.pvec[2]);
+    double ang=*angle(v);
+    DeriVector2 n1 = v.curves[0]->CalculateNormal(poa);
+    DeriVector2 n2 = v.curves[1]->CalculateNormal(poa);
 
     //rotate n1 by angle
     DeriVector2 n1r (n1.x*cos(ang) - n1.y*sin(ang), n1.x*sin(ang) + n1.y*cos(ang) );
@@ -1881,18 +1946,17 @@ double ConstraintAngleViaPoint::error()
     return scale * err;
 }
 
-double ConstraintAngleViaPoint::grad(double *param)
+double ConstraintAngleViaPoint::evalGrad(const ParamView &v, double *param) const
 {
     //first of all, check that we need to compute anything.
-    if ( findParamInPvec(param) == -1  ) return 0.0;
+    if ( v.find(param) == -1  ) return 0.0;
 
     double deriv=0.;
 
-    if (pvecChangedFlag) ReconstructGeomPointers();
-
-    if (param == angle()) deriv += -1.0;
-    DeriVector2 n1 = crv1->CalculateNormal(poa, param);
-    DeriVector2 n2 = crv2->CalculateNormal(poa, param);
+    Point poa(v.pvec[1], v.pvec[2]);
+    if (param == angle(v)) deriv += -1.0;
+    DeriVector2 n1 = v.curves[0]->CalculateNormal(poa, param);
+    DeriVector2 n2 = v.curves[1]->CalculateNormal(poa, param);
     deriv -= ( (-n1.dx)*n1.y / pow(n1.length(),2)  +  n1.dy*n1.x / pow(n1.length(),2) );
     deriv += ( (-n2.dx)*n2.y / pow(n2.length(),2)  +  n2.dy*n2.x / pow(n2.length(),2) );
 
@@ -1931,8 +1995,7 @@ ConstraintSnell::ConstraintSnell(Curve &ray1, Curve &ray2, Curve &boundary, Poin
     this->ray1 = ray1.Copy();
     this->ray2 = ray2.Copy();
     this->boundary = boundary.Copy();
-    origpvec = pvec;
-    pvecChangedFlag=true;
+    bindOwn();
 
     this->flipn1 = flipn1;
     this->flipn2 = flipn2;
@@ -1946,16 +2009,17 @@ ConstraintSnell::~ConstraintSnell()
     delete boundary; boundary = 0;
 }
 
-void ConstraintSnell::ReconstructGeomPointers()
+void ConstraintSnell::bindGeometry(ParamView &v) const
 {
     int cnt=0;
     cnt++; cnt++;//skip n1, n2 - we have an inline function for that
-    poa.x = pvec[cnt]; cnt++;
-    poa.y = pvec[cnt]; cnt++;
-    ray1->ReconstructOnNewPvec(pvec,cnt);
-    ray2->ReconstructOnNewPvec(pvec,cnt);
-    boundary->ReconstructOnNewPvec(pvec,cnt);
-    pvecChangedFlag=false;
+    cnt++; cnt++;//the point of refraction is made of v.pvec[2], v.pvec[3] where needed
+    v.curves.emplace_back(ray1->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec,cnt);
+    v.curves.emplace_back(ray2->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec,cnt);
+    v.curves.emplace_back(boundary->Copy());
+    v.curves.back()->ReconstructOnNewPvec(v.pvec,cnt);
 }
 
 ConstraintType ConstraintSnell::getTypeId()
@@ -1969,41 +2033,41 @@ void ConstraintSnell::rescale(double coef)
 }
 
 //error and gradient combined. Values are returned through pointers.
-void ConstraintSnell::errorgrad(double *err, double *grad, double* param)
+void ConstraintSnell::errorgrad(const ParamView &v, double *err, double *grad, double *param) const
 {
-    if (pvecChangedFlag) ReconstructGeomPointers();
-    DeriVector2 tang1 = ray1->CalculateNormal(poa, param).rotate90cw().getNormalized();
-    DeriVector2 tang2 = ray2->CalculateNormal(poa, param).rotate90cw().getNormalized();
-    DeriVector2 tangB = boundary->CalculateNormal(poa, param).rotate90cw().getNormalized();
+    Point poa(v.pvec[2], v.pvec[3]);
+    DeriVector2 tang1 = v.curves[0]->CalculateNormal(poa, param).rotate90cw().getNormalized();
+    DeriVector2 tang2 = v.curves[1]->CalculateNormal(poa, param).rotate90cw().getNormalized();
+    DeriVector2 tangB = v.curves[2]->CalculateNormal(poa, param).rotate90cw().getNormalized();
     double sin1, dsin1, sin2, dsin2;
     sin1 = tang1.scalarProd(tangB, &dsin1);//sinus of angle of incidence
     sin2 = tang2.scalarProd(tangB, &dsin2);
     if (flipn1) {sin1 = -sin1; dsin1 = -dsin1;}
     if (flipn2) {sin2 = -sin2; dsin2 = -dsin2;}
 
-    double dn1 = (param == n1()) ? 1.0 : 0.0;
-    double dn2 = (param == n2()) ? 1.0 : 0.0;
+    double dn1 = (param == n1(v)) ? 1.0 : 0.0;
+    double dn2 = (param == n2(v)) ? 1.0 : 0.0;
     if (err)
-        *err = *n1()*sin1 - *n2()*sin2;
+        *err = *n1(v)*sin1 - *n2(v)*sin2;
     if (grad)
-        *grad = dn1*sin1 + *n1()*dsin1 - dn2*sin2 - *n2()*dsin2;
+        *grad = dn1*sin1 + *n1(v)*dsin1 - dn2*sin2 - *n2(v)*dsin2;
 }
 
-double ConstraintSnell::error()
+double ConstraintSnell::evalError(const ParamView &v) const
 {
     double err;
-    errorgrad(&err, 0, 0);
+    errorgrad(v, &err, 0, 0);
     return scale * err;
 }
 
-double ConstraintSnell::grad(double *param)
+double ConstraintSnell::evalGrad(const ParamView &v, double *param) const
 {
 
     //first of all, check that we need to compute anything.
-    if ( findParamInPvec(param) == -1 ) return 0.0;
+    if ( v.find(param) == -1 ) return 0.0;
 
     double deriv;
-    errorgrad(0, &deriv, param);
+    errorgrad(v, 0, &deriv, param);
 
 
 //use numeric for testing
@@ -2027,4 +2091,82 @@ double ConstraintSnell::grad(double *param)
 }
 
 
+// ConstraintBSplineTangentLine
+ConstraintBSplineTangentLine::ConstraintBSplineTangentLine(Line &l, BSpline &b, double *u, bool parallel)
+{
+    this->l = l;
+    this->l.PushOwnParams(pvec);
+    pvec.push_back(u);
+    this->b = b;
+    this->b.PushOwnParams(pvec);
+    this->parallel = parallel;
+    bindOwn();
+    rescale();
+}
+
+void ConstraintBSplineTangentLine::bindGeometry(ParamView &v) const
+{
+    int i=0;
+    v.curves.emplace_back(new Line(l));
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
+    i++;//we have an inline function for the parameterU
+    v.curves.emplace_back(new BSpline(b));
+    v.curves.back()->ReconstructOnNewPvec(v.pvec, i);
+}
+
+ConstraintType ConstraintBSplineTangentLine::getTypeId()
+{
+    return TangentBSplineLine;
+}
+
+void ConstraintBSplineTangentLine::rescale(double coef)
+{
+    scale = coef * 1;
+}
+
+void ConstraintBSplineTangentLine::errorgrad(const ParamView &v, double *err, double *grad, double *param) const
+{
+    Line &l = static_cast<Line&>(*v.curves[0]);
+    BSpline &b = static_cast<BSpline&>(*v.curves[1]);
+
+    double u = *(this->u(v));
+    double du = (param == this->u(v)) ? 1.0 : 0.0;
+
+    DeriVector2 p1 (l.p1, param);
+    DeriVector2 p2 (l.p2, param);
+    DeriVector2 ldir = p2.subtr(p1).getNormalized();
+
+    // signed distance of the point of the spline from the line, or sine of the angle
+    // between the line and the tangent of the spline
+    DeriVector2 w;
+    if (parallel)
+        w = b.Tangent(u, du, param).getNormalized();
+    else
+        w = b.Value(u, du, param).subtr(p1);
+
+    double dcross;
+    double cross = ldir.rotate90ccw().scalarProd(w, &dcross);
+
+    if (err)
+        *err = cross;
+    if (grad)
+        *grad = dcross;
+}
+
+double ConstraintBSplineTangentLine::evalError(const ParamView &v) const
+{
+    double err;
+    errorgrad(v, &err,0,0);
+    return scale * err;
+}
+
+double ConstraintBSplineTangentLine::evalGrad(const ParamView &v, double *param) const
+{
+    // no lookup of param in pvec, which is long for a spline of many poles: the
+    // derivative on another parameter is zero anyway, and the basis is cached
+    double deriv;
+    errorgrad(v, 0, &deriv, param);
+    return scale * deriv;
+}
+
 } //namespace GCS
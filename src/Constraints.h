@@ -25,6 +25,7 @@
 
 #include "Geo.h"
 #include "Util.h"
+#include <memory>
 #include <boost/graph/graph_concepts.hpp>
 
 //#define _GCS_EXTRACT_SOLVER_SUBSYSTEM_ // This enables debugging code intended to extract information to file bug reports against Eigen, not for production code
@@ -35,6 +36,17 @@
 #define _PROTECTED_UNLESS_EXTRACT_MODE_ protected
 #endif
 
+//#define PROFILE_CONSTRAINTS // This counts and times the evaluations of the constraints by type, see ConstraintProfile
+
+#ifdef PROFILE_CONSTRAINTS
+#include <atomic>
+#include <chrono>
+#define PROFILE_CONSTRAINT_EVALUATION(evaluation) \
+    ConstraintProfile::Scope profileScope(const_cast<Constraint *>(this)->getTypeId(), ConstraintProfile::evaluation)
+#else
+#define PROFILE_CONSTRAINT_EVALUATION(evaluation)
+#endif
+
 namespace GCS
 {
 
@@ -67,8 +79,48 @@ namespace GCS
         PointOnHyperbola = 21,
         InternalAlignmentPoint2Hyperbola = 22,
         PointOnParabola = 23,
-        EqualFocalDistance = 24
+        EqualFocalDistance = 24,
+        TangentBSplineLine = 25
+    };
+
+#ifdef PROFILE_CONSTRAINTS
+    // Evaluations of the constraints by type, over all the systems and threads. Every
+    // call is counted, one call in samplingPeriod of each thread is timed and stands
+    // for the whole period, so that the clock is rarely read.
+    class ConstraintProfile
+    {
+    public:
+        enum Evaluation {
+            Error = 0,
+            Grad = 1,
+            MaxStep = 2
+        };
+        static const int typesSize = TangentBSplineLine + 1;
+        static const int evaluationsSize = 3;
+        static const int samplingPeriod = 64;
+
+        static ConstraintProfile &profile();
+        void reset();
+        long long calls(ConstraintType type, Evaluation evaluation) const;
+        double seconds(ConstraintType type, Evaluation evaluation) const; // estimated from the samples
+
+        // counts an evaluation and times it if it is sampled
+        class Scope
+        {
+        public:
+            Scope(ConstraintType type, Evaluation evaluation);
+            ~Scope();
+        private:
+            std::atomic<long long> *sampledTime; // NULL if not sampled
+            std::chrono::steady_clock::time_point start;
+        };
+
+    private:
+        ConstraintProfile();
+        std::atomic<long long> callCounts[typesSize][evaluationsSize];
+        std::atomic<long long> sampledNanoseconds[typesSize][evaluationsSize];
     };
+#endif
     
     enum InternalAlignmentType {
         EllipsePositiveMajorX = 0,
@@ -91,23 +143,47 @@ namespace GCS
         HyperbolaNegativeMinorY = 17
     };
 
+    // Per evaluation state of a constraint, owned by whoever evaluates it: pvec[k]
+    // points to the value of the k-th parameter of the constraint, and curves are
+    // copies of the geometry of the constraint reading their parameters from pvec.
+    // Evaluations write neither to the constraint nor to the view (except the caches
+    // of the curves, see BSpline and MajorRadiusConic), so that any number of threads
+    // can evaluate one constraint, each through its own view.
+    class ParamView
+    {
+    public:
+        VEC_pD pvec;
+        std::vector< std::unique_ptr<Curve> > curves;
+
+        int find(const double *param) const; // index in pvec, -1 if not found
+    };
+
     class Constraint
     {
     _PROTECTED_UNLESS_EXTRACT_MODE_:
-        VEC_pD origpvec; // is used only as a reference for redirecting and reverting pvec
-        VEC_pD pvec;
+        VEC_pD pvec;   // the parameters, not changed after the construction
+        ParamView own; // view of pvec, used by the evaluations without a view
         double scale;
         int tag;
-        bool pvecChangedFlag;  //indicates that pvec has changed and saved pointers must be reconstructed (currently used only in AngleViaPoint)
         bool driving;
+        void bindOwn(); // to be called once pvec and the geometry are set
+        // adds to v.curves the geometry of the constraint on v.pvec
+        virtual void bindGeometry(ParamView & /*v*/) const {}
+        // the evaluations implemented by each type, called through error, grad and maxStep
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
+        // virtual void grad(MAP_pD_D &deriv);  --> TODO: vectorized grad version
+        virtual double evalMaxStep(const ParamView &v, MAP_pD_D &dir, double lim=1.) const;
     public:
         Constraint();
         virtual ~Constraint(){}
 
-        inline VEC_pD params() { return pvec; }
+        inline const VEC_pD &params() { return pvec; }
+
+        // view on the parameters, those found in redirectionmap replaced by their targets
+        void bind(ParamView &v, const MAP_pD_pD &redirectionmap) const;
+        const ParamView &ownView() const { return own; }
 
-        void redirectParams(MAP_pD_pD redirectionmap);
-        void revertParams();
         void setTag(int tagId) { tag = tagId; }
         int getTag() { return tag; }
         
@@ -116,10 +192,16 @@ namespace GCS
 
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
-        // virtual void grad(MAP_pD_D &deriv);  --> TODO: vectorized grad version
-        virtual double maxStep(MAP_pD_D &dir, double lim=1.);
+        double error(const ParamView &v) const
+          { PROFILE_CONSTRAINT_EVALUATION(Error); return evalError(v); }
+        double grad(const ParamView &v, double *param) const
+          { PROFILE_CONSTRAINT_EVALUATION(Grad); return evalGrad(v, param); }
+        double maxStep(const ParamView &v, MAP_pD_D &dir, double lim=1.) const
+          { PROFILE_CONSTRAINT_EVALUATION(MaxStep); return evalMaxStep(v, dir, lim); }
+        // the same on the parameters themselves
+        double error() const { return error(own); }
+        double grad(double *param) const { return grad(own, param); }
+        double maxStep(MAP_pD_D &dir, double lim=1.) const { return maxStep(own, dir, lim); }
         // Finds first occurrence of param in pvec. This is useful to test if a constraint depends 
         // on the parameter (it may not actually depend on it, e.g. angle-via-point doesn't depend 
         // on ellipse's b (radmin), but b will be included within the constraint anyway. 
@@ -132,40 +214,40 @@ namespace GCS
     {
     private:
         double ratio;
-        inline double* param1() { return pvec[0]; }
-        inline double* param2() { return pvec[1]; }
+        inline double* param1(const ParamView &v) const { return v.pvec[0]; }
+        inline double* param2(const ParamView &v) const { return v.pvec[1]; }
     public:
         ConstraintEqual(double *p1, double *p2, double p1p2ratio=1.0);
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     // Difference
     class ConstraintDifference : public Constraint
     {
     private:
-        inline double* param1() { return pvec[0]; }
-        inline double* param2() { return pvec[1]; }
-        inline double* difference() { return pvec[2]; }
+        inline double* param1(const ParamView &v) const { return v.pvec[0]; }
+        inline double* param2(const ParamView &v) const { return v.pvec[1]; }
+        inline double* difference(const ParamView &v) const { return v.pvec[2]; }
     public:
         ConstraintDifference(double *p1, double *p2, double *d);
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     // P2PDistance
     class ConstraintP2PDistance : public Constraint
     {
     private:
-        inline double* p1x() { return pvec[0]; }
-        inline double* p1y() { return pvec[1]; }
-        inline double* p2x() { return pvec[2]; }
-        inline double* p2y() { return pvec[3]; }
-        inline double* distance() { return pvec[4]; }
+        inline double* p1x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* p1y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* p2x(const ParamView &v) const { return v.pvec[2]; }
+        inline double* p2y(const ParamView &v) const { return v.pvec[3]; }
+        inline double* distance(const ParamView &v) const { return v.pvec[4]; }
     public:
         ConstraintP2PDistance(Point &p1, Point &p2, double *d);
         #ifdef _GCS_EXTRACT_SOLVER_SUBSYSTEM_
@@ -173,20 +255,20 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
-        virtual double maxStep(MAP_pD_D &dir, double lim=1.);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
+        virtual double evalMaxStep(const ParamView &v, MAP_pD_D &dir, double lim=1.) const;
     };
 
     // P2PAngle
     class ConstraintP2PAngle : public Constraint
     {
     private:
-        inline double* p1x() { return pvec[0]; }
-        inline double* p1y() { return pvec[1]; }
-        inline double* p2x() { return pvec[2]; }
-        inline double* p2y() { return pvec[3]; }
-        inline double* angle() { return pvec[4]; }
+        inline double* p1x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* p1y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* p2x(const ParamView &v) const { return v.pvec[2]; }
+        inline double* p2y(const ParamView &v) const { return v.pvec[3]; }
+        inline double* angle(const ParamView &v) const { return v.pvec[4]; }
         double da;
     public:
         ConstraintP2PAngle(Point &p1, Point &p2, double *a, double da_=0.);
@@ -195,22 +277,22 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
-        virtual double maxStep(MAP_pD_D &dir, double lim=1.);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
+        virtual double evalMaxStep(const ParamView &v, MAP_pD_D &dir, double lim=1.) const;
     };
 
     // P2LDistance
     class ConstraintP2LDistance : public Constraint
     {
     private:
-        inline double* p0x() { return pvec[0]; }
-        inline double* p0y() { return pvec[1]; }
-        inline double* p1x() { return pvec[2]; }
-        inline double* p1y() { return pvec[3]; }
-        inline double* p2x() { return pvec[4]; }
-        inline double* p2y() { return pvec[5]; }
-        inline double* distance() { return pvec[6]; }
+        inline double* p0x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* p0y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* p1x(const ParamView &v) const { return v.pvec[2]; }
+        inline double* p1y(const ParamView &v) const { return v.pvec[3]; }
+        inline double* p2x(const ParamView &v) const { return v.pvec[4]; }
+        inline double* p2y(const ParamView &v) const { return v.pvec[5]; }
+        inline double* distance(const ParamView &v) const { return v.pvec[6]; }
     public:
         ConstraintP2LDistance(Point &p, Line &l, double *d);
         #ifdef _GCS_EXTRACT_SOLVER_SUBSYSTEM_
@@ -218,9 +300,9 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
-        virtual double maxStep(MAP_pD_D &dir, double lim=1.);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
+        virtual double evalMaxStep(const ParamView &v, MAP_pD_D &dir, double lim=1.) const;
         double abs(double darea);
     };
 
@@ -228,12 +310,12 @@ namespace GCS
     class ConstraintPointOnLine : public Constraint
     {
     private:
-        inline double* p0x() { return pvec[0]; }
-        inline double* p0y() { return pvec[1]; }
-        inline double* p1x() { return pvec[2]; }
-        inline double* p1y() { return pvec[3]; }
-        inline double* p2x() { return pvec[4]; }
-        inline double* p2y() { return pvec[5]; }
+        inline double* p0x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* p0y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* p1x(const ParamView &v) const { return v.pvec[2]; }
+        inline double* p1y(const ParamView &v) const { return v.pvec[3]; }
+        inline double* p2x(const ParamView &v) const { return v.pvec[4]; }
+        inline double* p2y(const ParamView &v) const { return v.pvec[5]; }
     public:
         ConstraintPointOnLine(Point &p, Line &l);
         ConstraintPointOnLine(Point &p, Point &lp1, Point &lp2);
@@ -242,21 +324,21 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     // PointOnPerpBisector
     class ConstraintPointOnPerpBisector : public Constraint
     {
     private:
-        inline double* p0x() { return pvec[0]; }
-        inline double* p0y() { return pvec[1]; }
-        inline double* p1x() { return pvec[2]; }
-        inline double* p1y() { return pvec[3]; }
-        inline double* p2x() { return pvec[4]; }
-        inline double* p2y() { return pvec[5]; }
-        void errorgrad(double *err, double *grad, double *param);
+        inline double* p0x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* p0y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* p1x(const ParamView &v) const { return v.pvec[2]; }
+        inline double* p1y(const ParamView &v) const { return v.pvec[3]; }
+        inline double* p2x(const ParamView &v) const { return v.pvec[4]; }
+        inline double* p2y(const ParamView &v) const { return v.pvec[5]; }
+        void errorgrad(const ParamView &v, double *err, double *grad, double *param) const;
     public:
         ConstraintPointOnPerpBisector(Point &p, Line &l);
         ConstraintPointOnPerpBisector(Point &p, Point &lp1, Point &lp2);
@@ -266,22 +348,22 @@ namespace GCS
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
 
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     // Parallel
     class ConstraintParallel : public Constraint
     {
     private:
-        inline double* l1p1x() { return pvec[0]; }
-        inline double* l1p1y() { return pvec[1]; }
-        inline double* l1p2x() { return pvec[2]; }
-        inline double* l1p2y() { return pvec[3]; }
-        inline double* l2p1x() { return pvec[4]; }
-        inline double* l2p1y() { return pvec[5]; }
-        inline double* l2p2x() { return pvec[6]; }
-        inline double* l2p2y() { return pvec[7]; }
+        inline double* l1p1x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* l1p1y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* l1p2x(const ParamView &v) const { return v.pvec[2]; }
+        inline double* l1p2y(const ParamView &v) const { return v.pvec[3]; }
+        inline double* l2p1x(const ParamView &v) const { return v.pvec[4]; }
+        inline double* l2p1y(const ParamView &v) const { return v.pvec[5]; }
+        inline double* l2p2x(const ParamView &v) const { return v.pvec[6]; }
+        inline double* l2p2y(const ParamView &v) const { return v.pvec[7]; }
     public:
         ConstraintParallel(Line &l1, Line &l2);
         #ifdef _GCS_EXTRACT_SOLVER_SUBSYSTEM_
@@ -289,22 +371,22 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     // Perpendicular
     class ConstraintPerpendicular : public Constraint
     {
     private:
-        inline double* l1p1x() { return pvec[0]; }
-        inline double* l1p1y() { return pvec[1]; }
-        inline double* l1p2x() { return pvec[2]; }
-        inline double* l1p2y() { return pvec[3]; }
-        inline double* l2p1x() { return pvec[4]; }
-        inline double* l2p1y() { return pvec[5]; }
-        inline double* l2p2x() { return pvec[6]; }
-        inline double* l2p2y() { return pvec[7]; }
+        inline double* l1p1x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* l1p1y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* l1p2x(const ParamView &v) const { return v.pvec[2]; }
+        inline double* l1p2y(const ParamView &v) const { return v.pvec[3]; }
+        inline double* l2p1x(const ParamView &v) const { return v.pvec[4]; }
+        inline double* l2p1y(const ParamView &v) const { return v.pvec[5]; }
+        inline double* l2p2x(const ParamView &v) const { return v.pvec[6]; }
+        inline double* l2p2y(const ParamView &v) const { return v.pvec[7]; }
     public:
         ConstraintPerpendicular(Line &l1, Line &l2);
         ConstraintPerpendicular(Point &l1p1, Point &l1p2, Point &l2p1, Point &l2p2);
@@ -313,23 +395,23 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     // L2LAngle
     class ConstraintL2LAngle : public Constraint
     {
     private:
-        inline double* l1p1x() { return pvec[0]; }
-        inline double* l1p1y() { return pvec[1]; }
-        inline double* l1p2x() { return pvec[2]; }
-        inline double* l1p2y() { return pvec[3]; }
-        inline double* l2p1x() { return pvec[4]; }
-        inline double* l2p1y() { return pvec[5]; }
-        inline double* l2p2x() { return pvec[6]; }
-        inline double* l2p2y() { return pvec[7]; }
-        inline double* angle() { return pvec[8]; }
+        inline double* l1p1x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* l1p1y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* l1p2x(const ParamView &v) const { return v.pvec[2]; }
+        inline double* l1p2y(const ParamView &v) const { return v.pvec[3]; }
+        inline double* l2p1x(const ParamView &v) const { return v.pvec[4]; }
+        inline double* l2p1y(const ParamView &v) const { return v.pvec[5]; }
+        inline double* l2p2x(const ParamView &v) const { return v.pvec[6]; }
+        inline double* l2p2y(const ParamView &v) const { return v.pvec[7]; }
+        inline double* angle(const ParamView &v) const { return v.pvec[8]; }
     public:
         ConstraintL2LAngle(Line &l1, Line &l2, double *a);
         ConstraintL2LAngle(Point &l1p1, Point &l1p2,
@@ -339,23 +421,23 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
-        virtual double maxStep(MAP_pD_D &dir, double lim=1.);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
+        virtual double evalMaxStep(const ParamView &v, MAP_pD_D &dir, double lim=1.) const;
     };
 
     // MidpointOnLine
     class ConstraintMidpointOnLine : public Constraint
     {
     private:
-        inline double* l1p1x() { return pvec[0]; }
-        inline double* l1p1y() { return pvec[1]; }
-        inline double* l1p2x() { return pvec[2]; }
-        inline double* l1p2y() { return pvec[3]; }
-        inline double* l2p1x() { return pvec[4]; }
-        inline double* l2p1y() { return pvec[5]; }
-        inline double* l2p2x() { return pvec[6]; }
-        inline double* l2p2y() { return pvec[7]; }
+        inline double* l1p1x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* l1p1y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* l1p2x(const ParamView &v) const { return v.pvec[2]; }
+        inline double* l1p2y(const ParamView &v) const { return v.pvec[3]; }
+        inline double* l2p1x(const ParamView &v) const { return v.pvec[4]; }
+        inline double* l2p1y(const ParamView &v) const { return v.pvec[5]; }
+        inline double* l2p2x(const ParamView &v) const { return v.pvec[6]; }
+        inline double* l2p2y(const ParamView &v) const { return v.pvec[7]; }
     public:
         ConstraintMidpointOnLine(Line &l1, Line &l2);
         ConstraintMidpointOnLine(Point &l1p1, Point &l1p2, Point &l2p1, Point &l2p2);
@@ -364,20 +446,20 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     // TangentCircumf
     class ConstraintTangentCircumf : public Constraint
     {
     private:
-        inline double* c1x() { return pvec[0]; }
-        inline double* c1y() { return pvec[1]; }
-        inline double* c2x() { return pvec[2]; }
-        inline double* c2y() { return pvec[3]; }
-        inline double* r1() { return pvec[4]; }
-        inline double* r2() { return pvec[5]; }
+        inline double* c1x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* c1y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* c2x(const ParamView &v) const { return v.pvec[2]; }
+        inline double* c2y(const ParamView &v) const { return v.pvec[3]; }
+        inline double* r1(const ParamView &v) const { return v.pvec[4]; }
+        inline double* r2(const ParamView &v) const { return v.pvec[5]; }
         bool internal;
     public:
         ConstraintTangentCircumf(Point &p1, Point &p2,
@@ -388,20 +470,20 @@ namespace GCS
         inline bool getInternal() {return internal;};
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
     // PointOnEllipse
     class ConstraintPointOnEllipse : public Constraint
     {
     private:
-        inline double* p1x() { return pvec[0]; }
-        inline double* p1y() { return pvec[1]; }
-        inline double* cx() { return pvec[2]; }
-        inline double* cy() { return pvec[3]; }
-        inline double* f1x() { return pvec[4]; }
-        inline double* f1y() { return pvec[5]; }
-        inline double* rmin() { return pvec[6]; }
+        inline double* p1x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* p1y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* cx(const ParamView &v) const { return v.pvec[2]; }
+        inline double* cy(const ParamView &v) const { return v.pvec[3]; }
+        inline double* f1x(const ParamView &v) const { return v.pvec[4]; }
+        inline double* f1y(const ParamView &v) const { return v.pvec[5]; }
+        inline double* rmin(const ParamView &v) const { return v.pvec[6]; }
     public:
         ConstraintPointOnEllipse(Point &p, Ellipse &e);
         ConstraintPointOnEllipse(Point &p, ArcOfEllipse &a);
@@ -410,8 +492,8 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
     
     class ConstraintEllipseTangentLine : public Constraint
@@ -419,14 +501,14 @@ namespace GCS
     private:
         Line l;
         Ellipse e;
-        void ReconstructGeomPointers(); //writes pointers in pvec to the parameters of crv1, crv2 and poa
-        void errorgrad(double* err, double* grad, double *param); //error and gradient combined. Values are returned through pointers.
+        virtual void bindGeometry(ParamView &v) const;
+        void errorgrad(const ParamView &v, double *err, double *grad, double *param) const; //error and gradient combined. Values are returned through pointers.
     public:
         ConstraintEllipseTangentLine(Line &l, Ellipse &e);
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
         
     class ConstraintInternalAlignmentPoint2Ellipse : public Constraint
@@ -435,11 +517,11 @@ namespace GCS
         ConstraintInternalAlignmentPoint2Ellipse(Ellipse &e, Point &p1, InternalAlignmentType alignmentType);
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     private:
-        void errorgrad(double* err, double* grad, double *param); //error and gradient combined. Values are returned through pointers.
-        void ReconstructGeomPointers(); //writes pointers in pvec to the parameters of crv1, crv2 and poa
+        void errorgrad(const ParamView &v, double *err, double *grad, double *param) const; //error and gradient combined. Values are returned through pointers.
+        virtual void bindGeometry(ParamView &v) const;
         Ellipse e;
         Point p;
         InternalAlignmentType AlignmentType;
@@ -451,11 +533,11 @@ namespace GCS
         ConstraintInternalAlignmentPoint2Hyperbola(Hyperbola &e, Point &p1, InternalAlignmentType alignmentType);
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     private:
-        void errorgrad(double* err, double* grad, double *param); //error and gradient combined. Values are returned through pointers.
-        void ReconstructGeomPointers(); //writes pointers in pvec to the parameters of crv1, crv2 and poa
+        void errorgrad(const ParamView &v, double *err, double *grad, double *param) const; //error and gradient combined. Values are returned through pointers.
+        virtual void bindGeometry(ParamView &v) const;
         Hyperbola e;
         Point p;
         InternalAlignmentType AlignmentType;
@@ -466,14 +548,14 @@ namespace GCS
     private:
         MajorRadiusConic * e1;
         MajorRadiusConic * e2;
-        void ReconstructGeomPointers(); //writes pointers in pvec to the parameters of crv1, crv2 and poa
-        void errorgrad(double* err, double* grad, double *param); //error and gradient combined. Values are returned through pointers.
+        virtual void bindGeometry(ParamView &v) const;
+        void errorgrad(const ParamView &v, double *err, double *grad, double *param) const; //error and gradient combined. Values are returned through pointers.
     public:
         ConstraintEqualMajorAxesConic(MajorRadiusConic * a1, MajorRadiusConic * a2);
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     class ConstraintEqualFocalDistance : public Constraint
@@ -481,25 +563,25 @@ namespace GCS
     private:
         ArcOfParabola * e1;
         ArcOfParabola * e2;
-        void ReconstructGeomPointers(); //writes pointers in pvec to the parameters of crv1, crv2 and poa
-        void errorgrad(double* err, double* grad, double *param); //error and gradient combined. Values are returned through pointers.
+        virtual void bindGeometry(ParamView &v) const;
+        void errorgrad(const ParamView &v, double *err, double *grad, double *param) const; //error and gradient combined. Values are returned through pointers.
     public:
         ConstraintEqualFocalDistance(ArcOfParabola * a1, ArcOfParabola * a2);
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     class ConstraintCurveValue : public Constraint
     {
     private:
-        inline double* pcoord() { return pvec[2]; } //defines, which coordinate of point is being constrained by this constraint
-        inline double* u() { return pvec[3]; }
-        void errorgrad(double* err, double* grad, double *param); //error and gradient combined. Values are returned through pointers.
-        void ReconstructGeomPointers(); //writes pointers in pvec to the parameters of crv1, crv2 and poa
+        inline double* pcoord(const ParamView &v) const { return v.pvec[2]; } //defines, which coordinate of point is being constrained by this constraint
+        inline double* u(const ParamView &v) const { return v.pvec[3]; }
+        void errorgrad(const ParamView &v, double *err, double *grad, double *param) const; //error and gradient combined. Values are returned through pointers.
+        virtual void bindGeometry(ParamView &v) const;
         Curve* crv;
-        Point p;
+        bool isSpline; // crv is a BSpline, decided once by the constructor
     public:
         /**
          * @brief ConstraintCurveValue: solver constraint that ties parameter value with point coordinates, according to curve's parametric equation.
@@ -512,22 +594,22 @@ namespace GCS
         ~ConstraintCurveValue();
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
-        virtual double maxStep(MAP_pD_D &dir, double lim=1.);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
+        virtual double evalMaxStep(const ParamView &v, MAP_pD_D &dir, double lim=1.) const;
     };
     
     // PointOnHyperbola
     class ConstraintPointOnHyperbola : public Constraint
     {
     private:
-        inline double* p1x() { return pvec[0]; }
-        inline double* p1y() { return pvec[1]; }
-        inline double* cx() { return pvec[2]; }
-        inline double* cy() { return pvec[3]; }
-        inline double* f1x() { return pvec[4]; }
-        inline double* f1y() { return pvec[5]; }
-        inline double* rmin() { return pvec[6]; }
+        inline double* p1x(const ParamView &v) const { return v.pvec[0]; }
+        inline double* p1y(const ParamView &v) const { return v.pvec[1]; }
+        inline double* cx(const ParamView &v) const { return v.pvec[2]; }
+        inline double* cy(const ParamView &v) const { return v.pvec[3]; }
+        inline double* f1x(const ParamView &v) const { return v.pvec[4]; }
+        inline double* f1y(const ParamView &v) const { return v.pvec[5]; }
+        inline double* rmin(const ParamView &v) const { return v.pvec[6]; }
     public:
         ConstraintPointOnHyperbola(Point &p, Hyperbola &e);
         ConstraintPointOnHyperbola(Point &p, ArcOfHyperbola &a);
@@ -536,18 +618,17 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     // PointOnParabola
     class ConstraintPointOnParabola : public Constraint
     {
     private:
-        void errorgrad(double* err, double* grad, double *param); //error and gradient combined. Values are returned through pointers.
-        void ReconstructGeomPointers(); //writes pointers in pvec to the parameters of crv1, crv2 and poa
+        void errorgrad(const ParamView &v, double *err, double *grad, double *param) const; //error and gradient combined. Values are returned through pointers.
+        virtual void bindGeometry(ParamView &v) const;
         Parabola* parab;
-        Point p;
     public:
         ConstraintPointOnParabola(Point &p, Parabola &e);
         ConstraintPointOnParabola(Point &p, ArcOfParabola &a);
@@ -557,63 +638,75 @@ namespace GCS
         #endif
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
     
     class ConstraintAngleViaPoint : public Constraint
     {
     private:
-        inline double* angle() { return pvec[0]; };
+        inline double* angle(const ParamView &v) const { return v.pvec[0]; }
         Curve* crv1;
         Curve* crv2;
         //These two pointers hold copies of the curves that were passed on
         // constraint creation. The curves must be deleted upon destruction of
-        // the constraint. It is necessary to have copies, since messing with
-        // original objects that were passed is a very bad idea (but messing is
-        // necessary, because we need to support redirectParams()/revertParams
-        // functions.
-        //The pointers in the curves need to be reconstructed if pvec was redirected
-        // (test pvecChangedFlag variable before use!)
-        Point poa;//poa=point of angle //needs to be reconstructed if pvec was redirected/reverted. The point is easily shallow-copied by C++, so no pointer type here and no delete is necessary.
-        void ReconstructGeomPointers(); //writes pointers in pvec to the parameters of crv1, crv2 and poa
+        // the constraint. They are not evaluated themselves: every ParamView
+        // gets its own copies of them, reconstructed on the pvec of the view.
+        //The point of angle is v.pvec[1], v.pvec[2].
+        virtual void bindGeometry(ParamView &v) const;
     public:
         ConstraintAngleViaPoint(Curve &acrv1, Curve &acrv2, Point p, double* angle);
         ~ConstraintAngleViaPoint();
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
     class ConstraintSnell : public Constraint //snell's law angles constrainer. Point needs to lie on all three curves to be constraied.
     {
     private:
-        inline double* n1() { return pvec[0]; };
-        inline double* n2() { return pvec[1]; };
+        inline double* n1(const ParamView &v) const { return v.pvec[0]; }
+        inline double* n2(const ParamView &v) const { return v.pvec[1]; }
         Curve* ray1;
         Curve* ray2;
         Curve* boundary;
         //These pointers hold copies of the curves that were passed on
         // constraint creation. The curves must be deleted upon destruction of
-        // the constraint. It is necessary to have copies, since messing with
-        // original objects that were passed is a very bad idea (but messing is
-        // necessary, because we need to support redirectParams()/revertParams
-        // functions.
-        //The pointers in the curves need to be reconstructed if pvec was redirected
-        // (test pvecChangedFlag variable before use!)
-        Point poa;//poa=point of refraction //needs to be reconstructed if pvec was redirected/reverted. The point is easily shallow-copied by C++, so no pointer type here and no delete is necessary.
+        // the constraint. They are not evaluated themselves: every ParamView
+        // gets its own copies of them, reconstructed on the pvec of the view.
+        //The point of refraction is v.pvec[2], v.pvec[3].
         bool flipn1, flipn2;
-        void ReconstructGeomPointers(); //writes pointers in pvec to the parameters of crv1, crv2 and poa
-        void errorgrad(double* err, double* grad, double *param); //error and gradient combined. Values are returned through pointers.
+        virtual void bindGeometry(ParamView &v) const;
+        void errorgrad(const ParamView &v, double *err, double *grad, double *param) const; //error and gradient combined. Values are returned through pointers.
     public:
         //n1dn2 = n1 divided by n2. from n1 to n2. flipn1 = true instructs to flip ray1's tangent
         ConstraintSnell(Curve &ray1, Curve &ray2, Curve &boundary, Point p, double* n1, double* n2, bool flipn1, bool flipn2);
         ~ConstraintSnell();
         virtual ConstraintType getTypeId();
         virtual void rescale(double coef=1.);
-        virtual double error();
-        virtual double grad(double *);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
+    };
+
+    // Tangency of a line to a B-spline at the parameter u, as two constraints: the
+    // point of the spline at u on the line (parallel=false), and the tangent of the
+    // spline at u parallel to the line (parallel=true)
+    class ConstraintBSplineTangentLine : public Constraint
+    {
+    private:
+        Line l;
+        BSpline b;
+        bool parallel;
+        inline double* u(const ParamView &v) const { return v.pvec[4]; }
+        virtual void bindGeometry(ParamView &v) const;
+        void errorgrad(const ParamView &v, double *err, double *grad, double *param) const; //error and gradient combined. Values are returned through pointers.
+    public:
+        ConstraintBSplineTangentLine(Line &l, BSpline &b, double *u, bool parallel);
+        virtual ConstraintType getTypeId();
+        virtual void rescale(double coef=1.);
+        virtual double evalError(const ParamView &v) const;
+        virtual double evalGrad(const ParamView &v, double *param) const;
     };
 
 
@@ -51,12 +51,17 @@
 
 #include <iostream>
 #include <algorithm>
+#include <iterator>
 #include <cfloat>
 #include <limits>
 #include <future>
+#include <tuple>
+#include <random>
 
 #include "GCS.h"
 #include "qp_eq.h"
+#include "BipartiteGraph.h"
+#include "AnalyticSolver.h"
 
 // NOTE: In CMakeList.txt -DEIGEN_NO_DEBUG is set (it does not work with a define here), to solve this:
 // this is needed to fix this SparseQR crash http://forum.freecadweb.org/viewtopic.php?f=10&t=11341&p=92146#p92146,
@@ -412,32 +417,95 @@ void SolverReportingManager::LogMatrix(const std::string str, MatrixIndexType ma
 
 typedef boost::adjacency_list <boost::vecS, boost::vecS, boost::undirectedS> Graph;
 
+// std::max of two solve statuses, except that Partial ranks between Converged and Failed
+static int worseStatus(int res1, int res2)
+{
+    int rank1 = (res1 == Partial) ? 2*Converged+1 : 2*res1;
+    int rank2 = (res2 == Partial) ? 2*Converged+1 : 2*res2;
+    return (rank1 >= rank2) ? res1 : res2;
+}
+
+// subsystems up to this number of parameters and constraints are solved with
+// fixed size vectors and matrices, which live on the stack
+static const int fixedSizeMax = 8;
+
+// Buffers of the templated solvers: the fixed size ones are the local objects,
+// the dynamic ones are taken from the workspace of the subsystem.
+template <typename Type, typename Shared>
+static Type &buffer(Type &local, Shared & /*shared*/) { return local; }
+template <typename Type>
+static Type &buffer(Type & /*local*/, Type &shared) { return shared; }
+
+// dst = lu.solve(rhs), with c as buffer instead of the temporary allocated by Eigen
+template <typename LU, typename Rhs, typename Buffer, typename Dst>
+static void solveLU(const LU &lu, const Rhs &rhs, Buffer &c, Dst &dst)
+{
+    Eigen::Index rows = lu.rows(), cols = lu.cols(), rank = lu.rank();
+    Eigen::Index smalldim = std::min(rows, cols);
+    dst.resize(cols);
+    if (rank == 0) {
+        dst.setZero();
+        return;
+    }
+    c.resize(rows);
+    c = lu.permutationP() * rhs;
+    lu.matrixLU().topLeftCorner(smalldim, smalldim)
+                 .template triangularView<Eigen::UnitLower>().solveInPlace(c.topRows(smalldim));
+    if (rows > cols)
+        c.bottomRows(rows-cols).noalias() -= lu.matrixLU().bottomRows(rows-cols) * c.topRows(cols);
+    lu.matrixLU().topLeftCorner(rank, rank)
+                 .template triangularView<Eigen::Upper>().solveInPlace(c.topRows(rank));
+    for (Eigen::Index i=0; i < rank; i++)
+        dst[lu.permutationQ().indices().coeff(i)] = c[i];
+    for (Eigen::Index i=rank; i < cols; i++)
+        dst[lu.permutationQ().indices().coeff(i)] = 0.;
+}
+
 ///////////////////////////////////////
 // Solver
 ///////////////////////////////////////
 
+// a part of the structure of a system for writing, copied first if a fork shares it
+template <typename T>
+static T &writable(std::shared_ptr<const T> &shared)
+{
+    if (shared.use_count() > 1)
+        shared = std::make_shared<T>(*shared);
+    // only this system holds it now, and it was not created const
+    return const_cast<T &>(*shared);
+}
+
 // System
 System::System()
   : plist(0)
   , pdrivenlist(0)
+  , pIndex(std::make_shared<MAP_pD_I>())
   , pDependentParameters(0)
-  , clist(0)
-  , c2p()
-  , p2c()
+  , cgraph(std::make_shared<ConstraintGraph>())
   , subSystems(0)
   , subSystemsAux(0)
+  , parent(NULL)
   , reference(0)
+  , components(std::make_shared<Components>())
+  , partition(std::make_shared<Partition>())
+  , isPartitioned(false)
   , dofs(0)
+  , structuralDofs(-1)
   , hasUnknowns(false)
   , hasDiagnosis(false)
   , isInit(false)
   , emptyDiagnoseMatrix(true)
+  , dragAlgorithm(DogLeg)
+  , hasDeadline(false)
+  , pool(NULL)
   , maxIter(100)
   , maxIterRedundant(100)
+  , maxIterCorrector(8)
   , sketchSizeMultiplier(false)
   , sketchSizeMultiplierRedundant(false)
   , convergence(1e-10)
   , convergenceRedundant(1e-10)
+  , convergenceRough(XconvergenceRough)
   , qrAlgorithm(EigenSparseQR)
   , dogLegGaussStep(FullPivLU)
   , qrpivotThreshold(1E-13)
@@ -454,6 +522,17 @@ System::System()
   , DL_tolgRedundant(1E-80)
   , DL_tolxRedundant(1E-80)
   , DL_tolfRedundant(1E-10)
+  , NK_maxIterCG(1000)
+  , NK_preconditioner(BlockJacobiPreconditioner)
+  , blockDecomposition(true)
+  , blockParallelThreshold(64)
+  , rowParallelThreshold(2048)
+  , structuralPrecheck(false)
+  , analyticSolving(true)
+  , autoScaling(true)
+  , solutionCacheSize(0)
+  , multiStarts(0)
+  , multiStartRadius(0.1)
 {
     // currently Eigen only supports multithreading for multiplications
     // There is no appreciable gain from using more threads
@@ -536,14 +615,23 @@ System::System(std::vector<Constraint *> clist_)
 
 System::~System()
 {
+    delete pool; // waits for the pending asynchronous solves
     clear();
 }
 
+ThreadPool &System::threadPool()
+{
+    std::lock_guard<std::mutex> lock(poolMutex); // parallel blocks may get here together
+    if (!pool)
+        pool = new ThreadPool();
+    return *pool;
+}
+
 void System::clear()
 {
     plist.clear();
     pdrivenlist.clear();
-    pIndex.clear();
+    pIndex = std::make_shared<MAP_pD_I>();
     pDependentParameters.clear();
     pDependentParametersGroups.clear();
     hasUnknowns = false;
@@ -555,11 +643,21 @@ void System::clear()
     conflictingTags.clear();
     redundantTags.clear();
 
+    partition = std::make_shared<Partition>();
+    isPartitioned = false;
+
     reference.clear();
     clearSubSystems();
-    free(clist);
-    c2p.clear();
-    p2c.clear();
+    std::vector<Constraint *> owned(cgraph->clist);
+    if (parent) // a fork does not delete the constraints of its parent
+        owned.erase(std::remove_if(owned.begin(), owned.end(),
+                                   [this](Constraint *constr) { return !isOwnConstraint(constr); }),
+                    owned.end());
+    free(owned);
+    cgraph = std::make_shared<ConstraintGraph>();
+
+    dragTargets.clear();
+    dragConstraints.clear();
 }
 
 void System::invalidatedDiagnosis()
@@ -569,18 +667,69 @@ void System::invalidatedDiagnosis()
     pDependentParametersGroups.clear();
 }
 
-void System::clearByTag(int tagId)
+#ifdef PROFILE_CONSTRAINTS
+static const char *constraintTypeName(int type)
+{
+    static const char *names[ConstraintProfile::typesSize] = {
+        "None", "Equal", "Difference", "P2PDistance", "P2PAngle", "P2LDistance",
+        "PointOnLine", "PointOnPerpBisector", "Parallel", "Perpendicular", "L2LAngle",
+        "MidpointOnLine", "TangentCircumf", "PointOnEllipse", "TangentEllipseLine",
+        "InternalAlignmentPoint2Ellipse", "EqualMajorAxesConic",
+        "EllipticalArcRangeToEndPoints", "AngleViaPoint", "Snell", "CurveValue",
+        "PointOnHyperbola", "InternalAlignmentPoint2Hyperbola", "PointOnParabola",
+        "EqualFocalDistance", "TangentBSplineLine"
+    };
+    return names[type];
+}
+
+std::string System::getConstraintProfile() const
 {
-    std::vector<Constraint *> constrvec;
-    for (std::vector<Constraint *>::const_iterator
-         constr=clist.begin(); constr != clist.end(); ++constr) {
-        if ((*constr)->getTag() == tagId)
-            constrvec.push_back(*constr);
+    const ConstraintProfile &profile = ConstraintProfile::profile();
+    const ConstraintProfile::Evaluation evaluations[ConstraintProfile::evaluationsSize] =
+        { ConstraintProfile::Error, ConstraintProfile::Grad, ConstraintProfile::MaxStep };
+
+    std::vector< std::pair<double,int> > order; // total seconds and type
+    for (int type=0; type < ConstraintProfile::typesSize; type++) {
+        double seconds = 0.;
+        long long calls = 0;
+        for (int k=0; k < ConstraintProfile::evaluationsSize; k++) {
+            seconds += profile.seconds(ConstraintType(type), evaluations[k]);
+            calls += profile.calls(ConstraintType(type), evaluations[k]);
+        }
+        if (calls > 0)
+            order.push_back(std::make_pair(seconds, type));
     }
-    for (std::vector<Constraint *>::const_iterator
-         constr=constrvec.begin(); constr != constrvec.end(); ++constr) {
-        removeConstraint(*constr);
+    std::sort(order.rbegin(), order.rend());
+
+    std::stringstream report;
+    report << "Constraint evaluations (calls / estimated ms): error, grad, maxStep" << std::endl;
+    for (std::size_t i=0; i < order.size(); i++) {
+        ConstraintType type = ConstraintType(order[i].second);
+        report << constraintTypeName(type) << ":";
+        for (int k=0; k < ConstraintProfile::evaluationsSize; k++)
+            report << " " << profile.calls(type, evaluations[k])
+                   << " / " << 1e3 * profile.seconds(type, evaluations[k]);
+        report << std::endl;
     }
+    SolverReportingManager::Manager().LogString(report.str());
+    return report.str();
+}
+
+void System::resetConstraintProfile()
+{
+    ConstraintProfile::profile().reset();
+}
+#endif
+
+void System::clearByTag(int tagId)
+{
+    std::map<int,std::vector<Constraint *> >::const_iterator it = cgraph->tagIndex.find(tagId);
+    if (it == cgraph->tagIndex.end())
+        return;
+
+    std::vector<Constraint *> constrvec(it->second);
+    writable(cgraph).tagIndex.erase(tagId);
+    removeConstraints(constrvec);
 }
 
 int System::addConstraint(Constraint *constr)
@@ -589,41 +738,147 @@ int System::addConstraint(Constraint *constr)
     if (constr->getTag() >= 0) // negatively tagged constraints have no impact
         hasDiagnosis = false;  // on the diagnosis
 
-    clist.push_back(constr);
+    ConstraintGraph &g = writable(cgraph);
+    std::vector<Constraint *> &tagged = g.tagIndex[constr->getTag()];
+    ConstraintSlot &slot = g.clistIndex[constr];
+    slot.slot = g.clist.size();
+    slot.tag = constr->getTag();
+    slot.tagSlot = tagged.size();
+    g.clist.push_back(constr);
+    tagged.push_back(constr);
     VEC_pD constr_params = constr->params();
     for (VEC_pD::const_iterator param=constr_params.begin();
          param != constr_params.end(); ++param) {
 //        jacobi.set(constr, *param, 0.);
-        c2p[constr].push_back(*param);
-        p2c[*param].push_back(constr);
+        g.c2p[constr].push_back(*param);
+        g.p2c[*param].push_back(constr);
     }
-    return clist.size()-1;
+    if (isPartitioned)
+        joinSets(constr);
+    return g.clist.size()-1 - g.removedSlots; // its slot once clist is compacted
 }
 
 void System::removeConstraint(Constraint *constr)
 {
-    std::vector<Constraint *>::iterator it;
-    it = std::find(clist.begin(), clist.end(), constr);
-    if (it == clist.end())
-        return;
+    removeConstraints(std::vector<Constraint *>(1, constr));
+}
 
-    clist.erase(it);
-    if (constr->getTag() >= 0)
-        hasDiagnosis = false;
-    clearSubSystems();
+void System::removeConstraints(const std::vector<Constraint *> &constrvec)
+{
+    // The slot of a removed constraint in clist is left NULL, clist is compacted
+    // when it is used next (compactConstraints), and its slot in tagIndex is taken
+    // by the last constraint of the tag, so that removing k constraints costs
+    // O(k log n). The trailing NULL slots, e.g. the ones of the constraints of a
+    // drag, are dropped at once.
+    std::vector<Constraint *> removed;
+    bool isRemoved = false;
+    for (std::vector<Constraint *>::const_iterator itc=constrvec.begin(); itc != constrvec.end(); ++itc) {
+        Constraint *constr = *itc;
+        if (cgraph->clistIndex.count(constr) == 0) // not in the system or a duplicate of constrvec
+            continue;
 
-    VEC_pD constr_params = c2p[constr];
-    for (VEC_pD::const_iterator param=constr_params.begin();
-         param != constr_params.end(); ++param) {
-        std::vector<Constraint *> &constraints = p2c[*param];
-        it = std::find(constraints.begin(), constraints.end(), constr);
-        constraints.erase(it);
+        ConstraintGraph &g = writable(cgraph);
+        std::map<Constraint *,ConstraintSlot>::iterator it = g.clistIndex.find(constr);
+        g.clist[it->second.slot] = NULL;
+        g.removedSlots++;
+        isRemoved = true;
+
+        unindexTag(it->second);
+        g.clistIndex.erase(it);
+
+        if (constr->getTag() >= 0)
+            hasDiagnosis = false;
+
+        if (isPartitioned) {
+            markSplit(constr);
+            writable(partition).partitionRedundant.erase(constr);
+        }
+
+        // the order of p2c is irrelevant
+        std::map<Constraint *,VEC_pD >::iterator itp = g.c2p.find(constr);
+        for (VEC_pD::const_iterator param=itp->second.begin();
+             param != itp->second.end(); ++param) {
+            std::vector<Constraint *> &constraints = g.p2c[*param];
+            std::vector<Constraint *>::iterator it = std::find(constraints.begin(), constraints.end(), constr);
+            if (it != constraints.end()) {
+                *it = constraints.back();
+                constraints.pop_back();
+            }
+        }
+        g.c2p.erase(itp);
+
+        if (isOwnConstraint(constr))
+            removed.push_back(constr);
+    }
+    if (isRemoved) {
+        ConstraintGraph &g = writable(cgraph);
+        while (!g.clist.empty() && g.clist.back() == NULL) {
+            g.clist.pop_back();
+            g.removedSlots--;
+        }
+    }
+    if (isRemoved)
+        clearSubSystems();
+
+    free(removed);
+}
+
+void System::compactConstraints()
+{
+    if (cgraph->removedSlots == 0)
+        return;
+
+    ConstraintGraph &g = writable(cgraph);
+    int kept = 0;
+    for (int i=0; i < int(g.clist.size()); i++) {
+        if (g.clist[i] == NULL)
+            continue;
+        if (kept != i) {
+            g.clist[kept] = g.clist[i];
+            g.clistIndex[g.clist[kept]].slot = kept;
+        }
+        kept++;
     }
-    c2p.erase(constr);
+    g.clist.resize(kept);
+    g.removedSlots = 0;
+}
 
-    std::vector<Constraint *> constrvec;
-    constrvec.push_back(constr);
-    free(constrvec);
+void System::unindexTag(const ConstraintSlot &slot)
+{
+    // clearByTag has already dropped the whole entry
+    ConstraintGraph &g = writable(cgraph);
+    std::map<int,std::vector<Constraint *> >::iterator tagit = g.tagIndex.find(slot.tag);
+    if (tagit == g.tagIndex.end())
+        return;
+    std::vector<Constraint *> &tagged = tagit->second;
+    Constraint *last = tagged.back();
+    tagged[slot.tagSlot] = last;
+    g.clistIndex[last].tagSlot = slot.tagSlot;
+    tagged.pop_back();
+    if (tagged.empty())
+        g.tagIndex.erase(tagit);
+}
+
+void System::setConstraintTag(Constraint *constr, int tagId)
+{
+    std::map<Constraint *,ConstraintSlot>::const_iterator found = cgraph->clistIndex.find(constr);
+    if (found == cgraph->clistIndex.end()) {
+        constr->setTag(tagId);
+        return;
+    }
+    if (found->second.tag == tagId)
+        return;
+    isInit = false;        // the tags are reported by the diagnosis, and negatively
+    hasDiagnosis = false;  // tagged constraints are solved apart
+
+    ConstraintGraph &g = writable(cgraph);
+    std::map<Constraint *,ConstraintSlot>::iterator it = g.clistIndex.find(constr);
+    unindexTag(it->second);
+    std::vector<Constraint *> &tagged = g.tagIndex[tagId];
+    it->second.tag = tagId;
+    it->second.tagSlot = tagged.size();
+    tagged.push_back(constr);
+    constr->setTag(tagId);
 }
 
 // basic constraints
@@ -882,6 +1137,11 @@ int System::addConstraintCurveValue(Point &p, Curve &a, double *u, int tagId, bo
     return addConstraint(constr);
 }
 
+int System::addConstraintPointOnBSpline(Point &p, BSpline &b, double *u, int tagId, bool driving)
+{
+    return addConstraintCurveValue(p, b, u, tagId, driving);
+}
+
 int System::addConstraintArcOfHyperbolaRules(ArcOfHyperbola &a, int tagId, bool driving)
 {
     addConstraintCurveValue(a.start,a,a.startAngle, tagId, driving);
@@ -1005,6 +1265,18 @@ int System::addConstraintTangent(Circle &c, Arc &a, int tagId, bool driving)
                                        (d < *c.rad || d < *a.rad), tagId, driving);
 }
 
+int System::addConstraintTangent(Line &l, BSpline &b, double *u, int tagId, bool driving)
+{
+    Constraint *constr = new ConstraintBSplineTangentLine(l, b, u, false);
+    constr->setTag(tagId);
+    constr->setDriving(driving);
+    addConstraint(constr);
+    constr = new ConstraintBSplineTangentLine(l, b, u, true);
+    constr->setTag(tagId);
+    constr->setDriving(driving);
+    return addConstraint(constr);
+}
+
 int System::addConstraintCircleRadius(Circle &c, double *radius, int tagId, bool driving)
 {
     return addConstraintEqual(c.rad, radius, tagId, driving);
@@ -1337,13 +1609,14 @@ double System::calculateConstraintErrorByTag(int tagId)
     double sqErr = 0.0; //accumulator of squared errors
     double err = 0.0;//last computed signed error value
 
-    for (std::vector<Constraint *>::const_iterator
-         constr=clist.begin(); constr != clist.end(); ++constr) {
-        if ((*constr)->getTag() == tagId){
-            err = (*constr)->error();
+    std::map<int,std::vector<Constraint *> >::const_iterator it = cgraph->tagIndex.find(tagId);
+    if (it != cgraph->tagIndex.end()) {
+        for (std::vector<Constraint *>::const_iterator
+             constr=it->second.begin(); constr != it->second.end(); ++constr) {
+            err = constraintError(*constr);
             sqErr += err*err;
             cnt++;
-        };
+        }
     }
     switch (cnt) {
         case 0: //constraint not found!
@@ -1360,6 +1633,8 @@ double System::calculateConstraintErrorByTag(int tagId)
 
 void System::rescaleConstraint(int id, double coeff)
 {
+    compactConstraints();
+    const std::vector<Constraint *> &clist = cgraph->clist;
     if (id >= static_cast<int>(clist.size()) || id < 0)
         return;
     if (clist[id])
@@ -1368,10 +1643,15 @@ void System::rescaleConstraint(int id, double coeff)
 
 void System::declareUnknowns(VEC_pD &params)
 {
+    // the partition is kept if the same unknowns are declared again (e.g. by solve)
+    if (hasUnknowns && params == plist)
+        return;
+    isPartitioned = false;
     plist = params;
-    pIndex.clear();
+    std::shared_ptr<MAP_pD_I> index = std::make_shared<MAP_pD_I>();
     for (int i=0; i < int(plist.size()); ++i)
-        pIndex[plist[i]] = i;
+        (*index)[plist[i]] = i;
+    pIndex = index;
     hasUnknowns = true;
 }
 
@@ -1399,6 +1679,7 @@ void System::initSolution(Algorithm alg)
 
     // storing reference configuration
     setReference();
+    compactConstraints();
 
     // diagnose conflicting or redundant constraints
     if (!hasDiagnosis) {
@@ -1406,6 +1687,8 @@ void System::initSolution(Algorithm alg)
         if (!hasDiagnosis)
             return;
     }
+    const std::vector<Constraint *> &clist = cgraph->clist;
+    const MAP_pD_I &pIndex = *this->pIndex;
     std::vector<Constraint *> clistR;
     if (redundant.size()) {
         for (std::vector<Constraint *>::const_iterator constr=clist.begin(); constr != clist.end(); ++constr) {
@@ -1416,31 +1699,40 @@ void System::initSolution(Algorithm alg)
     else
         clistR = clist;
 
-    // partitioning into decoupled components
-    Graph g;
-    for (int i=0; i < int(plist.size() + clistR.size()); i++)
-        boost::add_vertex(g);
-
-    int cvtid = int(plist.size());
-    for (std::vector<Constraint *>::const_iterator constr=clistR.begin();
-         constr != clistR.end(); ++constr, cvtid++) {
-        VEC_pD &cparams = c2p[*constr];
-        for (VEC_pD::const_iterator param=cparams.begin();
-             param != cparams.end(); ++param) {
-            MAP_pD_I::const_iterator it = pIndex.find(*param);
-            if (it != pIndex.end())
-                boost::add_edge(cvtid, it->second, g);
+    // partitioning into decoupled components: componentOf[i] is the component of
+    // plist[i], followed by the ones of clistR. They are numbered in order of
+    // their first unknown, a constraint without unknowns is a component of its own.
+    updatePartition();
+    VEC_I componentOf(plist.size() + clistR.size());
+    int componentsSize = 0;
+    {
+        VEC_I rootComponent(plist.size(), -1);
+        for (int i=0; i < int(plist.size()); i++) {
+            int root = findSet(i);
+            if (rootComponent[root] < 0)
+                rootComponent[root] = componentsSize++;
+            componentOf[i] = rootComponent[root];
+        }
+        int cvtid = int(plist.size());
+        for (std::vector<Constraint *>::const_iterator constr=clistR.begin();
+             constr != clistR.end(); ++constr, cvtid++) {
+            componentOf[cvtid] = -1;
+            const VEC_pD &cparams = cgraph->c2p.at(*constr);
+            for (VEC_pD::const_iterator param=cparams.begin();
+                 param != cparams.end() && componentOf[cvtid] < 0; ++param) {
+                MAP_pD_I::const_iterator it = pIndex.find(*param);
+                if (it != pIndex.end())
+                    componentOf[cvtid] = componentOf[it->second];
+            }
+            if (componentOf[cvtid] < 0)
+                componentOf[cvtid] = componentsSize++;
         }
     }
 
-    VEC_I components(boost::num_vertices(g));
-    int componentsSize = 0;
-    if (!components.empty())
-        componentsSize = boost::connected_components(g, &components[0]);
-
     // identification of equality constraints and parameter reduction
+    std::shared_ptr<Components> comps = std::make_shared<Components>();
     std::set<Constraint *> reducedConstrs;  // constraints that will be eliminated through reduction
-    reductionmaps.clear(); // destroy any maps
+    std::vector< MAP_pD_pD > &reductionmaps = comps->reductionmaps;
     reductionmaps.resize(componentsSize); // create empty maps to be filled in
     {
         VEC_pD reducedParams=plist;
@@ -1464,59 +1756,464 @@ void System::initSolution(Algorithm alg)
         }
         for (int i=0; i < int(plist.size()); ++i)
             if (plist[i] != reducedParams[i]) {
-                int cid = components[i];
+                int cid = componentOf[i];
                 reductionmaps[cid][plist[i]] = reducedParams[i];
             }
     }
 
-    clists.clear(); // destroy any lists
+    std::vector< std::vector<Constraint *> > &clists = comps->clists;
     clists.resize(componentsSize); // create empty lists to be filled in
     int i = int(plist.size());
     for (std::vector<Constraint *>::const_iterator constr=clistR.begin();
          constr != clistR.end(); ++constr, i++) {
         if (reducedConstrs.count(*constr) == 0) {
-            int cid = components[i];
+            int cid = componentOf[i];
             clists[cid].push_back(*constr);
         }
     }
 
-    plists.clear(); // destroy any lists
+    std::vector< VEC_pD > &plists = comps->plists;
     plists.resize(componentsSize); // create empty lists to be filled in
     for (int i=0; i < int(plist.size()); ++i) {
-        int cid = components[i];
+        int cid = componentOf[i];
         plists[cid].push_back(plist[i]);
     }
 
-    // calculates subSystems and subSystemsAux from clists, plists and reductionmaps
-    clearSubSystems();
+    std::vector< VEC_pD > &inputParams = comps->inputParams;
     for (std::size_t cid=0; cid < clists.size(); cid++) {
-        std::vector<Constraint *> clist0, clist1;
+        std::set<double *> cparams(plists[cid].begin(), plists[cid].end());
         for (std::vector<Constraint *>::const_iterator constr=clists[cid].begin();
-             constr != clists[cid].end(); ++constr) {
-            if ((*constr)->getTag() >= 0)
-                clist0.push_back(*constr);
-            else // move or distance from reference constraints
-                clist1.push_back(*constr);
-        }
+             constr != clists[cid].end(); ++constr)
+            cparams.insert(cgraph->c2p.at(*constr).begin(), cgraph->c2p.at(*constr).end());
+        inputParams.push_back(VEC_pD(cparams.begin(), cparams.end()));
+    }
 
+    // calculates subSystems and subSystemsAux from clists, plists and reductionmaps
+    clearSubSystems();
+    components = comps;
+    for (std::size_t cid=0; cid < clists.size(); cid++) {
         subSystems.push_back(NULL);
         subSystemsAux.push_back(NULL);
-        if (clist0.size() > 0)
-            subSystems[cid] = new SubSystem(clist0, plists[cid], reductionmaps[cid]);
-        if (clist1.size() > 0)
-            subSystemsAux[cid] = new SubSystem(clist1, plists[cid], reductionmaps[cid]);
+        subSystemBlocks.push_back(std::vector<SubSystem *>());
+        subSystemBlockLevels.push_back(VEC_I());
+        solvedInputs.push_back(VEC_D());
+        componentSolved.push_back(true);
+        componentBuilt.push_back(false);
+        keyParams.push_back(VEC_pD());
+        structureKeys.push_back(0);
+
+        // components with temporary constraints are solved on every drag update
+        bool hasTemporary = false;
+        for (std::vector<Constraint *>::const_iterator constr=clists[cid].begin();
+             constr != clists[cid].end(); ++constr)
+            hasTemporary = hasTemporary || (*constr)->getTag() < 0;
+        if (!parent || hasTemporary)
+            buildSubSystems(cid);
     }
 
     isInit = true;
 }
 
+int System::findSet(int i) const
+{
+    // no path compression, so that finding does not write a partition shared with
+    // a fork; joining by size keeps the trees O(log n) deep
+    const VEC_I &paramParent = partition->paramParent;
+    while (paramParent[i] != i)
+        i = paramParent[i];
+    return i;
+}
+
+void System::joinSets(Constraint *constr)
+{
+    std::map<Constraint *,VEC_pD >::const_iterator it = cgraph->c2p.find(constr);
+    if (it == cgraph->c2p.end())
+        return;
+
+    int first = -1;
+    for (VEC_pD::const_iterator param=it->second.begin(); param != it->second.end(); ++param) {
+        MAP_pD_I::const_iterator itp = pIndex->find(*param);
+        if (itp == pIndex->end())
+            continue;
+        int root = findSet(itp->second);
+        if (first < 0)
+            first = root;
+        else if (root != first) {
+            // the smaller set is moved into the larger one
+            Partition &p = writable(partition);
+            if (p.paramSets[root].size() > p.paramSets[first].size())
+                std::swap(root, first);
+            p.paramParent[root] = first;
+            p.paramSets[first].insert(p.paramSets[first].end(),
+                                      p.paramSets[root].begin(), p.paramSets[root].end());
+            VEC_I().swap(p.paramSets[root]);
+        }
+    }
+}
+
+void System::markSplit(Constraint *constr)
+{
+    // all the unknowns of constr are in the same set, the first one marks it
+    std::map<Constraint *,VEC_pD >::const_iterator it = cgraph->c2p.find(constr);
+    if (it == cgraph->c2p.end())
+        return;
+    for (VEC_pD::const_iterator param=it->second.begin(); param != it->second.end(); ++param) {
+        MAP_pD_I::const_iterator itp = pIndex->find(*param);
+        if (itp != pIndex->end()) {
+            writable(partition).splitParams.push_back(itp->second);
+            return;
+        }
+    }
+}
+
+void System::splitSet(int root)
+{
+    Partition &p = writable(partition);
+    VEC_I members;
+    members.swap(p.paramSets[root]);
+    for (VEC_I::const_iterator m=members.begin(); m != members.end(); ++m) {
+        p.paramParent[*m] = *m;
+        p.paramSets[*m].assign(1, *m);
+    }
+    // the constraints on the members do not reach out of the set
+    for (VEC_I::const_iterator m=members.begin(); m != members.end(); ++m) {
+        std::map<double *,std::vector<Constraint *> >::const_iterator it = cgraph->p2c.find(plist[*m]);
+        if (it == cgraph->p2c.end())
+            continue;
+        for (std::vector<Constraint *>::const_iterator constr=it->second.begin();
+             constr != it->second.end(); ++constr)
+            if (p.partitionRedundant.count(*constr) == 0)
+                joinSets(*constr);
+    }
+}
+
+void System::updatePartition()
+{
+    if (!isPartitioned) {
+        int psize = int(plist.size());
+        std::shared_ptr<Partition> fresh = std::make_shared<Partition>();
+        fresh->paramParent.resize(psize);
+        fresh->paramSets.assign(psize, VEC_I());
+        for (int i=0; i < psize; i++) {
+            fresh->paramParent[i] = i;
+            fresh->paramSets[i].assign(1, i);
+        }
+        fresh->partitionRedundant = redundant;
+        partition = fresh;
+        const std::vector<Constraint *> &clist = cgraph->clist;
+        for (std::vector<Constraint *>::const_iterator constr=clist.begin(); constr != clist.end(); ++constr)
+            if (redundant.count(*constr) == 0)
+                joinSets(*constr);
+        isPartitioned = true;
+        return;
+    }
+
+    // the constraints diagnosed redundant since the last update leave the partition,
+    // the ones that are not redundant anymore join it
+    std::vector<Constraint *> leaving, entering;
+    std::set_difference(redundant.begin(), redundant.end(),
+                        partition->partitionRedundant.begin(), partition->partitionRedundant.end(),
+                        std::back_inserter(leaving));
+    std::set_difference(partition->partitionRedundant.begin(), partition->partitionRedundant.end(),
+                        redundant.begin(), redundant.end(),
+                        std::back_inserter(entering));
+    if (leaving.empty() && entering.empty() && partition->splitParams.empty())
+        return; // e.g. in a fork that did not change the constraints
+
+    writable(partition).partitionRedundant = redundant;
+    for (std::vector<Constraint *>::const_iterator constr=leaving.begin(); constr != leaving.end(); ++constr)
+        markSplit(*constr);
+    for (std::vector<Constraint *>::const_iterator constr=entering.begin(); constr != entering.end(); ++constr)
+        joinSets(*constr);
+
+    // only the marked sets are recomputed, each one once
+    std::set<int> roots;
+    VEC_I splitParams;
+    splitParams.swap(writable(partition).splitParams);
+    for (VEC_I::const_iterator i=splitParams.begin(); i != splitParams.end(); ++i)
+        roots.insert(findSet(*i));
+    for (std::set<int>::const_iterator root=roots.begin(); root != roots.end(); ++root)
+        splitSet(*root);
+}
+
+void System::buildSubSystems(int cid)
+{
+    std::vector<Constraint *> clist0, clist1;
+    for (std::vector<Constraint *>::const_iterator constr=components->clists[cid].begin();
+         constr != components->clists[cid].end(); ++constr) {
+        if ((*constr)->getTag() >= 0)
+            clist0.push_back(*constr);
+        else // move or distance from reference constraints
+            clist1.push_back(*constr);
+    }
+
+    // a fork relocates the unknowns of the component, the subsystems read and
+    // apply all the values of the component where the fork keeps them
+    MAP_pD_pD locations;
+    if (parent) {
+        for (VEC_pD::const_iterator param=components->plists[cid].begin(); param != components->plists[cid].end(); ++param)
+            relocate(*param);
+        getLocations(components->inputParams[cid], locations);
+    }
+
+    if (clist0.size() > 0)
+        subSystems[cid] = new SubSystem(clist0, components->plists[cid], components->reductionmaps[cid], locations);
+    if (clist1.size() > 0)
+        subSystemsAux[cid] = new SubSystem(clist1, components->plists[cid], components->reductionmaps[cid], locations);
+    // components with temporary constraints are solved as a whole by the SQP solver
+    if (blockDecomposition && subSystems[cid] && !subSystemsAux[cid])
+        decomposeSubSystem(cid, clist0, locations);
+    componentBuilt[cid] = true;
+}
+
+void System::dropSubSystems(int cid)
+{
+    delete subSystems[cid];
+    delete subSystemsAux[cid];
+    subSystems[cid] = NULL;
+    subSystemsAux[cid] = NULL;
+    free(subSystemBlocks[cid]);
+    subSystemBlocks[cid].clear();
+    subSystemBlockLevels[cid].clear();
+    solvedInputs[cid].clear();
+    componentSolved[cid] = false;
+    componentBuilt[cid] = false;
+}
+
+void System::decomposeSubSystem(int cid, std::vector<Constraint *> &clist0, const MAP_pD_pD &locations)
+{
+    // Structural (Dulmage-Mendelsohn) decomposition of the component:
+    // - a maximum matching between constraints and reduced parameters is searched,
+    // - the constraints reachable from unmatched parameters form the under-determined
+    //   part, which is solved last as a single block,
+    // - the rest is square and is split into its strongly connected blocks, which
+    //   can be solved one after the other, each one with the parameters of the
+    //   previous blocks held fixed.
+    // Components with an over-determined part are not split.
+    const MAP_pD_pD &reductionmap = components->reductionmaps[cid];
+
+    // columns of the bipartite graph are the reduced parameters
+    MAP_pD_I colIndex;
+    VEC_I paramCol(components->plists[cid].size());
+    int cols = 0;
+    for (int i=0; i < int(components->plists[cid].size()); i++) {
+        MAP_pD_pD::const_iterator itr = reductionmap.find(components->plists[cid][i]);
+        double *param = (itr != reductionmap.end()) ? itr->second : components->plists[cid][i];
+        MAP_pD_I::const_iterator itc = colIndex.find(param);
+        if (itc == colIndex.end()) {
+            colIndex[param] = cols;
+            paramCol[i] = cols++;
+        }
+        else
+            paramCol[i] = itc->second;
+    }
+    MAP_pD_I origCol;
+    for (int i=0; i < int(components->plists[cid].size()); i++)
+        origCol[components->plists[cid][i]] = paramCol[i];
+
+    BipartiteGraph graph(int(clist0.size()), cols);
+    for (int row=0; row < int(clist0.size()); row++) {
+        SET_I rowcols;
+        const VEC_pD &cparams = cgraph->c2p.at(clist0[row]);
+        for (VEC_pD::const_iterator param=cparams.begin(); param != cparams.end(); ++param) {
+            MAP_pD_I::const_iterator it = origCol.find(*param);
+            if (it != origCol.end() && rowcols.insert(it->second).second)
+                graph.addEdge(row, it->second);
+        }
+    }
+
+    if (graph.maximumMatching() < graph.rows())
+        return;
+
+    std::vector<bool> underRows, underCols;
+    graph.underdeterminedPart(underRows, underCols);
+
+    std::vector<bool> squareRows(graph.rows());
+    for (int row=0; row < graph.rows(); row++)
+        squareRows[row] = !underRows[row];
+
+    std::vector<VEC_I> blockRows;
+    VEC_I levels;
+    graph.squareBlocks(squareRows, blockRows, levels);
+
+    bool hasUnderdetermined = std::find(underRows.begin(), underRows.end(), true) != underRows.end();
+    if (int(blockRows.size()) + (hasUnderdetermined ? 1 : 0) < 2)
+        return;
+
+    if (hasUnderdetermined) {
+        blockRows.push_back(VEC_I());
+        for (int row=0; row < graph.rows(); row++)
+            if (underRows[row])
+                blockRows.back().push_back(row);
+        levels.push_back(levels.empty() ? 0 : levels.back() + 1);
+    }
+
+    std::vector<bool> blockCols(cols);
+    for (std::size_t k=0; k < blockRows.size(); k++) {
+        std::fill(blockCols.begin(), blockCols.end(), false);
+        std::vector<Constraint *> blockConstrs;
+        for (VEC_I::const_iterator row=blockRows[k].begin(); row != blockRows[k].end(); ++row) {
+            blockConstrs.push_back(clist0[*row]);
+            blockCols[graph.rowMatch(*row)] = true;
+        }
+        if (k == blockRows.size()-1 && hasUnderdetermined) {
+            for (int col=0; col < cols; col++)
+                if (underCols[col])
+                    blockCols[col] = true;
+        }
+        // parameters of other blocks are seen as constants by this block
+        VEC_pD blockParams;
+        for (int i=0; i < int(components->plists[cid].size()); i++)
+            if (blockCols[paramCol[i]])
+                blockParams.push_back(components->plists[cid][i]);
+        subSystemBlocks[cid].push_back(new SubSystem(blockConstrs, blockParams, reductionmap, locations));
+    }
+    subSystemBlockLevels[cid] = levels;
+}
+
+int System::solveBlocks(int cid, bool isFine, Algorithm alg, bool isRedundantsolving)
+{
+    // The blocks of a level only read the parameters of lower levels, which are
+    // written to the original parameters once their level is solved.
+    std::vector<SubSystem *> &blocks = subSystemBlocks[cid];
+    VEC_I &levels = subSystemBlockLevels[cid];
+
+    int res = Success;
+    std::size_t begin = 0;
+    while (begin < blocks.size() && res == Success) {
+        std::size_t end = begin;
+        int levelSize = 0;
+        while (end < blocks.size() && levels[end] == levels[begin])
+            levelSize += blocks[end++]->pSize();
+
+        if (end - begin > 1 && levelSize >= blockParallelThreshold) {
+            VEC_I results(end - begin);
+            threadPool().parallelFor(int(end - begin), 1, [this, &blocks, &results, begin, isFine, alg, isRedundantsolving](int first, int last) {
+                for (int k=first; k < last; k++)
+                    results[k] = solve(blocks[begin + k], isFine, alg, isRedundantsolving);
+            });
+            for (std::size_t k=0; k < results.size(); k++)
+                res = worseStatus(res, results[k]);
+        }
+        else {
+            for (std::size_t k=begin; k < end; k++)
+                res = worseStatus(res, solve(blocks[k], isFine, alg, isRedundantsolving));
+        }
+
+        for (std::size_t k=begin; k < end; k++)
+            blocks[k]->applySolution();
+        for (MAP_pD_pD::const_iterator it=components->reductionmaps[cid].begin();
+             it != components->reductionmaps[cid].end(); ++it)
+            setValue(it->first, *location(it->second));
+
+        begin = end;
+    }
+
+    // hand the solution over to the whole component, which is the one applied
+    if (res == Success)
+        syncSubSystems(cid);
+    return res;
+}
+
+int System::solveMultiStart(int cid, bool isFine, Algorithm alg, bool isRedundantsolving)
+{
+    // The starts are perturbed from the reference along the null space of the jacobian
+    // there, which the constraints leave free to first order, or along all directions
+    // if the jacobian has full column rank. Each start is solved by a subsystem of its
+    // own, which keeps the unknowns of the component in its own storage, so that the
+    // starts run in parallel without writing to the parameters. The successful solution
+    // closest to the reference is handed to the subsystem of the component.
+    SubSystem *subsys = subSystems[cid];
+    Eigen::VectorXd xFailed, x0;
+    subsys->getParams(xFailed);
+
+    Eigen::MatrixXd J(subsys->cSize(), subsys->pSize());
+    subsys->redirectParams(); // the original parameters are at the reference
+    subsys->getParams(x0);
+    subsys->calcJacobi(J);
+    subsys->revertParams();
+    subsys->setParams(xFailed);
+
+    Eigen::FullPivLU<Eigen::MatrixXd> lu(J);
+    Eigen::MatrixXd N;
+    if (lu.rank() < J.cols()) {
+        Eigen::MatrixXd ker = lu.kernel();
+        Eigen::HouseholderQR<Eigen::MatrixXd> qr(ker);
+        N = qr.householderQ() * Eigen::MatrixXd::Identity(ker.rows(), ker.cols());
+    }
+    else
+        N = Eigen::MatrixXd::Identity(J.cols(), J.cols());
+    double radius = multiStartRadius * std::max(1., x0.lpNorm<Eigen::Infinity>());
+
+    MAP_pD_pD baseLocations;
+    getLocations(components->inputParams[cid], baseLocations);
+    const VEC_pD &params = components->plists[cid];
+    std::vector<VEC_D> storage(multiStarts, VEC_D(params.size()));
+    std::vector<SubSystem *> starts(multiStarts);
+    for (int k=0; k < multiStarts; k++) {
+        MAP_pD_pD locations = baseLocations;
+        for (std::size_t i=0; i < params.size(); i++)
+            locations[params[i]] = &storage[k][i];
+        starts[k] = new SubSystem(components->clists[cid], params, components->reductionmaps[cid], locations);
+
+        // the same seeds for every solve, so that the result is reproducible
+        std::mt19937 generator(k + 1);
+        std::normal_distribution<double> normal;
+        Eigen::VectorXd c(N.cols());
+        for (int j=0; j < c.size(); j++)
+            c[j] = normal(generator);
+        Eigen::VectorXd x = x0 + (radius * (k + 1) / (multiStarts * c.norm())) * (N * c);
+        starts[k]->setParams(x);
+        starts[k]->applySolution(); // into the storage, where the solver starts from
+    }
+
+    VEC_I results(multiStarts);
+    threadPool().parallelFor(multiStarts, 1, [this, &starts, &results, isFine, alg, isRedundantsolving](int begin, int end) {
+        for (int k=begin; k < end; k++)
+            results[k] = solve(starts[k], isFine, alg, isRedundantsolving);
+    });
+
+    int best = -1;
+    double bestDistance = 0.;
+    Eigen::VectorXd x, xBest;
+    for (int k=0; k < multiStarts; k++) {
+        if (results[k] != Success)
+            continue;
+        starts[k]->getParams(x);
+        double distance = (x - x0).norm();
+        if (best < 0 || distance < bestDistance) {
+            best = k;
+            bestDistance = distance;
+            xBest = x;
+        }
+    }
+    free(starts);
+
+    if (best < 0)
+        return Failed;
+    subsys->setParams(xBest);
+    return Success;
+}
+
+void System::syncSubSystems(int cid)
+{
+    Eigen::VectorXd &x = syncValues;
+    x.resize(components->plists[cid].size());
+    for (int i=0; i < int(components->plists[cid].size()); i++)
+        x[i] = *location(components->plists[cid][i]);
+    if (subSystems[cid])
+        subSystems[cid]->setParams(components->plists[cid], x);
+    if (subSystemsAux[cid])
+        subSystemsAux[cid]->setParams(components->plists[cid], x);
+}
+
 void System::setReference()
 {
     reference.clear();
     reference.reserve(plist.size());
     for (VEC_pD::const_iterator param=plist.begin();
          param != plist.end(); ++param)
-        reference.push_back(**param);
+        reference.push_back(*location(*param));
 }
 
 void System::resetToReference()
@@ -1525,10 +2222,157 @@ void System::resetToReference()
         VEC_D::const_iterator ref=reference.begin();
         VEC_pD::iterator param=plist.begin();
         for (; ref != reference.end(); ++ref, ++param)
-            **param = *ref;
+            setValue(*param, *ref);
+    }
+}
+
+System *System::fork() const
+{
+    System *forked = new System();
+    forked->parent = this;
+
+    forked->maxIter = maxIter;
+    forked->maxIterRedundant = maxIterRedundant;
+    forked->maxIterCorrector = maxIterCorrector;
+    forked->sketchSizeMultiplier = sketchSizeMultiplier;
+    forked->sketchSizeMultiplierRedundant = sketchSizeMultiplierRedundant;
+    forked->convergence = convergence;
+    forked->convergenceRedundant = convergenceRedundant;
+    forked->convergenceRough = convergenceRough;
+    forked->qrAlgorithm = qrAlgorithm;
+    forked->dogLegGaussStep = dogLegGaussStep;
+    forked->qrpivotThreshold = qrpivotThreshold;
+    forked->debugMode = debugMode;
+    forked->LM_eps = LM_eps;
+    forked->LM_eps1 = LM_eps1;
+    forked->LM_tau = LM_tau;
+    forked->DL_tolg = DL_tolg;
+    forked->DL_tolx = DL_tolx;
+    forked->DL_tolf = DL_tolf;
+    forked->LM_epsRedundant = LM_epsRedundant;
+    forked->LM_eps1Redundant = LM_eps1Redundant;
+    forked->LM_tauRedundant = LM_tauRedundant;
+    forked->DL_tolgRedundant = DL_tolgRedundant;
+    forked->DL_tolxRedundant = DL_tolxRedundant;
+    forked->DL_tolfRedundant = DL_tolfRedundant;
+    forked->NK_maxIterCG = NK_maxIterCG;
+    forked->NK_preconditioner = NK_preconditioner;
+    forked->blockDecomposition = blockDecomposition;
+    forked->blockParallelThreshold = blockParallelThreshold;
+    forked->rowParallelThreshold = rowParallelThreshold;
+    forked->structuralPrecheck = structuralPrecheck;
+    forked->analyticSolving = analyticSolving;
+    forked->autoScaling = autoScaling;
+    forked->solutionCacheSize = solutionCacheSize;
+    forked->multiStarts = multiStarts;
+    forked->multiStartRadius = multiStartRadius;
+
+    // the structure is shared until the fork writes it
+    forked->plist = plist;
+    forked->pdrivenlist = pdrivenlist;
+    forked->pIndex = pIndex;
+    forked->pDependentParameters = pDependentParameters;
+    forked->pDependentParametersGroups = pDependentParametersGroups;
+    forked->cgraph = cgraph;
+    forked->partition = partition;
+    forked->isPartitioned = isPartitioned;
+
+    forked->dofs = dofs;
+    forked->redundant = redundant;
+    forked->conflictingTags = conflictingTags;
+    forked->redundantTags = redundantTags;
+    forked->structuralDofs = structuralDofs;
+    forked->structurallyConflictingTags = structurallyConflictingTags;
+    forked->hasUnknowns = hasUnknowns;
+    forked->hasDiagnosis = hasDiagnosis;
+    forked->emptyDiagnoseMatrix = emptyDiagnoseMatrix;
+    forked->dragAlgorithm = dragAlgorithm;
+
+    // the components are shared as well, the fork builds their subsystems on first use
+    forked->components = components;
+    std::size_t componentsSize = components->clists.size();
+    forked->keyParams.resize(componentsSize);
+    forked->structureKeys.resize(componentsSize);
+    forked->subSystems.assign(componentsSize, NULL);
+    forked->subSystemsAux.assign(componentsSize, NULL);
+    forked->subSystemBlocks.resize(componentsSize);
+    forked->subSystemBlockLevels.resize(componentsSize);
+    forked->solvedInputs.resize(componentsSize);
+    forked->componentSolved.assign(componentsSize, false);
+    forked->componentBuilt.assign(componentsSize, false);
+    forked->isInit = isInit;
+
+    forked->setReference();
+    return forked;
+}
+
+bool System::isOwnConstraint(Constraint *constr) const
+{
+    // the parent is not changed while its forks exist
+    return !parent || parent->cgraph->clistIndex.count(constr) == 0;
+}
+
+double *System::relocated(double *param) const
+{
+    MAP_pD_pD::const_iterator it = relocation.find(param);
+    if (it != relocation.end())
+        return it->second;
+    return parent->location(param);
+}
+
+double *System::relocate(double *param)
+{
+    MAP_pD_pD::const_iterator it = relocation.find(param);
+    if (it != relocation.end())
+        return it->second;
+
+    relocatedValues.push_back(*parent->location(param));
+    double *value = &relocatedValues.back();
+    relocation[param] = value;
+    // the subsystems built so far read param from the parent
+    for (int cid=0; cid < int(componentBuilt.size()); cid++) {
+        if (componentBuilt[cid] &&
+            std::binary_search(components->inputParams[cid].begin(), components->inputParams[cid].end(), param))
+            dropSubSystems(cid);
+    }
+    return value;
+}
+
+void System::setForkValue(double *param, double value)
+{
+    MAP_pD_pD::const_iterator it = relocation.find(param);
+    if (it != relocation.end())
+        *(it->second) = value;
+    else if (*parent->location(param) != value)
+        *relocate(param) = value;
+}
+
+void System::getLocations(const VEC_pD &params, MAP_pD_pD &locationsOut) const
+{
+    locationsOut.clear();
+    for (VEC_pD::const_iterator param=params.begin(); param != params.end(); ++param) {
+        double *loc = location(*param);
+        if (loc != *param)
+            locationsOut[*param] = loc;
     }
 }
 
+const ParamView &System::valuesView(Constraint *constr, ParamView &view) const
+{
+    if (!parent)
+        return constr->ownView();
+    MAP_pD_pD locations;
+    getLocations(constr->params(), locations);
+    constr->bind(view, locations);
+    return view;
+}
+
+double System::constraintError(Constraint *constr) const
+{
+    ParamView view;
+    return constr->error(valuesView(constr, view));
+}
+
 int System::solve(VEC_pD &params, bool isFine, Algorithm alg, bool isRedundantsolving)
 {
     declareUnknowns(params);
@@ -1542,29 +2386,99 @@ int System::solve(bool isFine, Algorithm alg, bool isRedundantsolving)
         return Failed;
 
     bool isReset = false;
+    bool isModified = false; // if block solving has written to the original parameters
     // return success by default in order to permit coincidence constraints to be applied
     // even if no other system has to be solved
     int res = Success;
+    VEC_D &inputs = componentInputs;
     for (int cid=0; cid < int(subSystems.size()); cid++) {
-        if ((subSystems[cid] || subSystemsAux[cid]) && !isReset) {
+        if (componentBuilt[cid] && !subSystems[cid] && !subSystemsAux[cid])
+            continue;
+        if (!isReset) {
              resetToReference();
              isReset = true;
         }
+        if (isInterrupted()) {
+            // the subsystems may still hold the solution of an earlier solve
+            res = worseStatus(res, Partial);
+            componentSolved[cid] = false;
+            solvedInputs[cid].clear();
+            continue;
+        }
+        if (!componentBuilt[cid]) {
+            // a fork only builds the components it has to solve
+            if (isSolvedComponent(cid, isFine)) {
+                componentSolved[cid] = false;
+                continue;
+            }
+            buildSubSystems(cid);
+            // only reduced equalities, which applySolution enforces
+            if (!subSystems[cid] && !subSystemsAux[cid]) {
+                componentSolved[cid] = true;
+                continue;
+            }
+        }
+        if (isCleanComponent(cid, isFine, inputs))
+            continue;
+
+        std::size_t key = 0;
+        VEC_D keyInputs;
+        if (solutionCacheSize > 0) {
+            key = solutionKey(cid, keyInputs);
+            if (restoreSolution(cid, key, keyInputs, isFine)) {
+                componentSolved[cid] = true;
+                if (isFine)
+                    solvedInputs[cid] = inputs;
+                else
+                    solvedInputs[cid].clear();
+                continue;
+            }
+        }
+
+        int cres;
         if (subSystems[cid] && subSystemsAux[cid])
-            res = std::max(res, solve(subSystems[cid], subSystemsAux[cid], isFine, isRedundantsolving));
+            cres = solve(subSystems[cid], subSystemsAux[cid], isFine, isRedundantsolving);
+        else if (subSystems[cid] && !subSystemBlocks[cid].empty()) {
+            isModified = true;
+            cres = solveBlocks(cid, isFine, alg, isRedundantsolving);
+            if (cres == Partial)
+                syncSubSystems(cid); // keep what the solved blocks have reached
+            else if (cres != Success) {
+                // a block may have picked a root that does not fit the following
+                // blocks, retry with the component as a whole
+                resetToReference();
+                cres = solve(subSystems[cid], isFine, alg, isRedundantsolving);
+            }
+        }
         else if (subSystems[cid])
-            res = std::max(res, solve(subSystems[cid], isFine, alg, isRedundantsolving));
-        else if (subSystemsAux[cid])
-            res = std::max(res, solve(subSystemsAux[cid], isFine, alg, isRedundantsolving));
+            cres = solve(subSystems[cid], isFine, alg, isRedundantsolving);
+        else
+            cres = solve(subSystemsAux[cid], isFine, alg, isRedundantsolving);
+        if (cres == Failed && multiStarts > 0 && subSystems[cid] && !subSystemsAux[cid] &&
+            !isInterrupted())
+            cres = solveMultiStart(cid, isFine, alg, isRedundantsolving);
+        res = worseStatus(res, cres);
+
+        componentSolved[cid] = true;
+        if (cres == Success && isFine) { // a rough solution is not kept from a fine solve
+            solvedInputs[cid] = inputs;
+            if (solutionCacheSize > 0)
+                storeSolution(cid, key, keyInputs);
+        }
+        else
+            solvedInputs[cid].clear();
     }
+    // solutions are kept in the subsystems until applySolution
+    if (isModified)
+        resetToReference();
     if (res == Success) {
         for (std::set<Constraint *>::const_iterator constr=redundant.begin();
              constr != redundant.end(); ++constr){
             //DeepSOIC: there used to be a comparison of signed error value to
             //convergence, which makes no sense. Potentially I fixed bug, and
             //chances are low I've broken anything.
-            double err = (*constr)->error();
-            if (err*err > (isRedundantsolving?convergenceRedundant:convergence)) {
+            double err = constraintError(*constr);
+            if (err*err > tolerance(isRedundantsolving?convergenceRedundant:convergence, isFine)) {
                 res = Converged;
                 return res;
             }
@@ -1573,19 +2487,367 @@ int System::solve(bool isFine, Algorithm alg, bool isRedundantsolving)
     return res;
 }
 
+int System::solveWithDeadline(double budget, double &residual, bool isFine, Algorithm alg)
+{
+    hasDeadline = true;
+    deadline = std::chrono::steady_clock::now() +
+               std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                   std::chrono::duration<double, std::milli>(budget));
+    int res = solve(isFine, alg);
+    hasDeadline = false;
+
+    // the solution is evaluated in place, then the reference is restored
+    // (components of temporary constraints only are measured on those)
+    residual = 0.;
+    for (int cid=0; cid < int(subSystems.size()); cid++) {
+        SubSystem *subsys = subSystems[cid] ? subSystems[cid] : subSystemsAux[cid];
+        if (subsys) {
+            if (componentSolved[cid])
+                applySolution(cid);
+            residual += subsys->error();
+        }
+    }
+    resetToReference();
+    return res;
+}
+
+std::future<int> System::solveAsync(const CancellationToken &token, bool isFine, Algorithm alg)
+{
+    return threadPool().submit([this, token, isFine, alg]() {
+        std::lock_guard<std::mutex> lock(asyncMutex);
+        return solveCancellable(token, isFine, alg);
+    });
+}
+
+std::future<int> System::refineAsync(const CancellationToken &token, Algorithm alg)
+{
+    return threadPool().submit([this, token, alg]() {
+        std::lock_guard<std::mutex> lock(asyncMutex);
+        if (token.isCancelled())
+            return int(Failed);
+
+        // start from the applied (rough) solution instead of the previous reference
+        setReference();
+        return solveCancellable(token, true, alg);
+    });
+}
+
+int System::solveCancellable(const CancellationToken &token, bool isFine, Algorithm alg)
+{
+    if (token.isCancelled())
+        return Failed;
+
+    cancellation = token;
+    int res = solve(isFine, alg);
+    cancellation = CancellationToken();
+
+    if (token.isCancelled()) {
+        resetToReference();
+        for (int cid=0; cid < int(subSystems.size()); cid++) {
+            syncSubSystems(cid);
+            solvedInputs[cid].clear();
+        }
+        res = Failed;
+    }
+    return res;
+}
+
+int System::sweep(double *param, const VEC_D &values, VEC_D &solutions, bool isFine, Algorithm alg)
+{
+    solutions.clear();
+    if (!isInit || pIndex->count(param) > 0) // param must be a driving value, not an unknown
+        return Failed;
+
+    // only the components with constraints depending on param are affected
+    VEC_I cids;
+    std::map<double *,std::vector<Constraint *> >::const_iterator dependents = cgraph->p2c.find(param);
+    if (dependents != cgraph->p2c.end()) {
+        std::set<Constraint *> dependentSet(dependents->second.begin(), dependents->second.end());
+        for (int cid=0; cid < int(components->clists.size()); cid++) {
+            for (std::vector<Constraint *>::const_iterator constr=components->clists[cid].begin();
+                 constr != components->clists[cid].end(); ++constr) {
+                if (dependentSet.count(*constr) > 0) {
+                    cids.push_back(cid);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (parent) // the subsystems read param where the fork writes it
+        relocate(param);
+    for (VEC_I::const_iterator cid=cids.begin(); cid != cids.end(); ++cid)
+        if (!componentBuilt[*cid])
+            buildSubSystems(*cid);
+
+    VEC_D initial(plist.size()), accepted(plist.size());
+    for (int i=0; i < int(plist.size()); i++)
+        initial[i] = getValue(plist[i]);
+    accepted = initial;
+    double initialValue = getValue(param);
+
+    int res = Success;
+    solutions.reserve(values.size() * plist.size());
+    double from = initialValue;
+    for (std::size_t k=0; k < values.size(); k++) {
+        double to = values[k];
+        double t = 0., dt = 1.;
+        int stepres = Success;
+        while (t < 1.) {
+            double tnext = std::min(1., t + dt);
+            stepres = sweepStep(cids, param, from + tnext*(to - from), isFine, alg);
+            if (stepres == Success) {
+                t = tnext;
+                dt *= 2;
+                for (int i=0; i < int(plist.size()); i++)
+                    accepted[i] = getValue(plist[i]);
+            }
+            else {
+                for (int i=0; i < int(plist.size()); i++)
+                    setValue(plist[i], accepted[i]);
+                setValue(param, from + t*(to - from));
+                dt /= 2;
+                if (dt < 1./64)
+                    break;
+            }
+        }
+
+        if (t < 1.) {
+            // the continuation is lost, solve from the last accepted point
+            setValue(param, to);
+            stepres = Success;
+            for (VEC_I::const_iterator cid=cids.begin(); cid != cids.end(); ++cid) {
+                if (subSystems[*cid] && subSystemsAux[*cid])
+                    stepres = worseStatus(stepres, solve(subSystems[*cid], subSystemsAux[*cid], isFine));
+                else if (subSystems[*cid])
+                    stepres = worseStatus(stepres, solve(subSystems[*cid], isFine, alg));
+                else if (subSystemsAux[*cid])
+                    stepres = worseStatus(stepres, solve(subSystemsAux[*cid], isFine, alg));
+                applySolution(*cid);
+            }
+            for (int i=0; i < int(plist.size()); i++)
+                accepted[i] = getValue(plist[i]);
+        }
+
+        res = worseStatus(res, stepres);
+        solutions.insert(solutions.end(), accepted.begin(), accepted.end());
+        from = to;
+    }
+
+    setValue(param, initialValue);
+    for (int i=0; i < int(plist.size()); i++)
+        setValue(plist[i], initial[i]);
+    for (VEC_I::const_iterator cid=cids.begin(); cid != cids.end(); ++cid) {
+        syncSubSystems(*cid);
+        solvedInputs[*cid].clear();
+    }
+    return res;
+}
+
+int System::sweepStep(const VEC_I &cids, double *param, double value, bool isFine, Algorithm alg)
+{
+    // predictor: from J dx + dF/dparam dparam = 0, the least norm dx
+    double dp = value - getValue(param);
+    for (VEC_I::const_iterator cid=cids.begin(); cid != cids.end(); ++cid) {
+        SubSystem *subsys = subSystems[*cid];
+        if (!subsys || subSystemsAux[*cid]) // the temporary constraints leave no tangent
+            continue;
+
+        Eigen::MatrixXd J(subsys->cSize(), subsys->pSize());
+        Eigen::VectorXd Jp, x, dx;
+
+        subsys->redirectParams();
+        subsys->calcJacobi(J);
+        subsys->calcDerivative(location(param), Jp);
+        subsys->getParams(x);
+        dx = J.completeOrthogonalDecomposition().solve(-dp * Jp);
+        x += dx;
+        subsys->setParams(x);
+        subsys->revertParams();
+        applySolution(*cid);
+    }
+    setValue(param, value);
+
+    // corrector: a few iterations from the predicted point
+    int maxIterSaved = maxIter;
+    bool sketchSizeMultiplierSaved = sketchSizeMultiplier;
+    maxIter = maxIterCorrector;
+    sketchSizeMultiplier = false;
+
+    int res = Success;
+    for (VEC_I::const_iterator cid=cids.begin(); cid != cids.end(); ++cid) {
+        if (subSystems[*cid] && subSystemsAux[*cid])
+            res = worseStatus(res, solve(subSystems[*cid], subSystemsAux[*cid], isFine));
+        else if (subSystems[*cid])
+            res = worseStatus(res, solve(subSystems[*cid], isFine, alg));
+        else if (subSystemsAux[*cid])
+            res = worseStatus(res, solve(subSystemsAux[*cid], isFine, alg));
+        applySolution(*cid);
+    }
+
+    maxIter = maxIterSaved;
+    sketchSizeMultiplier = sketchSizeMultiplierSaved;
+    return res;
+}
+
+bool System::isCleanComponent(int cid, bool isFine, VEC_D &inputs)
+{
+    // components with temporary constraints follow moving targets
+    if (subSystemsAux[cid])
+        return false;
+
+    const VEC_pD &params = components->inputParams[cid];
+    inputs.resize(params.size());
+    for (std::size_t i=0; i < params.size(); i++)
+        inputs[i] = *location(params[i]);
+
+    // same input as the last successful solve, whose solution is still in the subsystems
+    if (inputs == solvedInputs[cid]) {
+        componentSolved[cid] = true;
+        return true;
+    }
+
+    // already at a solution, there is nothing to solve nor to apply
+    for (MAP_pD_pD::const_iterator it=components->reductionmaps[cid].begin();
+         it != components->reductionmaps[cid].end(); ++it) {
+        if (*location(it->first) != *location(it->second))
+            return false;
+    }
+    if (subSystems[cid]->error() > successError(isFine))
+        return false;
+
+    componentSolved[cid] = false;
+    solvedInputs[cid].clear();
+    return true;
+}
+
+static void hashCombine(std::size_t &seed, std::size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+std::size_t System::solutionKey(int cid, VEC_D &inputs)
+{
+    VEC_pD &params = keyParams[cid];
+    if (params.empty()) {
+        // the parameters are numbered in order of first use by the constraints, then
+        // by the unknowns, which gives the same numbers to any copy of the component
+        MAP_pD_I index;
+        auto number = [&index, &params](double *param) {
+            std::pair<MAP_pD_I::iterator,bool> it = index.insert(std::make_pair(param, int(params.size())));
+            if (it.second)
+                params.push_back(param);
+            return std::size_t(it.first->second);
+        };
+        std::size_t structure = components->clists[cid].size();
+        for (std::vector<Constraint *>::const_iterator constr=components->clists[cid].begin();
+             constr != components->clists[cid].end(); ++constr) {
+            hashCombine(structure, (*constr)->getTypeId());
+            hashCombine(structure, (*constr)->getTag() < 0);
+            const VEC_pD &cparams = (*constr)->params();
+            for (VEC_pD::const_iterator param=cparams.begin(); param != cparams.end(); ++param)
+                hashCombine(structure, number(*param));
+        }
+        for (VEC_pD::const_iterator param=components->plists[cid].begin(); param != components->plists[cid].end(); ++param) {
+            hashCombine(structure, number(*param));
+            MAP_pD_pD::const_iterator reduced = components->reductionmaps[cid].find(*param);
+            hashCombine(structure, reduced != components->reductionmaps[cid].end() ? number(reduced->second) + 1 : 0);
+        }
+        structureKeys[cid] = structure;
+    }
+
+    std::size_t key = structureKeys[cid];
+    std::hash<double> hashValue;
+    inputs.resize(params.size());
+    for (std::size_t i=0; i < params.size(); i++) {
+        inputs[i] = getValue(params[i]);
+        hashCombine(key, hashValue(inputs[i]));
+    }
+    return key;
+}
+
+bool System::restoreSolution(int cid, std::size_t key, const VEC_D &inputs, bool isFine)
+{
+    const VEC_D *solution = solutionCache.find(key, structureKeys[cid], inputs);
+    if (!solution || solution->size() != components->plists[cid].size())
+        return false;
+
+    // the solution is verified in the subsystems, where it is kept until applySolution
+    Eigen::VectorXd x = Eigen::Map<const Eigen::VectorXd>(solution->data(), solution->size());
+    SubSystem *subsys = subSystems[cid] ? subSystems[cid] : subSystemsAux[cid];
+    subsys->redirectParams();
+    subsys->setParams(components->plists[cid], x);
+    bool isSolution = subsys->error() <= successError(isFine);
+    subsys->revertParams();
+    if (isSolution && subSystems[cid] && subSystemsAux[cid])
+        subSystemsAux[cid]->setParams(components->plists[cid], x);
+    return isSolution;
+}
+
+void System::storeSolution(int cid, std::size_t key, const VEC_D &inputs)
+{
+    SubSystem *subsys = subSystems[cid] ? subSystems[cid] : subSystemsAux[cid];
+    Eigen::VectorXd x;
+    subsys->getParams(components->plists[cid], x);
+    solutionCache.store(key, structureKeys[cid], inputs, VEC_D(x.data(), x.data() + x.size()),
+                        solutionCacheSize);
+}
+
+void System::clearSolutionCache()
+{
+    solutionCache.clear();
+}
+
+bool System::isSolvedComponent(int cid, bool isFine) const
+{
+    for (MAP_pD_pD::const_iterator it=components->reductionmaps[cid].begin();
+         it != components->reductionmaps[cid].end(); ++it) {
+        if (*location(it->first) != *location(it->second))
+            return false;
+    }
+
+    // as the error of the subsystem, which is not scaled outside of the solvers
+    double err = 0.;
+    for (std::vector<Constraint *>::const_iterator constr=components->clists[cid].begin();
+         constr != components->clists[cid].end(); ++constr) {
+        if ((*constr)->getTag() < 0) // components with temporary constraints follow moving targets
+            return false;
+        double e = constraintError(*constr);
+        err += e*e;
+    }
+    return 0.5*err <= successError(isFine);
+}
+
 int System::solve(SubSystem *subsys, bool isFine, Algorithm alg, bool isRedundantsolving)
 {
+    if (analyticSolving && solveAnalytic(subsys, successError(isFine)))
+        return Success;
+
+    subsys->setThreadPool(subsys->cSize() >= rowParallelThreshold ? &threadPool() : NULL);
+
+    // the trust region of DogLeg copes with a poor scaling about as well, which
+    // would not pay for the extra jacobian, and NewtonKrylov has its own preconditioner
+    bool isScaled = autoScaling && (alg == BFGS || alg == LevenbergMarquardt) &&
+                    subsys->equilibrate();
+
+    int res;
     if (alg == BFGS)
-        return solve_BFGS(subsys, isFine, isRedundantsolving);
+        res = solve_BFGS(subsys, isFine, isRedundantsolving);
     else if (alg == LevenbergMarquardt)
-        return solve_LM(subsys, isRedundantsolving);
+        res = solve_LM(subsys, isFine, isRedundantsolving);
     else if (alg == DogLeg)
-        return solve_DL(subsys, isRedundantsolving);
+        res = solve_DL(subsys, isFine, isRedundantsolving);
+    else if (alg == NewtonKrylov)
+        res = solve_NK(subsys, isFine, isRedundantsolving);
     else
-        return Failed;
+        res = Failed;
+
+    if (isScaled)
+        subsys->clearScaling();
+    return res;
 }
 
-int System::solve_BFGS(SubSystem *subsys, bool /*isFine*/, bool isRedundantsolving)
+int System::solve_BFGS(SubSystem *subsys, bool isFine, bool isRedundantsolving)
 {
     #ifdef _GCS_EXTRACT_SOLVER_SUBSYSTEM_
     extractSubsystem(subsys, isRedundantsolving);
@@ -1597,13 +2859,21 @@ int System::solve_BFGS(SubSystem *subsys, bool /*isFine*/, bool isRedundantsolvi
 
     subsys->redirectParams();
 
-    Eigen::MatrixXd D = Eigen::MatrixXd::Identity(xsize, xsize);
-    Eigen::VectorXd x(xsize);
-    Eigen::VectorXd xdir(xsize);
-    Eigen::VectorXd grad(xsize);
-    Eigen::VectorXd h(xsize);
-    Eigen::VectorXd y(xsize);
-    Eigen::VectorXd Dy(xsize);
+    SolverWorkspace &ws = subsys->workspace;
+    Eigen::MatrixXd &D = ws.D;
+    Eigen::VectorXd &x = ws.x;
+    Eigen::VectorXd &xdir = ws.xdir;
+    Eigen::VectorXd &grad = ws.grad;
+    Eigen::VectorXd &h = ws.h;
+    Eigen::VectorXd &y = ws.y;
+    Eigen::VectorXd &Dy = ws.Dy;
+    D.setIdentity(xsize, xsize);
+    x.resize(xsize);
+    xdir.resize(xsize);
+    grad.resize(xsize);
+    h.resize(xsize);
+    y.resize(xsize);
+    Dy.resize(xsize);
 
     // Initial unknowns vector and initial gradient vector
     subsys->getParams(x);
@@ -1618,14 +2888,15 @@ int System::solve_BFGS(SubSystem *subsys, bool /*isFine*/, bool isRedundantsolvi
     subsys->getParams(x);
     h = x - h; // = x - xold
 
-    //double convergence = isFine ? convergence : XconvergenceRough;
+    double xconvergence = tolerance(isRedundantsolving?convergenceRedundant:convergence, isFine);
+    double errSuccess = successError(isFine);
     int maxIterNumber = (isRedundantsolving?
         (sketchSizeMultiplierRedundant?maxIterRedundant * xsize:maxIterRedundant):
         (sketchSizeMultiplier?maxIter * xsize:maxIter));
 
     if(debugMode==IterationLevel) {
         std::stringstream stream;
-        stream  << "BFGS: convergence: "    << (isRedundantsolving?convergenceRedundant:convergence)
+        stream  << "BFGS: convergence: "    << xconvergence
                 << ", xsize: "              << xsize
                 << ", maxIter: "            << maxIterNumber  << "\n";
 
@@ -1636,9 +2907,15 @@ int System::solve_BFGS(SubSystem *subsys, bool /*isFine*/, bool isRedundantsolvi
     double divergingLim = 1e6*err + 1e12;
     double h_norm;
 
+    // line searches do not ensure a monotone error, the best iterate is kept for interruptions
+    Eigen::VectorXd &xbest = ws.xbest;
+    xbest = x;
+    double errbest = err;
+    bool interrupted = false;
+
     for (int iter=1; iter < maxIterNumber; iter++) {
         h_norm = h.norm();
-        if (h_norm <= (isRedundantsolving?convergenceRedundant:convergence) || err <= smallF){
+        if (h_norm <= xconvergence || err <= errSuccess){
            if(debugMode==IterationLevel) {
                 std::stringstream stream;
                 stream  << "BFGS Converged!!: "
@@ -1662,6 +2939,10 @@ int System::solve_BFGS(SubSystem *subsys, bool /*isFine*/, bool isRedundantsolvi
             }
             break;
         }
+        if (isInterrupted()) {
+            interrupted = true;
+            break;
+        }
 
         y = grad;
         subsys->calcGrad(grad);
@@ -1672,15 +2953,16 @@ int System::solve_BFGS(SubSystem *subsys, bool /*isFine*/, bool isRedundantsolvi
         if (hty == 0)
             hty = .0000000001;
 
-        Dy = D * y;
+        Dy.noalias() = D * y;
 
         double ytDy = y.dot(Dy);
 
         //Now calculate the BFGS update on D
-        D += (1.+ytDy/hty)/hty * h * h.transpose();
-        D -= 1./hty * (h * Dy.transpose() + Dy * h.transpose());
+        D.noalias() += (1.+ytDy/hty)/hty * h * h.transpose();
+        D.noalias() -= 1./hty * h * Dy.transpose();
+        D.noalias() -= 1./hty * Dy * h.transpose();
 
-        xdir = -D * grad;
+        xdir.noalias() = -D * grad;
         lineSearch(subsys, xdir);
         err = subsys->error();
 
@@ -1688,6 +2970,11 @@ int System::solve_BFGS(SubSystem *subsys, bool /*isFine*/, bool isRedundantsolvi
         subsys->getParams(x);
         h = x - h; // = x - xold
 
+        if (err < errbest) {
+            errbest = err;
+            xbest = x;
+        }
+
         if(debugMode==IterationLevel) {
             std::stringstream stream;
             stream  << "BFGS, Iteration: "          << iter
@@ -1699,16 +2986,41 @@ int System::solve_BFGS(SubSystem *subsys, bool /*isFine*/, bool isRedundantsolvi
         }
     }
 
+    if (interrupted && errbest < err) {
+        subsys->setParams(xbest);
+        err = errbest;
+    }
+
     subsys->revertParams();
 
-    if (err <= smallF)
+    if (err <= errSuccess)
         return Success;
-    if (h.norm() <= (isRedundantsolving?convergenceRedundant:convergence))
+    if (interrupted)
+        return Partial;
+    if (h.norm() <= xconvergence)
         return Converged;
     return Failed;
 }
 
-int System::solve_LM(SubSystem* subsys, bool isRedundantsolving)
+int System::solve_LM(SubSystem* subsys, bool isFine, bool isRedundantsolving)
+{
+    if (subsys->cSize() <= fixedSizeMax) {
+        switch (subsys->pSize()) {
+            case 1: return solve_LM<1,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 2: return solve_LM<2,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 3: return solve_LM<3,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 4: return solve_LM<4,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 5: return solve_LM<5,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 6: return solve_LM<6,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 7: return solve_LM<7,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 8: return solve_LM<8,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+        }
+    }
+    return solve_LM<Eigen::Dynamic,Eigen::Dynamic>(subsys, isFine, isRedundantsolving);
+}
+
+template <int Cols, int MaxRows>
+int System::solve_LM(SubSystem* subsys, bool isFine, bool isRedundantsolving)
 {
 #ifdef _GCS_EXTRACT_SOLVER_SUBSYSTEM_
     extractSubsystem(subsys, isRedundantsolving);
@@ -1720,10 +3032,34 @@ int System::solve_LM(SubSystem* subsys, bool isRedundantsolving)
     if (xsize == 0)
         return Success;
 
-    Eigen::VectorXd e(csize), e_new(csize); // vector of all function errors (every constraint is one function)
-    Eigen::MatrixXd J(csize, xsize);        // Jacobi of the subsystem
-    Eigen::MatrixXd A(xsize, xsize);
-    Eigen::VectorXd x(xsize), h(xsize), x_new(xsize), g(xsize), diag_A(xsize);
+    typedef Eigen::Matrix<double, Cols, 1> VectorP;
+    typedef Eigen::Matrix<double, Eigen::Dynamic, 1, Eigen::ColMajor, MaxRows, 1> VectorC;
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Cols, Eigen::ColMajor, MaxRows, Cols> MatrixCP;
+
+    typedef Eigen::Matrix<double, Cols, Cols> MatrixPP;
+
+    SolverWorkspace &ws = subsys->workspace;
+    VectorC e_, e_new_, c_;
+    MatrixCP J_;
+    MatrixPP A_;
+    VectorP x_, h_, x_new_, g_, diag_A_, Ah_;
+    Eigen::FullPivLU<MatrixPP> lu_;
+    VectorC &e = buffer(e_, ws.fx), &e_new = buffer(e_new_, ws.fx_new); // vector of all function errors (every constraint is one function)
+    MatrixCP &J = buffer(J_, ws.J);                                      // Jacobi of the subsystem
+    MatrixPP &A = buffer(A_, ws.A);
+    VectorP &x = buffer(x_, ws.x), &h = buffer(h_, ws.h), &x_new = buffer(x_new_, ws.x_new);
+    VectorP &g = buffer(g_, ws.g), &diag_A = buffer(diag_A_, ws.diag), &Ah = buffer(Ah_, ws.Ah);
+    VectorC &c = buffer(c_, ws.c);
+    Eigen::FullPivLU<MatrixPP> &lu = buffer(lu_, ws.lu);
+    e.resize(csize);
+    e_new.resize(csize);
+    J.resize(csize, xsize);
+    A.resize(xsize, xsize);
+    x.resize(xsize);
+    h.resize(xsize);
+    x_new.resize(xsize);
+    g.resize(xsize);
+    diag_A.resize(xsize);
 
     subsys->redirectParams();
 
@@ -1737,7 +3073,7 @@ int System::solve_LM(SubSystem* subsys, bool isRedundantsolving)
 
     double divergingLim = 1e6*e.squaredNorm() + 1e12;
 
-    double eps=(isRedundantsolving?LM_epsRedundant:LM_eps);
+    double eps=tolerance(isRedundantsolving?LM_epsRedundant:LM_eps, isFine);
     double eps1=(isRedundantsolving?LM_eps1Redundant:LM_eps1);
     double tau=(isRedundantsolving?LM_tauRedundant:LM_tau);
 
@@ -1768,15 +3104,20 @@ int System::solve_LM(SubSystem* subsys, bool isRedundantsolving)
             stop = 6;
             break;
         }
+        else if (isInterrupted()) { // accepted steps reduce the error, x is the best iterate
+            stop = 8;
+            subsys->setParams(x);
+            break;
+        }
 
         // J^T J, J^T e
         subsys->calcJacobi(J);;
 
-        A = J.transpose()*J;
-        g = J.transpose()*e;
+        A.noalias() = J.transpose()*J;
+        g.noalias() = J.transpose()*e;
 
         // Compute ||J^T e||_inf
-        double g_inf = g.lpNorm<Eigen::Infinity>();
+        double g_inf = g.template lpNorm<Eigen::Infinity>();
         diag_A = A.diagonal(); // save diagonal entries so that augmentation can be later canceled
 
         // check for convergence
@@ -1787,7 +3128,7 @@ int System::solve_LM(SubSystem* subsys, bool isRedundantsolving)
 
         // compute initial damping factor
         if (iter == 0)
-            mu = tau * diag_A.lpNorm<Eigen::Infinity>();
+            mu = tau * diag_A.template lpNorm<Eigen::Infinity>();
 
         double h_norm;
         // determine increment using adaptive damping
@@ -1798,8 +3139,11 @@ int System::solve_LM(SubSystem* subsys, bool isRedundantsolving)
                 A(i,i) += mu;
 
             //solve augmented functions A*h=-g
-            h = A.fullPivLu().solve(g);
-            double rel_error = (A*h - g).norm() / g.norm();
+            lu.compute(A);
+            solveLU(lu, g, c, h);
+            Ah.noalias() = A*h;
+            Ah -= g;
+            double rel_error = Ah.norm() / g.norm();
 
             // check if solving works
             if (rel_error < 1e-5) {
@@ -1874,11 +3218,29 @@ int System::solve_LM(SubSystem* subsys, bool isRedundantsolving)
 
     subsys->revertParams();
 
-    return (stop == 1) ? Success : Failed;
+    return (stop == 1) ? Success : (stop == 8) ? Partial : Failed;
 }
 
 
-int System::solve_DL(SubSystem* subsys, bool isRedundantsolving)
+int System::solve_DL(SubSystem* subsys, bool isFine, bool isRedundantsolving)
+{
+    if (subsys->cSize() <= fixedSizeMax) {
+        switch (subsys->pSize()) {
+            case 1: return solve_DL<1,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 2: return solve_DL<2,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 3: return solve_DL<3,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 4: return solve_DL<4,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 5: return solve_DL<5,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 6: return solve_DL<6,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 7: return solve_DL<7,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+            case 8: return solve_DL<8,fixedSizeMax>(subsys, isFine, isRedundantsolving);
+        }
+    }
+    return solve_DL<Eigen::Dynamic,Eigen::Dynamic>(subsys, isFine, isRedundantsolving);
+}
+
+template <int Cols, int MaxRows>
+int System::solve_DL(SubSystem* subsys, bool isFine, bool isRedundantsolving)
 {
 #ifdef _GCS_EXTRACT_SOLVER_SUBSYSTEM_
     extractSubsystem(subsys, isRedundantsolving);
@@ -1886,7 +3248,7 @@ int System::solve_DL(SubSystem* subsys, bool isRedundantsolving)
 
     double tolg=(isRedundantsolving?DL_tolgRedundant:DL_tolg);
     double tolx=(isRedundantsolving?DL_tolxRedundant:DL_tolx);
-    double tolf=(isRedundantsolving?DL_tolfRedundant:DL_tolf);
+    double tolf=tolerance(isRedundantsolving?DL_tolfRedundant:DL_tolf, isFine);
 
     int xsize = subsys->pSize();
     int csize = subsys->cSize();
@@ -1913,10 +3275,40 @@ int System::solve_DL(SubSystem* subsys, bool isRedundantsolving)
         //.Log(tmp.c_str());
     }
 
-    Eigen::VectorXd x(xsize), x_new(xsize);
-    Eigen::VectorXd fx(csize), fx_new(csize);
-    Eigen::MatrixXd Jx(csize, xsize), Jx_new(csize, xsize);
-    Eigen::VectorXd g(xsize), h_sd(xsize), h_gn(xsize), h_dl(xsize);
+    typedef Eigen::Matrix<double, Cols, 1> VectorP;
+    typedef Eigen::Matrix<double, Eigen::Dynamic, 1, Eigen::ColMajor, MaxRows, 1> VectorC;
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Cols, Eigen::ColMajor, MaxRows, Cols> MatrixCP;
+
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor, MaxRows, MaxRows> MatrixCC;
+
+    SolverWorkspace &ws = subsys->workspace;
+    VectorP x_, x_new_, g_, h_sd_, h_gn_, h_dl_, b_;
+    VectorC fx_, fx_new_, Jh_, c_;
+    MatrixCP Jx_, Jx_new_;
+    MatrixCC JJt_;
+    Eigen::FullPivLU<MatrixCP> lu_;
+    Eigen::FullPivLU<MatrixCC> luJJt_;
+    Eigen::LDLT<MatrixCC> ldlt_;
+    VectorP &x = buffer(x_, ws.x), &x_new = buffer(x_new_, ws.x_new);
+    VectorC &fx = buffer(fx_, ws.fx), &fx_new = buffer(fx_new_, ws.fx_new);
+    MatrixCP &Jx = buffer(Jx_, ws.J), &Jx_new = buffer(Jx_new_, ws.J_new);
+    VectorP &g = buffer(g_, ws.g), &h_sd = buffer(h_sd_, ws.h_sd);
+    VectorP &h_gn = buffer(h_gn_, ws.h_gn), &h_dl = buffer(h_dl_, ws.h_dl), &b = buffer(b_, ws.b);
+    VectorC &Jh = buffer(Jh_, ws.Jh), &c = buffer(c_, ws.c);
+    MatrixCC &JJt = buffer(JJt_, ws.JJt);
+    Eigen::FullPivLU<MatrixCP> &lu = buffer(lu_, ws.lu);
+    Eigen::FullPivLU<MatrixCC> &luJJt = buffer(luJJt_, ws.luJJt);
+    Eigen::LDLT<MatrixCC> &ldlt = buffer(ldlt_, ws.ldlt);
+    x.resize(xsize);
+    x_new.resize(xsize);
+    fx.resize(csize);
+    fx_new.resize(csize);
+    Jx.resize(csize, xsize);
+    Jx_new.resize(csize, xsize);
+    g.resize(xsize);
+    h_sd.resize(xsize);
+    h_gn.resize(xsize);
+    h_dl.resize(xsize);
 
     subsys->redirectParams();
 
@@ -1925,11 +3317,11 @@ int System::solve_DL(SubSystem* subsys, bool isRedundantsolving)
     subsys->calcResidual(fx, err);
     subsys->calcJacobi(Jx);
 
-    g = Jx.transpose()*(-fx);
+    g.noalias() = -Jx.transpose()*fx;
 
     // get the infinity norm fx_inf and g_inf
-    double g_inf = g.lpNorm<Eigen::Infinity>();
-    double fx_inf = fx.lpNorm<Eigen::Infinity>();
+    double g_inf = g.template lpNorm<Eigen::Infinity>();
+    double fx_inf = fx.template lpNorm<Eigen::Infinity>();
 
     double divergingLim = 1e6*err + 1e12;
 
@@ -1951,9 +3343,14 @@ int System::solve_DL(SubSystem* subsys, bool isRedundantsolving)
         else if (err > divergingLim || err != err) { // check for diverging and NaN
             stop = 6;
         }
+        else if (isInterrupted()) { // accepted steps reduce the error, x is the best iterate
+            stop = 7;
+            subsys->setParams(x);
+        }
         else {
             // get the steepest descent direction
-            alpha = g.squaredNorm()/(Jx*g).squaredNorm();
+            Jh.noalias() = Jx*g;
+            alpha = g.squaredNorm()/Jh.squaredNorm();
             h_sd  = alpha*g;
 
             // get the gauss-newton step
@@ -1961,17 +3358,30 @@ int System::solve_DL(SubSystem* subsys, bool isRedundantsolving)
             // https://forum.kde.org/viewtopic.php?f=74&t=129439#p346104
             switch (dogLegGaussStep){
                 case FullPivLU:
-                    h_gn = Jx.fullPivLu().solve(-fx);
+                    // h_gn = Jx.fullPivLu().solve(-fx)
+                    lu.compute(Jx);
+                    solveLU(lu, fx, c, h_gn);
+                    h_gn = -h_gn;
                     break;
                 case LeastNormFullPivLU:
-                    h_gn = Jx.adjoint()*(Jx*Jx.adjoint()).fullPivLu().solve(-fx);
+                    // h_gn = Jx.adjoint()*(Jx*Jx.adjoint()).fullPivLu().solve(-fx)
+                    JJt.noalias() = Jx*Jx.adjoint();
+                    luJJt.compute(JJt);
+                    solveLU(luJJt, fx, c, Jh);
+                    h_gn.noalias() = -Jx.adjoint()*Jh;
                     break;
                 case LeastNormLdlt:
-                    h_gn = Jx.adjoint()*(Jx*Jx.adjoint()).ldlt().solve(-fx);
+                    // h_gn = Jx.adjoint()*(Jx*Jx.adjoint()).ldlt().solve(-fx)
+                    JJt.noalias() = Jx*Jx.adjoint();
+                    ldlt.compute(JJt);
+                    Jh = ldlt.solve(fx);
+                    h_gn.noalias() = -Jx.adjoint()*Jh;
                     break;
             }
 
-            double rel_error = (Jx*h_gn + fx).norm() / fx.norm();
+            Jh.noalias() = Jx*h_gn;
+            Jh += fx;
+            double rel_error = Jh.norm() / fx.norm();
             if (rel_error > 1e15)
                 break;
 
@@ -1989,7 +3399,7 @@ int System::solve_DL(SubSystem* subsys, bool isRedundantsolving)
             else {
                 //compute beta
                 double beta = 0;
-                Eigen::VectorXd b = h_gn - h_sd;
+                b = h_gn - h_sd;
                 double bb = (b.transpose()*b).norm();
                 double gb = (h_sd.transpose()*b).norm();
                 double c = (delta + h_sd.norm())*(delta - h_sd.norm());
@@ -2022,7 +3432,9 @@ int System::solve_DL(SubSystem* subsys, bool isRedundantsolving)
         subsys->calcJacobi(Jx_new);
 
         // calculate the linear model and the update ratio
-        double dL = err - 0.5*(fx + Jx*h_dl).squaredNorm();
+        Jh.noalias() = Jx*h_dl;
+        Jh += fx;
+        double dL = err - 0.5*Jh.squaredNorm();
         double dF = err - err_new;
         double rho = dL/dF;
 
@@ -2032,11 +3444,11 @@ int System::solve_DL(SubSystem* subsys, bool isRedundantsolving)
             fx = fx_new;
             err = err_new;
 
-            g = Jx.transpose()*(-fx);
+            g.noalias() = -Jx.transpose()*fx;
 
             // get infinity norms
-            g_inf = g.lpNorm<Eigen::Infinity>();
-            fx_inf = fx.lpNorm<Eigen::Infinity>();
+            g_inf = g.template lpNorm<Eigen::Infinity>();
+            fx_inf = fx.template lpNorm<Eigen::Infinity>();
         }
         else
             rho = -1;
@@ -2082,7 +3494,215 @@ int System::solve_DL(SubSystem* subsys, bool isRedundantsolving)
         //.Log(tmp.c_str());
     }
 
-    return (stop == 1) ? Success : Failed;
+    return (stop == 1) ? Success : (stop == 7) ? Partial : Failed;
+}
+
+// tau >= 0 such that h + tau*d lies on the boundary ||.||_M = delta, h being inside,
+// from the products hMh = h^T M h, hMd = h^T M d and dMd = d^T M d
+static double toBoundary(double hMh, double hMd, double dMd, double delta)
+{
+    if (dMd <= 0.)
+        return 0.;
+    double disc = hMd*hMd + dMd*(delta*delta - hMh);
+    return (-hMd + sqrt(std::max(disc, 0.)))/dMd;
+}
+
+// Trust region Gauss-Newton, the steps are found by Steihaug's conjugate gradients
+// on J^T J h = -J^T fx. J is only used through products evaluated constraint by
+// constraint, and so is the default block-Jacobi preconditioner, so that the memory
+// stays linear in the size of the subsystem. Only the optional incomplete Cholesky
+// preconditioner assembles J and J^T J (sparse, but the latter may fill in).
+int System::solve_NK(SubSystem* subsys, bool isFine, bool isRedundantsolving)
+{
+#ifdef _GCS_EXTRACT_SOLVER_SUBSYSTEM_
+    extractSubsystem(subsys, isRedundantsolving);
+#endif
+
+    double tolg=(isRedundantsolving?DL_tolgRedundant:DL_tolg);
+    double tolx=(isRedundantsolving?DL_tolxRedundant:DL_tolx);
+    double tolf=tolerance(isRedundantsolving?DL_tolfRedundant:DL_tolf, isFine);
+
+    int xsize = subsys->pSize();
+    int csize = subsys->cSize();
+
+    if (xsize == 0)
+        return Success;
+
+    int maxIterNumber = (isRedundantsolving?
+        (sketchSizeMultiplierRedundant?maxIterRedundant * xsize:maxIterRedundant):
+        (sketchSizeMultiplier?maxIter * xsize:maxIter));
+    int maxIterCG = std::min(NK_maxIterCG, 2*xsize);
+
+    if(debugMode==IterationLevel) {
+        std::stringstream stream;
+        stream  << "NK: tolg: "         << tolg
+                << ", tolx: "           << tolx
+                << ", tolf: "           << tolf
+                << ", xsize: "          << xsize
+                << ", csize: "          << csize
+                << ", maxIter: "        << maxIterNumber
+                << ", maxIterCG: "      << maxIterCG  << "\n";
+
+        const std::string tmp = stream.str();
+        //.Log(tmp.c_str());
+    }
+
+    SolverWorkspace &ws = subsys->workspace;
+    Eigen::VectorXd &x = ws.x, &x_new = ws.x_new;
+    Eigen::VectorXd &fx = ws.fx, &fx_new = ws.fx_new;
+    Eigen::VectorXd &g = ws.g, &h = ws.h;
+    Eigen::VectorXd &r = ws.r, &s = ws.s, &z = ws.z, &d = ws.d, &Jd = ws.Jd;
+    x.resize(xsize);
+    fx.resize(csize);
+    fx_new.resize(csize);
+    g.resize(xsize);
+
+    subsys->redirectParams();
+
+    double err;
+    subsys->getParams(x);
+    subsys->calcResidual(fx, err);
+    subsys->calcGrad(g); // J^T fx
+
+    double divergingLim = 1e6*err + 1e12;
+
+    // M = L L^T, factored once at the start so that the trust region keeps its norm
+    bool preconditioned = false;
+    if (NK_preconditioner == BlockJacobiPreconditioner) {
+        subsys->factorBlockJacobi();
+        preconditioned = true;
+    }
+    else if (NK_preconditioner == IncompleteCholeskyPreconditioner) {
+        subsys->calcJacobi(ws.Js);
+        ws.JtJ = ws.Js.transpose()*ws.Js;
+        ws.ic.compute(ws.JtJ);
+        preconditioned = (ws.ic.info() == Eigen::Success);
+    }
+    auto precondition = [this, subsys, &ws, preconditioned](const Eigen::VectorXd &v, Eigen::VectorXd &Mv) {
+        if (!preconditioned)
+            Mv = v;
+        else if (NK_preconditioner == BlockJacobiPreconditioner)
+            subsys->solveBlockJacobi(v, Mv);
+        else
+            Mv = ws.ic.solve(v);
+    };
+
+    // the trust region is measured in the norm of the preconditioner M, where
+    // ||h||_M ~ ||J h||, a full Gauss-Newton step has about the length ||fx||;
+    // without one it is measured in the 2-norm of the unknowns
+    double delta = preconditioned ? fx.norm() : 0.1;
+    int iter=0, stop=0;
+    while (!stop) {
+
+        // check if finished
+        double fx_inf = fx.lpNorm<Eigen::Infinity>();
+        double g_inf = g.lpNorm<Eigen::Infinity>();
+        if (fx_inf <= tolf) // Success
+            stop = 1;
+        else if (g_inf <= tolg)
+            stop = 2;
+        else if (delta <= tolx*(tolx + x.norm()))
+            stop = 2;
+        else if (iter >= maxIterNumber)
+            stop = 4;
+        else if (err > divergingLim || err != err) // check for diverging and NaN
+            stop = 6;
+        else if (isInterrupted()) { // accepted steps reduce the error, x is the best iterate
+            stop = 7;
+            subsys->setParams(x);
+        }
+        if (stop)
+            break;
+
+        // Steihaug: conjugate gradients from h = 0, stopped at the trust region boundary,
+        // on a direction of non-positive curvature or once the residual meets the forcing term.
+        // They are written in the CGLS form: the residual -fx - J h is updated rather than
+        // the one of the normal equations, which is far less sensitive to rounding errors
+        h.setZero(xsize);
+        r = -fx;
+        s = -g; // J^T r
+        precondition(s, z);
+        d = z;
+        double gamma = s.dot(z);
+        double hMh = 0., hMd = 0., dMd = gamma;
+        double g_norm = g.norm();
+        double cgtol = std::min(0.5, sqrt(g_norm))*g_norm;
+        for (int k=0; k < maxIterCG; k++) {
+            subsys->multJacobi(d, Jd);
+            double dHd = Jd.squaredNorm();
+            if (dHd <= 0.) {
+                h += toBoundary(hMh, hMd, dMd, delta)*d;
+                hMh = delta*delta;
+                break;
+            }
+            double alpha = gamma/dHd;
+            double hMh_next = hMh + 2*alpha*hMd + alpha*alpha*dMd;
+            if (hMh_next >= delta*delta) {
+                h += toBoundary(hMh, hMd, dMd, delta)*d;
+                hMh = delta*delta;
+                break;
+            }
+            h += alpha*d;
+            hMh = hMh_next;
+            r -= alpha*Jd;
+            subsys->multJacobiTransposed(r, s);
+            if (s.norm() <= cgtol)
+                break;
+            precondition(s, z);
+            double gamma_new = s.dot(z);
+            double beta = gamma_new/gamma;
+            hMd = beta*(hMd + alpha*dMd);
+            dMd = gamma_new + beta*beta*dMd;
+            d = z + beta*d;
+            gamma = gamma_new;
+        }
+
+        // calculate the linear model and the update ratio
+        subsys->multJacobi(h, Jd);
+        double dL = -(g.dot(h) + 0.5*Jd.squaredNorm());
+
+        x_new = x + h;
+        subsys->setParams(x_new);
+        double err_new;
+        subsys->calcResidual(fx_new, err_new);
+        double dF = err - err_new;
+
+        double rho = -1.;
+        if (dF > 0. && dL > 0.) {
+            rho = dF/dL;
+            x = x_new;
+            fx = fx_new;
+            err = err_new;
+            subsys->calcGrad(g);
+        }
+        else
+            subsys->setParams(x);
+
+        // update delta
+        double h_norm = sqrt(hMh);
+        if (rho < 0.25)
+            delta = 0.25*h_norm;
+        else if (rho > 0.75 && h_norm > 0.99*delta)
+            delta = 2*delta;
+
+        if(debugMode==IterationLevel) {
+            std::stringstream stream;
+            stream  << "NK, Iteration: "        << iter
+                    << ", fx_inf(tolf): "       << fx_inf
+                    << ", g_inf(tolg): "        << g_inf
+                    << ", delta(f(tolx)): "     << delta
+                    << ", err(divergingLim): "  << err  << "\n";
+
+            const std::string tmp = stream.str();
+            //.Log(tmp.c_str());
+        }
+
+        iter++;
+    }
+
+    subsys->revertParams();
+
+    return (stop == 1) ? Success : (stop == 7) ? Partial : Failed;
 }
 
 #ifdef _GCS_EXTRACT_SOLVER_SUBSYSTEM_
@@ -2316,7 +3936,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb3?("clist_params_["):("plist_[")) << (npb3?ni3:i3) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb4?("clist_params_["):("plist_[")) << (npb4?ni4:i4) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb5?("clist_params_["):("plist_[")) << (npb5?ni5:i5) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << std::endl;
                 break;
@@ -2410,7 +4030,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb3?("clist_params_["):("plist_[")) << (npb3?ni3:i3) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb4?("clist_params_["):("plist_[")) << (npb4?ni4:i4) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb5?("clist_params_["):("plist_[")) << (npb5?ni5:i5) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << std::endl;
                 break;
@@ -2538,7 +4158,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb5?("clist_params_["):("plist_[")) << (npb5?ni5:i5) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb6?("clist_params_["):("plist_[")) << (npb6?ni6:i6) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb7?("clist_params_["):("plist_[")) << (npb7?ni7:i7) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << "," << (*it)->pvec[5] << "," << (*it)->pvec[6] << std::endl;
                 break;
@@ -2649,7 +4269,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb4?("clist_params_["):("plist_[")) << (npb4?ni4:i4) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb5?("clist_params_["):("plist_[")) << (npb5?ni5:i5) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb6?("clist_params_["):("plist_[")) << (npb6?ni6:i6) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << "," << (*it)->pvec[5] << std::endl;
                 break;
@@ -2760,7 +4380,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb4?("clist_params_["):("plist_[")) << (npb4?ni4:i4) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb5?("clist_params_["):("plist_[")) << (npb5?ni5:i5) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb6?("clist_params_["):("plist_[")) << (npb6?ni6:i6) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << "," << (*it)->pvec[5] << std::endl;
                 break;
@@ -2905,7 +4525,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb6?("clist_params_["):("plist_[")) << (npb6?ni6:i6) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb7?("clist_params_["):("plist_[")) << (npb7?ni7:i7) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb8?("clist_params_["):("plist_[")) << (npb8?ni8:i8) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << "," << (*it)->pvec[5] << "," << (*it)->pvec[6] << "," << (*it)->pvec[7] << std::endl;
                 break;
@@ -3050,7 +4670,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb6?("clist_params_["):("plist_[")) << (npb6?ni6:i6) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb7?("clist_params_["):("plist_[")) << (npb7?ni7:i7) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb8?("clist_params_["):("plist_[")) << (npb8?ni8:i8) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << "," << (*it)->pvec[5] << "," << (*it)->pvec[6] << "," << (*it)->pvec[7] << std::endl;
                 break;
@@ -3212,7 +4832,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb7?("clist_params_["):("plist_[")) << (npb7?ni7:i7) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb8?("clist_params_["):("plist_[")) << (npb8?ni8:i8) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb9?("clist_params_["):("plist_[")) << (npb9?ni9:i9) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << "," << (*it)->pvec[5] << "," << (*it)->pvec[6] << "," << (*it)->pvec[7] << "," << (*it)->pvec[8] << std::endl;
                 break;
@@ -3357,7 +4977,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb6?("clist_params_["):("plist_[")) << (npb6?ni6:i6) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb7?("clist_params_["):("plist_[")) << (npb7?ni7:i7) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb8?("clist_params_["):("plist_[")) << (npb8?ni8:i8) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << "," << (*it)->pvec[5] << "," << (*it)->pvec[6] << "," << (*it)->pvec[7] << std::endl;
                 break;
@@ -3468,7 +5088,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb4?("clist_params_["):("plist_[")) << (npb4?ni4:i4) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb5?("clist_params_["):("plist_[")) << (npb5?ni5:i5) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb6?("clist_params_["):("plist_[")) << (npb6?ni6:i6) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << "," << (*it)->pvec[5] << std::endl;
                 break;
@@ -3596,7 +5216,7 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb5?("clist_params_["):("plist_[")) << (npb5?ni5:i5) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb6?("clist_params_["):("plist_[")) << (npb6?ni6:i6) <<"]);" << std::endl;
                 subsystemfile << "c" << ic << "->pvec.push_back(" << (npb7?("clist_params_["):("plist_[")) << (npb7?ni7:i7) <<"]);" << std::endl;
-                subsystemfile << "c" << ic << "->origpvec=c" << ic << "->pvec;" << std::endl;
+                subsystemfile << "c" << ic << "->bindOwn();" << std::endl;
                 subsystemfile << "c" << ic << "->rescale();" << std::endl;
                 subsystemfile << "clist_.push_back(c" << ic << "); // addresses = "<< (*it)->pvec[0] << "," << (*it)->pvec[1] << "," << (*it)->pvec[2] << "," << (*it)->pvec[3] << "," << (*it)->pvec[4] << "," << (*it)->pvec[5] << "," << (*it)->pvec[6] << std::endl;
                 break;
@@ -3617,14 +5237,19 @@ void System::extractSubsystem(SubSystem *subsys, bool isRedundantsolving)
 
 // The following solver variant solves a system compound of two subsystems
 // treating the first of them as of higher priority than the second
-int System::solve(SubSystem *subsysA, SubSystem *subsysB, bool /*isFine*/, bool isRedundantsolving)
+int System::solve(SubSystem *subsysA, SubSystem *subsysB, bool isFine, bool isRedundantsolving)
 {
     int xsizeA = subsysA->pSize();
     int xsizeB = subsysB->pSize();
     int csizeA = subsysA->cSize();
 
-    VEC_pD plistAB(xsizeA+xsizeB);
-    {
+    subsysA->setThreadPool(csizeA >= rowParallelThreshold ? &threadPool() : NULL);
+    subsysB->setThreadPool(subsysB->cSize() >= rowParallelThreshold ? &threadPool() : NULL);
+
+    // the buffers are those of subsysA, which is always solved together with subsysB
+    SolverWorkspace &ws = subsysA->workspace;
+    VEC_pD &plistAB = ws.plistAB;
+    if (plistAB.empty()) {
         VEC_pD plistA, plistB;
         subsysA->getParamList(plistA);
         subsysB->getParamList(plistB);
@@ -3632,6 +5257,7 @@ int System::solve(SubSystem *subsysA, SubSystem *subsysB, bool /*isFine*/, bool
         std::sort(plistA.begin(),plistA.end());
         std::sort(plistB.begin(),plistB.end());
 
+        plistAB.resize(xsizeA+xsizeB);
         VEC_pD::const_iterator it;
         it = std::set_union(plistA.begin(),plistA.end(),
                             plistB.begin(),plistB.end(),plistAB.begin());
@@ -3639,17 +5265,31 @@ int System::solve(SubSystem *subsysA, SubSystem *subsysB, bool /*isFine*/, bool
     }
     int xsize = plistAB.size();
 
-    Eigen::MatrixXd B = Eigen::MatrixXd::Identity(xsize, xsize);
-    Eigen::MatrixXd JA(csizeA, xsize);
-    Eigen::MatrixXd Y,Z;
-
-    Eigen::VectorXd resA(csizeA);
-    Eigen::VectorXd lambda(csizeA), lambda0(csizeA), lambdadir(csizeA);
-    Eigen::VectorXd x(xsize), x0(xsize), xdir(xsize), xdir1(xsize);
-    Eigen::VectorXd grad(xsize);
-    Eigen::VectorXd h(xsize);
-    Eigen::VectorXd y(xsize);
-    Eigen::VectorXd Bh(xsize);
+    Eigen::MatrixXd &B = ws.B;
+    Eigen::MatrixXd &JA = ws.J;
+    Eigen::MatrixXd &Y = ws.Y, &Z = ws.Z;
+    B.setIdentity(xsize, xsize);
+    JA.resize(csizeA, xsize);
+
+    Eigen::VectorXd &resA = ws.resA;
+    Eigen::VectorXd &lambda = ws.lambda, &lambda0 = ws.lambda0, &lambdadir = ws.lambdadir;
+    Eigen::VectorXd &x = ws.x, &x0 = ws.x0, &xdir = ws.xdir, &xdir1 = ws.xdir1;
+    Eigen::VectorXd &grad = ws.grad;
+    Eigen::VectorXd &h = ws.h;
+    Eigen::VectorXd &y = ws.y;
+    Eigen::VectorXd &Bh = ws.Bh;
+    resA.resize(csizeA);
+    lambda.resize(csizeA);
+    lambda0.resize(csizeA);
+    lambdadir.resize(csizeA);
+    x.resize(xsize);
+    x0.resize(xsize);
+    xdir.resize(xsize);
+    xdir1.resize(xsize);
+    grad.resize(xsize);
+    h.resize(xsize);
+    y.resize(xsize);
+    Bh.resize(xsize);
 
     // We assume that there are no common constraints in subsysA and subsysB
     subsysA->redirectParams();
@@ -3663,23 +5303,40 @@ int System::solve(SubSystem *subsysA, SubSystem *subsysB, bool /*isFine*/, bool
     subsysA->calcJacobi(plistAB,JA);
     subsysA->calcResidual(resA);
 
-    //double convergence = isFine ? XconvergenceFine : XconvergenceRough;
+    double xconvergence = tolerance(isRedundantsolving?convergenceRedundant:convergence, isFine);
+    double errSuccess = successError(isFine);
     int maxIterNumber = (isRedundantsolving?
         (sketchSizeMultiplierRedundant?maxIterRedundant * xsize:maxIterRedundant):
         (sketchSizeMultiplier?maxIter * xsize:maxIter));
 
     double divergingLim = 1e6*subsysA->error() + 1e12;
 
+    // the merit function mixes both subsystems, the best iterate for interruptions
+    // is the one closest to satisfy the constraints of subsysA
+    Eigen::VectorXd &xbest = ws.xbest;
+    xbest = x;
+    double errbest = subsysA->error();
+    bool interrupted = false;
+
     double mu = 0;
     lambda.setZero();
+    h.setZero();
     for (int iter=1; iter < maxIterNumber; iter++) {
-        int status = qp_eq(B, grad, JA, resA, xdir, Y, Z);
+        if (isInterrupted()) {
+            interrupted = true;
+            break;
+        }
+
+        int status = qp_eq(B, grad, JA, resA, xdir, Y, Z, ws.qp);
         if (status)
             break;
 
         x0 = x;
         lambda0 = lambda;
-        lambda = Y.transpose() * (B * xdir + grad);
+        Bh.noalias() = B * xdir;
+        double xdirBxdir = xdir.dot(Bh);
+        Bh += grad;
+        lambda.noalias() = Y.transpose() * Bh;
         lambdadir = lambda - lambda0;
 
         // line search
@@ -3696,7 +5353,7 @@ int System::solve(SubSystem *subsysA, SubSystem *subsysB, bool /*isFine*/, bool
             // double mu =  grad.dot(xdir) / ( (1.-rho) * resA.lpNorm<1>());
             // Eq. 18.36
             mu =  std::max(mu,
-                           (grad.dot(xdir) +  std::max(0., 0.5*xdir.dot(B*xdir))) /
+                           (grad.dot(xdir) +  std::max(0., 0.5*xdirBxdir)) /
                            ( (1. - rho) * resA.lpNorm<1>() ) );
 
             // Eq. 18.27
@@ -3717,7 +5374,7 @@ int System::solve(SubSystem *subsysA, SubSystem *subsysB, bool /*isFine*/, bool
                 if (first) { // try a second order step
 //                    xdir1 = JA.jacobiSvd(Eigen::ComputeThinU |
 //                                         Eigen::ComputeThinV).solve(-resA);
-                    xdir1 = -Y*resA;
+                    xdir1.noalias() = -Y*resA;
                     x += xdir1; // = x0 + alpha * xdir + xdir1
                     subsysA->setParams(plistAB,x);
                     subsysB->setParams(plistAB,x);
@@ -3742,35 +5399,48 @@ int System::solve(SubSystem *subsysA, SubSystem *subsysB, bool /*isFine*/, bool
         }
         h = x - x0;
 
-        y = grad - JA.transpose() * lambda;
+        y = grad;
+        y.noalias() -= JA.transpose() * lambda;
         {
             subsysB->calcGrad(plistAB,grad);
             subsysA->calcJacobi(plistAB,JA);
             subsysA->calcResidual(resA);
         }
-        y = grad - JA.transpose() * lambda - y; // Eq. 18.13
+        y = grad - y;
+        y.noalias() -= JA.transpose() * lambda; // Eq. 18.13
 
         if (iter > 1) {
             double yTh = y.dot(h);
             if (yTh != 0) {
-                Bh = B * h;
+                Bh.noalias() = B * h;
                 //Now calculate the BFGS update on B
-                B += 1./yTh * y * y.transpose();
-                B -= 1./h.dot(Bh) * (Bh * Bh.transpose());
+                B.noalias() += 1./yTh * y * y.transpose();
+                B.noalias() -= 1./h.dot(Bh) * Bh * Bh.transpose();
             }
         }
 
         double err = subsysA->error();
-        if (h.norm() <= (isRedundantsolving?convergenceRedundant:convergence) && err <= smallF)
+        if (err < errbest) {
+            errbest = err;
+            xbest = x;
+        }
+        if (h.norm() <= xconvergence && err <= errSuccess)
             break;
         if (err > divergingLim || err != err) // check for diverging and NaN
             break;
     }
 
+    if (interrupted && errbest < subsysA->error()) {
+        subsysA->setParams(plistAB,xbest);
+        subsysB->setParams(plistAB,xbest);
+    }
+
     int ret;
-    if (subsysA->error() <= smallF)
+    if (subsysA->error() <= errSuccess)
         ret = Success;
-    else if (h.norm() <= (isRedundantsolving?convergenceRedundant:convergence))
+    else if (interrupted)
+        ret = Partial;
+    else if (h.norm() <= xconvergence)
         ret = Converged;
     else
         ret = Failed;
@@ -3784,14 +5454,110 @@ int System::solve(SubSystem *subsysA, SubSystem *subsysB, bool /*isFine*/, bool
 void System::applySolution()
 {
     for (int cid=0; cid < int(subSystems.size()); cid++) {
-        if (subSystemsAux[cid])
-            subSystemsAux[cid]->applySolution();
+        if (componentSolved[cid])
+            applySolution(cid);
+    }
+}
+
+void System::applySolution(int cid)
+{
+    if (subSystemsAux[cid])
+        subSystemsAux[cid]->applySolution();
+    if (subSystems[cid])
+        subSystems[cid]->applySolution();
+    for (MAP_pD_pD::const_iterator it=components->reductionmaps[cid].begin();
+         it != components->reductionmaps[cid].end(); ++it)
+        setValue(it->first, *location(it->second));
+}
+
+int System::initDrag(const VEC_pD &params, Algorithm alg, bool rediagnose)
+{
+    finishDrag();
+    dragAlgorithm = alg;
+
+    // the constraints keep pointers to the targets, which must not move afterwards
+    dragTargets.resize(params.size());
+    for (std::size_t i=0; i < params.size(); i++)
+        dragTargets[i] = getValue(params[i]);
+    for (std::size_t i=0; i < params.size(); i++) {
+        Constraint *constr = new ConstraintEqual(params[i], &dragTargets[i]);
+        constr->setTag(DefaultTemporaryConstraint);
+        addConstraint(constr);
+        dragConstraints.push_back(constr);
+    }
+
+    bool skipDiagnosis = !rediagnose && !hasDiagnosis;
+    if (skipDiagnosis) {
+        redundant.clear();
+        hasDiagnosis = true;
+    }
+    initSolution(alg);
+    if (skipDiagnosis)
+        hasDiagnosis = false;
+
+    return isInit ? Success : Failed;
+}
+
+int System::updateDrag(const VEC_D &targets, bool isFine)
+{
+    if (!isInit || targets.size() != dragTargets.size())
+        return Failed;
+
+    std::copy(targets.begin(), targets.end(), dragTargets.begin());
+
+    // the other components do not depend on the targets and are already solved
+    int res = Success;
+    for (int cid=0; cid < int(subSystems.size()); cid++) {
+        if (!subSystemsAux[cid])
+            continue;
+
+        std::size_t key = 0;
+        VEC_D keyInputs;
+        if (solutionCacheSize > 0) {
+            key = solutionKey(cid, keyInputs);
+            if (restoreSolution(cid, key, keyInputs, isFine))
+                continue;
+        }
+
+        int cres;
         if (subSystems[cid])
-            subSystems[cid]->applySolution();
-        for (MAP_pD_pD::const_iterator it=reductionmaps[cid].begin();
-             it != reductionmaps[cid].end(); ++it)
-            *(it->first) = *(it->second);
+            cres = solve(subSystems[cid], subSystemsAux[cid], isFine);
+        else
+            cres = solve(subSystemsAux[cid], isFine, dragAlgorithm);
+        res = worseStatus(res, cres);
+        if (cres == Success && isFine && solutionCacheSize > 0)
+            storeSolution(cid, key, keyInputs);
     }
+
+    if (res == Success) {
+        for (int cid=0; cid < int(subSystems.size()); cid++) {
+            if (subSystemsAux[cid])
+                applySolution(cid);
+        }
+        for (std::set<Constraint *>::const_iterator constr=redundant.begin();
+             constr != redundant.end(); ++constr) {
+            double err = constraintError(*constr);
+            if (err*err > tolerance(convergence, isFine)) {
+                res = Converged;
+                break;
+            }
+        }
+    }
+
+    // the next update starts from the last successful one
+    if (res == Success)
+        setReference();
+    else
+        resetToReference();
+    return res;
+}
+
+void System::finishDrag()
+{
+    if (!dragConstraints.empty())
+        removeConstraints(dragConstraints);
+    dragConstraints.clear();
+    dragTargets.clear();
 }
 
 void System::undoSolution()
@@ -3814,17 +5580,18 @@ void System::makeReducedJacobian(Eigen::MatrixXd &J,
     }
 
 
-    J = Eigen::MatrixXd::Zero(clist.size(), pdiagnoselist.size());
+    J = Eigen::MatrixXd::Zero(cgraph->clist.size(), pdiagnoselist.size());
 
     int jacobianconstraintcount=0;
     int allcount=0;
-    for (std::vector<Constraint *>::iterator constr=clist.begin(); constr != clist.end(); ++constr) {
-        (*constr)->revertParams();
+    ParamView view;
+    for (std::vector<Constraint *>::const_iterator constr=cgraph->clist.begin(); constr != cgraph->clist.end(); ++constr) {
         ++allcount;
         if ((*constr)->getTag() >= 0 && (*constr)->isDriving()) {
             jacobianconstraintcount++;
+            const ParamView &v = valuesView(*constr, view);
             for (int j=0; j < int(pdiagnoselist.size()); j++) {
-                J(jacobianconstraintcount-1,j) = (*constr)->grad(pdiagnoselist[j]);
+                J(jacobianconstraintcount-1,j) = (*constr)->grad(v, location(pdiagnoselist[j]));
             }
 
             // parallel processing: create tag multiplicity map
@@ -3841,6 +5608,179 @@ void System::makeReducedJacobian(Eigen::MatrixXd &J,
         J.resize(0,0);
 }
 
+void System::makeDiagnoseLists(GCS::VEC_pD &pdiagnoselist,
+                               VEC_I &cdiagnoselist,
+                               std::map< int , int> &tagmultiplicity)
+{
+    // same lists as in makeReducedJacobian, cdiagnoselist holds the index in clist
+    // of the driving constraints taken into account by the diagnosis
+    std::set<double *> pdrivenset(pdrivenlist.begin(), pdrivenlist.end());
+    for (int j=0; j < int(plist.size()); j++) {
+        if (pdrivenset.count(plist[j]) == 0)
+            pdiagnoselist.push_back(plist[j]);
+    }
+
+    for (int i=0; i < int(cgraph->clist.size()); i++) {
+        Constraint *constr = cgraph->clist[i];
+        if (constr->getTag() >= 0 && constr->isDriving()) {
+            cdiagnoselist.push_back(i);
+
+            if(tagmultiplicity.find(constr->getTag()) == tagmultiplicity.end())
+                tagmultiplicity[constr->getTag()] = 0;
+            else
+                tagmultiplicity[constr->getTag()]++;
+        }
+    }
+}
+
+void System::makeStructuralGraph(const GCS::VEC_pD &pdiagnoselist,
+                                 const VEC_I &cdiagnoselist,
+                                 BipartiteGraph &graph)
+{
+    MAP_pD_I pdiagnoseIndex;
+    for (int j=0; j < int(pdiagnoselist.size()); j++)
+        pdiagnoseIndex[pdiagnoselist[j]] = j;
+
+    for (int i=0; i < int(cdiagnoselist.size()); i++) {
+        const VEC_pD &cparams = cgraph->c2p.at(cgraph->clist[cdiagnoselist[i]]);
+        SET_I cols;
+        for (VEC_pD::const_iterator param=cparams.begin(); param != cparams.end(); ++param) {
+            MAP_pD_I::const_iterator col = pdiagnoseIndex.find(*param);
+            if (col != pdiagnoseIndex.end())
+                cols.insert(col->second);
+        }
+        for (SET_I::const_iterator col=cols.begin(); col != cols.end(); ++col)
+            graph.addEdge(i, *col);
+    }
+}
+
+int System::diagnoseStructure()
+{
+    // Structural counterpart of diagnose(): the rank of the jacobian is estimated
+    // by a maximum matching between constraints and parameters. This is exact for
+    // parameters in generic position, otherwise the structural rank is an upper
+    // bound of the numeric rank, so that structuralDofs never exceeds dofs.
+    structurallyConflictingTags.clear();
+    if (!hasUnknowns) {
+        structuralDofs = -1;
+        return structuralDofs;
+    }
+    compactConstraints();
+
+    GCS::VEC_pD pdiagnoselist;
+    VEC_I cdiagnoselist;
+    std::map< int , int> tagmultiplicity;
+    makeDiagnoseLists(pdiagnoselist, cdiagnoselist, tagmultiplicity);
+
+    BipartiteGraph graph(cdiagnoselist.size(), pdiagnoselist.size());
+    makeStructuralGraph(pdiagnoselist, cdiagnoselist, graph);
+    int srank = graph.maximumMatching();
+    structuralDofs = int(pdiagnoselist.size()) - srank;
+
+    std::vector<bool> overRows, overCols;
+    graph.overdeterminedPart(overRows, overCols);
+    SET_I tagsSet;
+    for (int i=0; i < graph.rows(); i++) {
+        if (overRows[i])
+            tagsSet.insert(cgraph->clist[cdiagnoselist[i]]->getTag());
+    }
+    tagsSet.erase(0); // exclude constraints tagged with zero
+    structurallyConflictingTags.assign(tagsSet.begin(), tagsSet.end());
+
+    return structuralDofs;
+}
+
+void System::makeStructurallyReducedJacobian(Eigen::MatrixXd &J,
+                                             std::map<int,int> &jacobianconstraintmap,
+                                             GCS::VEC_pD &pdiagnoselist,
+                                             std::map< int , int> &tagmultiplicity,
+                                             int &paramsOffset, int &rankOffset,
+                                             std::vector< VEC_pD > &structuralGroups)
+{
+    // Reduced jacobian restricted to the structurally over-determined part of the
+    // system, the only one where constraints can be redundant in generic position.
+    // The rest of the system is taken as structurally regular:
+    // - its matched constraints contribute rankOffset to the rank and its
+    //   parameters paramsOffset to the number of parameters,
+    // - its unmatched parameters are free, each one together with the parameters
+    //   reachable from it through alternating paths forms a dependent group.
+    // Numerically singular configurations outside of the over-determined part
+    // (e.g. a tangency at an inflexion of the geometry) are not detected.
+    GCS::VEC_pD pdiagnoselistAll;
+    VEC_I cdiagnoselist;
+    makeDiagnoseLists(pdiagnoselistAll, cdiagnoselist, tagmultiplicity);
+
+    BipartiteGraph graph(cdiagnoselist.size(), pdiagnoselistAll.size());
+    makeStructuralGraph(pdiagnoselistAll, cdiagnoselist, graph);
+    int srank = graph.maximumMatching();
+    structuralDofs = int(pdiagnoselistAll.size()) - srank;
+
+    std::vector<bool> overRows, overCols;
+    graph.overdeterminedPart(overRows, overCols);
+
+    SET_I tagsSet;
+    VEC_I rows;
+    for (int i=0; i < graph.rows(); i++) {
+        if (overRows[i]) {
+            rows.push_back(i);
+            tagsSet.insert(cgraph->clist[cdiagnoselist[i]]->getTag());
+        }
+    }
+    tagsSet.erase(0); // exclude constraints tagged with zero
+    structurallyConflictingTags.assign(tagsSet.begin(), tagsSet.end());
+
+    VEC_I colIndex(graph.cols(), -1);
+    for (int j=0; j < graph.cols(); j++) {
+        if (overCols[j]) {
+            colIndex[j] = pdiagnoselist.size();
+            pdiagnoselist.push_back(pdiagnoselistAll[j]);
+        }
+    }
+
+    paramsOffset = int(pdiagnoselistAll.size() - pdiagnoselist.size());
+    rankOffset = srank - int(pdiagnoselist.size()); // all columns of the over-determined part are matched
+
+    if (rows.empty())
+        J.resize(0,0);
+    else {
+        J = Eigen::MatrixXd::Zero(rows.size(), pdiagnoselist.size());
+        ParamView view;
+        for (int i=0; i < int(rows.size()); i++) {
+            Constraint *constr = cgraph->clist[cdiagnoselist[rows[i]]];
+            const ParamView &v = valuesView(constr, view);
+            const VEC_I &cols = graph.rowAdjacency(rows[i]);
+            for (VEC_I::const_iterator col=cols.begin(); col != cols.end(); ++col)
+                J(i,colIndex[*col]) = constr->grad(v, location(pdiagnoselistAll[*col]));
+
+            jacobianconstraintmap[i] = cdiagnoselist[rows[i]];
+        }
+    }
+
+    // dependent groups of the under-determined part
+    VEC_I visited(graph.cols(), -1);
+    for (int j=0; j < graph.cols(); j++) {
+        if (graph.colMatch(j) != -1)
+            continue;
+        VEC_pD group;
+        VEC_I stack(1, j);
+        visited[j] = j;
+        while (!stack.empty()) {
+            int col = stack.back();
+            stack.pop_back();
+            group.push_back(pdiagnoselistAll[col]);
+            const VEC_I &crows = graph.colAdjacency(col);
+            for (VEC_I::const_iterator row=crows.begin(); row != crows.end(); ++row) {
+                int mate = graph.rowMatch(*row);
+                if (mate != -1 && visited[mate] != j) {
+                    visited[mate] = j;
+                    stack.push_back(mate);
+                }
+            }
+        }
+        structuralGroups.push_back(group);
+    }
+}
+
 int System::diagnose(Algorithm alg)
 {
     // Analyses the constrainess grad of the system and provides feedback
@@ -3858,6 +5798,7 @@ int System::diagnose(Algorithm alg)
         dofs = -1;
         return dofs;
     }
+    compactConstraints();
 
 #ifdef _DEBUG_TO_FILE
 SolverReportingManager::Manager().LogToFile("GCS::System::diagnose()\n");
@@ -3901,14 +5842,22 @@ SolverReportingManager::Manager().LogToFile("GCS::System::diagnose()\n");
     // A tag generally corresponds to the Sketcher constraint index - There are special tag values, like 0 and -1.
     std::map< int , int> tagmultiplicity;
 
+    // parameters and rank of the part of the system left out of J by the structural pre-check
+    int paramsOffset = 0;
+    int rankOffset = 0;
+    std::vector< VEC_pD > structuralGroups;
 
-    makeReducedJacobian(J, jacobianconstraintmap, pdiagnoselist, tagmultiplicity);
+    if (structuralPrecheck)
+        makeStructurallyReducedJacobian(J, jacobianconstraintmap, pdiagnoselist, tagmultiplicity,
+                                        paramsOffset, rankOffset, structuralGroups);
+    else
+        makeReducedJacobian(J, jacobianconstraintmap, pdiagnoselist, tagmultiplicity);
 
     // this function will exit with a diagnosis and, unless overridden by functions below, with full DoFs
     hasDiagnosis = true;
-    dofs = pdiagnoselist.size();
+    dofs = int(pdiagnoselist.size()) + paramsOffset - rankOffset;
 
-    if(J.rows() > 0)
+    if(J.rows() > 0 || rankOffset > 0)
         emptyDiagnoseMatrix = false;
 
     // There is a legacy decision to use QR decomposition. I (abdullah) do not know all the
@@ -3987,7 +5936,7 @@ SolverReportingManager::Manager().LogToFile("GCS::System::diagnose()\n");
 
             fut.wait(); // wait for the execution of identifyDependentParametersSparseQR to finish
 
-            dofs = paramsNum - rank; // unless overconstraint, which will be overridden below
+            dofs = (paramsNum + paramsOffset) - (rank + rankOffset); // unless overconstraint, which will be overridden below
 
             // Detecting conflicting or redundant constraints
             if (constrNum > rank) { // conflicting or redundant constraints
@@ -3997,8 +5946,8 @@ SolverReportingManager::Manager().LogToFile("GCS::System::diagnose()\n");
                 identifyConflictingRedundantConstraints(alg, qrJT, jacobianconstraintmap, tagmultiplicity, pdiagnoselist,
                                                         R, constrNum, rank, nonredundantconstrNum);
 
-                if (paramsNum == rank && nonredundantconstrNum > rank) // over-constrained
-                    dofs = paramsNum - nonredundantconstrNum;
+                if (paramsNum + paramsOffset == rank + rankOffset && nonredundantconstrNum > rank) // over-constrained
+                    dofs = (paramsNum + paramsOffset) - (nonredundantconstrNum + rankOffset);
             }
         }
     #ifdef PROFILE_DIAGNOSE
@@ -4040,7 +5989,7 @@ SolverReportingManager::Manager().LogToFile("GCS::System::diagnose()\n");
 
             fut.wait(); // wait for the execution of identifyDependentParametersSparseQR to finish
 
-            dofs = paramsNum - rank; // unless overconstraint, which will be overridden below
+            dofs = (paramsNum + paramsOffset) - (rank + rankOffset); // unless overconstraint, which will be overridden below
 
             // Detecting conflicting or redundant constraints
             if (constrNum > rank) { // conflicting or redundant constraints
@@ -4050,8 +5999,8 @@ SolverReportingManager::Manager().LogToFile("GCS::System::diagnose()\n");
                 identifyConflictingRedundantConstraints(alg, SqrJT, jacobianconstraintmap, tagmultiplicity, pdiagnoselist,
                                                         R, constrNum, rank, nonredundantconstrNum);
 
-                if (paramsNum == rank && nonredundantconstrNum > rank) // over-constrained
-                    dofs = paramsNum - nonredundantconstrNum;
+                if (paramsNum + paramsOffset == rank + rankOffset && nonredundantconstrNum > rank) // over-constrained
+                    dofs = (paramsNum + paramsOffset) - (nonredundantconstrNum + rankOffset);
             }
         }
 
@@ -4065,6 +6014,15 @@ SolverReportingManager::Manager().LogToFile("GCS::System::diagnose()\n");
     }
 #endif
 
+    std::set<double *> pdependentset(pDependentParameters.begin(), pDependentParameters.end());
+    for (std::size_t i=0; i < structuralGroups.size(); i++) {
+        pDependentParametersGroups.push_back(structuralGroups[i]);
+        for (VEC_pD::const_iterator param=structuralGroups[i].begin(); param != structuralGroups[i].end(); ++param) {
+            if (pdependentset.insert(*param).second)
+                pDependentParameters.push_back(*param);
+        }
+    }
+
     return dofs;
 }
 
@@ -4387,6 +6345,72 @@ void System::identifyDependentGeometryParametersInTransposedJacobianDenseQRDecom
 
 }
 
+int System::verificationComponent(const std::vector<Constraint *> &constrs, const VEC_pD &params,
+                                  const std::map<Constraint *,int> &componentOf) const
+{
+    // the first constraint that is not an equality tells the component
+    int cid = -1;
+    for (std::vector<Constraint *>::const_iterator constr=constrs.begin();
+         constr != constrs.end() && cid < 0; ++constr) {
+        std::map<Constraint *,int>::const_iterator it = componentOf.find(*constr);
+        if (it != componentOf.end())
+            cid = it->second;
+    }
+    if (cid < 0 || !componentBuilt[cid] || !subSystems[cid] ||
+        components->plists[cid].size() != params.size())
+        return -1;
+
+    VEC_pD sortedParams(params);
+    std::sort(sortedParams.begin(), sortedParams.end());
+    VEC_pD componentParams(components->plists[cid]);
+    std::sort(componentParams.begin(), componentParams.end());
+    if (sortedParams != componentParams)
+        return -1;
+
+    const MAP_pD_pD &reductionmap = components->reductionmaps[cid];
+    auto reduced = [&reductionmap](double *param) {
+        MAP_pD_pD::const_iterator it = reductionmap.find(param);
+        return it != reductionmap.end() ? it->second : param;
+    };
+
+    // each constraint is either in the subsystem or an equality of the reduction,
+    // and the subsystem has no other constraints
+    std::vector<Constraint *> subsysConstrs;
+    subSystems[cid]->getConstraintList(subsysConstrs);
+    std::set<Constraint *> subsysSet(subsysConstrs.begin(), subsysConstrs.end());
+    MAP_pD_pD equalities; // forest of the equalities among constrs
+    auto root = [&equalities](double *param) {
+        for (MAP_pD_pD::const_iterator it=equalities.find(param); it != equalities.end();
+             it=equalities.find(param))
+            param = it->second;
+        return param;
+    };
+    int found = 0;
+    for (std::vector<Constraint *>::const_iterator constr=constrs.begin();
+         constr != constrs.end(); ++constr) {
+        if (subsysSet.count(*constr) > 0) {
+            found++;
+            continue;
+        }
+        if ((*constr)->getTypeId() != Equal ||
+            reduced((*constr)->params()[0]) != reduced((*constr)->params()[1]))
+            return -1;
+        double *root0 = root((*constr)->params()[0]);
+        double *root1 = root((*constr)->params()[1]);
+        if (root0 != root1)
+            equalities[root1] = root0;
+    }
+    if (found != subSystems[cid]->cSize())
+        return -1;
+
+    // the reduction must not enforce an equality that is not among constrs, e.g. a
+    // skipped one
+    for (MAP_pD_pD::const_iterator it=reductionmap.begin(); it != reductionmap.end(); ++it)
+        if (root(it->first) != root(it->second))
+            return -1;
+    return cid;
+}
+
 void System::eliminateNonZerosOverPivotInUpperTriangularMatrix( Eigen::MatrixXd &R, int rank)
 {
     for (int i=1; i < rank; i++) {
@@ -4421,12 +6445,12 @@ void System::identifyConflictingRedundantConstraints(   Algorithm alg,
             if (fabs(R(row,j)) > 1e-10) {
                 int origCol = qrJT.colsPermutation().indices()[row];
 
-                conflictGroups[j-rank].push_back(clist[jacobianconstraintmap.at(origCol)]);
+                conflictGroups[j-rank].push_back(cgraph->clist[jacobianconstraintmap.at(origCol)]);
             }
         }
         int origCol = qrJT.colsPermutation().indices()[j];
 
-        conflictGroups[j-rank].push_back(clist[jacobianconstraintmap.at(origCol)]);
+        conflictGroups[j-rank].push_back(cgraph->clist[jacobianconstraintmap.at(origCol)]);
     }
 
     // Augment the information regarding the group of constraints that are conflicting or redundant.
@@ -4438,56 +6462,180 @@ void System::identifyConflictingRedundantConstraints(   Algorithm alg,
     // system in order to check if the removed constraints were
     // just redundant but not really conflicting
     std::set<Constraint *> skipped;
-    SET_I satisfiedGroups;
-    while (1) {
-        std::map< Constraint *, SET_I > conflictingMap;
-        for (std::size_t i=0; i < conflictGroups.size(); i++) {
-            if (satisfiedGroups.count(i) == 0) {
-                for (std::size_t j=0; j < conflictGroups[i].size(); j++) {
-                    Constraint *constr = conflictGroups[i][j];
-                    if (constr->getTag() != 0) // exclude constraints tagged with zero
-                        conflictingMap[constr].insert(i);
-                }
-            }
+
+    // groups each constraint belongs to
+    std::map< Constraint *, VEC_I > constrGroups;
+    for (std::size_t i=0; i < conflictGroups.size(); i++) {
+        for (std::size_t j=0; j < conflictGroups[i].size(); j++) {
+            Constraint *constr = conflictGroups[i][j];
+            if (constr->getTag() != 0) // exclude constraints tagged with zero
+                constrGroups[constr].push_back(i);
         }
-        if (conflictingMap.empty())
+    }
+
+    // The most popular constraint, i.e. the one in most of the not yet satisfied groups,
+    // is skipped until all groups are satisfied. The popularity of the constraints is
+    // kept in buckets, each bucket sorted by the tie-breaks: lower tag multiplicity,
+    // then higher tag, then lower address (the order of the former std::map scan).
+    typedef std::tuple<int, int, Constraint *> PopularityKey;
+    auto popularityKey = [&tagmultiplicity](Constraint *constr) {
+        return PopularityKey(tagmultiplicity.at(constr->getTag()), -constr->getTag(), constr);
+    };
+    std::vector< std::set<PopularityKey> > buckets(conflictGroups.size() + 1);
+    std::map< Constraint *, int > popularity;
+    for (std::map< Constraint *, VEC_I >::const_iterator it=constrGroups.begin();
+            it != constrGroups.end(); ++it) {
+        popularity[it->first] = it->second.size();
+        buckets[it->second.size()].insert(popularityKey(it->first));
+    }
+
+    std::vector<bool> satisfiedGroups(conflictGroups.size(), false);
+    int maxPopularity = conflictGroups.size();
+    while (1) {
+        while (maxPopularity > 0 && buckets[maxPopularity].empty())
+            maxPopularity--;
+        if (maxPopularity == 0)
             break;
 
-        int maxPopularity = 0;
-        Constraint *mostPopular = NULL;
-        for (std::map< Constraint *, SET_I >::const_iterator it=conflictingMap.begin();
-                it != conflictingMap.end(); ++it) {
-            if (static_cast<int>(it->second.size()) > maxPopularity ||
-                (static_cast<int>(it->second.size()) == maxPopularity && mostPopular &&
-                tagmultiplicity.at(it->first->getTag()) < tagmultiplicity.at(mostPopular->getTag())) ||
-
-                (static_cast<int>(it->second.size()) == maxPopularity && mostPopular &&
-                tagmultiplicity.at(it->first->getTag()) == tagmultiplicity.at(mostPopular->getTag()) &&
-                    it->first->getTag() > mostPopular->getTag())
-
-            ) {
-                mostPopular = it->first;
-                maxPopularity = it->second.size();
+        Constraint *mostPopular = std::get<2>(*buckets[maxPopularity].begin());
+        skipped.insert(mostPopular);
+        const VEC_I &groups = constrGroups[mostPopular];
+        for (VEC_I::const_iterator group=groups.begin(); group != groups.end(); ++group) {
+            if (satisfiedGroups[*group])
+                continue;
+            satisfiedGroups[*group] = true;
+            for (std::size_t j=0; j < conflictGroups[*group].size(); j++) {
+                Constraint *constr = conflictGroups[*group][j];
+                if (constr->getTag() == 0)
+                    continue;
+                int &count = popularity[constr];
+                buckets[count].erase(popularityKey(constr));
+                if (--count > 0)
+                    buckets[count].insert(popularityKey(constr));
             }
         }
-        if (maxPopularity > 0) {
-            skipped.insert(mostPopular);
-            for (SET_I::const_iterator it=conflictingMap[mostPopular].begin();
-                    it != conflictingMap[mostPopular].end(); ++it)
-                satisfiedGroups.insert(*it);
-        }
     }
 
     std::vector<Constraint *> clistTmp;
-    clistTmp.reserve(clist.size());
-    for (std::vector<Constraint *>::iterator constr=clist.begin();
-        constr != clist.end(); ++constr) {
-        if ((*constr)->isDriving() && skipped.count(*constr) == 0)
-            clistTmp.push_back(*constr);
+    clistTmp.reserve(cgraph->clist.size());
+    if (structuralPrecheck) {
+        // the rest of the system is structurally regular, the verification
+        // solve is limited to the constraints of the over-determined part
+        for (std::map<int,int>::const_iterator it=jacobianconstraintmap.begin();
+            it != jacobianconstraintmap.end(); ++it) {
+            if (skipped.count(cgraph->clist[it->second]) == 0)
+                clistTmp.push_back(cgraph->clist[it->second]);
+        }
+    }
+    else {
+        for (std::vector<Constraint *>::const_iterator constr=cgraph->clist.begin();
+            constr != cgraph->clist.end(); ++constr) {
+            if ((*constr)->isDriving() && skipped.count(*constr) == 0)
+                clistTmp.push_back(*constr);
+        }
+    }
+
+    // The verification solve is only needed for the decoupled components of the
+    // diagnosed system that contain skipped constraints, each one is solved on its own
+    Graph g;
+    int pdiagnoseSize = int(pdiagnoselist.size());
+    for (int i=0; i < pdiagnoseSize + int(clistTmp.size() + skipped.size()); i++)
+        boost::add_vertex(g);
+
+    MAP_pD_I pdiagnoseIndex;
+    for (int j=0; j < pdiagnoseSize; j++)
+        pdiagnoseIndex[pdiagnoselist[j]] = j;
+
+    std::vector<Constraint *> cverifylist(clistTmp);
+    cverifylist.insert(cverifylist.end(), skipped.begin(), skipped.end());
+    for (int i=0; i < int(cverifylist.size()); i++) {
+        const VEC_pD &cparams = cgraph->c2p.at(cverifylist[i]);
+        for (VEC_pD::const_iterator param=cparams.begin(); param != cparams.end(); ++param) {
+            MAP_pD_I::const_iterator it = pdiagnoseIndex.find(*param);
+            if (it != pdiagnoseIndex.end())
+                boost::add_edge(pdiagnoseSize + i, it->second, g);
+        }
+    }
+
+    VEC_I components(boost::num_vertices(g));
+    int componentsSize = 0;
+    if (!components.empty())
+        componentsSize = boost::connected_components(g, &components[0]);
+
+    std::vector<bool> verify(componentsSize, false);
+    for (int i=int(clistTmp.size()); i < int(cverifylist.size()); i++)
+        verify[components[pdiagnoseSize + i]] = true;
+
+    std::vector< std::vector<Constraint *> > cverifylists(componentsSize);
+    std::vector< VEC_pD > pverifylists(componentsSize);
+    for (int i=0; i < int(clistTmp.size()); i++) {
+        int cid = components[pdiagnoseSize + i];
+        if (verify[cid])
+            cverifylists[cid].push_back(clistTmp[i]);
     }
+    for (int j=0; j < pdiagnoseSize; j++) {
+        int cid = components[j];
+        if (verify[cid])
+            pverifylists[cid].push_back(pdiagnoselist[j]);
+    }
+
+    // the subsystems of the last initSolution are still there, e.g. after adding a
+    // duplicate constraint, the component without it is the one already built
+    std::map<Constraint *,int> componentOf;
+    for (int cid=0; cid < int(subSystems.size()); cid++)
+        for (std::vector<Constraint *>::const_iterator constr=this->components->clists[cid].begin();
+             constr != this->components->clists[cid].end(); ++constr)
+            componentOf[*constr] = cid;
+
+    for (int cid=0; cid < componentsSize; cid++) {
+        if (!verify[cid])
+            continue;
+
+        int res = Success;
+        SubSystem *subSysTmp = NULL;
+        int builtcid = verificationComponent(cverifylists[cid], pverifylists[cid], componentOf);
+        // without further constraints the skipped ones are checked at the reference values
+        if (builtcid >= 0) {
+            res = solve(subSystems[builtcid],true,alg,true);
+            if (res == Success)
+                subSystems[builtcid]->applySolution();
+            // the subsystem holds the verification solve now
+            componentSolved[builtcid] = false;
+            solvedInputs[builtcid].clear();
+        }
+        else if (!cverifylists[cid].empty() && parent) {
+            // a fork verifies on its own values
+            MAP_pD_pD reductionmap, locations;
+            VEC_pD inputs(pverifylists[cid]);
+            for (VEC_pD::const_iterator param=pverifylists[cid].begin();
+                 param != pverifylists[cid].end(); ++param)
+                relocate(*param);
+            for (std::vector<Constraint *>::const_iterator constr=cverifylists[cid].begin();
+                 constr != cverifylists[cid].end(); ++constr)
+                inputs.insert(inputs.end(), (*constr)->params().begin(), (*constr)->params().end());
+            getLocations(inputs, locations);
+            subSysTmp = new SubSystem(cverifylists[cid], pverifylists[cid], reductionmap, locations);
+            res = solve(subSysTmp,true,alg,true);
+        }
+        else if (!cverifylists[cid].empty()) {
+            subSysTmp = new SubSystem(cverifylists[cid], pverifylists[cid]);
+            res = solve(subSysTmp,true,alg,true);
+        }
 
-    SubSystem *subSysTmp = new SubSystem(clistTmp, pdiagnoselist);
-    int res = solve(subSysTmp,true,alg,true);
+        if (res == Success) {
+            if (subSysTmp)
+                subSysTmp->applySolution();
+            for (int i=int(clistTmp.size()); i < int(cverifylist.size()); i++) {
+                if (components[pdiagnoseSize + i] != cid)
+                    continue;
+                double err = constraintError(cverifylist[i]);
+                if (err * err < convergenceRedundant)
+                    redundant.insert(cverifylist[i]);
+            }
+        }
+        delete subSysTmp;
+    }
+    resetToReference();
 
     if(debugMode==Minimal || debugMode==IterationLevel) {
         std::string solvername;
@@ -4501,21 +6649,15 @@ void System::identifyConflictingRedundantConstraints(   Algorithm alg,
             case 2: // solving with the BFGS solver
                 solvername = "DogLeg";
                 break;
+            case 3:
+                solvername = "NewtonKrylov";
+                break;
         }
 
         //.Log("Sketcher::RedundantSolving-%s-\n",solvername.c_str());
     }
 
-    if (res == Success) {
-        subSysTmp->applySolution();
-        for (std::set<Constraint *>::const_iterator constr=skipped.begin();
-                constr != skipped.end(); ++constr) {
-            double err = (*constr)->error();
-            if (err * err < convergenceRedundant)
-                redundant.insert(*constr);
-        }
-        resetToReference();
-
+    if (!redundant.empty()) {
         if(debugMode==Minimal || debugMode==IterationLevel) {
             //.Log("Sketcher Redundant solving: %d redundants\n",redundant.size());
         }
@@ -4541,7 +6683,6 @@ void System::identifyConflictingRedundantConstraints(   Algorithm alg,
                 constrNum--;
         }
     }
-    delete subSysTmp;
 
     // simplified output of conflicting tags
     SET_I conflictingTagsSet;
@@ -4561,8 +6702,8 @@ void System::identifyConflictingRedundantConstraints(   Algorithm alg,
             constr != redundant.end(); ++constr)
         redundantTagsSet.insert((*constr)->getTag());
     // remove tags represented at least in one non-redundant constraint
-    for (std::vector<Constraint *>::iterator constr=clist.begin();
-        constr != clist.end(); ++constr) {
+    for (std::vector<Constraint *>::const_iterator constr=cgraph->clist.begin();
+        constr != cgraph->clist.end(); ++constr) {
         if (redundant.count(*constr) == 0)
             redundantTagsSet.erase((*constr)->getTag());
     }
@@ -4581,6 +6722,15 @@ void System::clearSubSystems()
     free(subSystemsAux);
     subSystems.clear();
     subSystemsAux.clear();
+    for (std::size_t cid=0; cid < subSystemBlocks.size(); cid++)
+        free(subSystemBlocks[cid]);
+    subSystemBlocks.clear();
+    subSystemBlockLevels.clear();
+    solvedInputs.clear();
+    componentSolved.clear();
+    componentBuilt.clear();
+    keyParams.clear();
+    structureKeys.clear();
 }
 
 double lineSearch(SubSystem *subsys, Eigen::VectorXd &xdir)
@@ -4589,7 +6739,8 @@ double lineSearch(SubSystem *subsys, Eigen::VectorXd &xdir)
 
     double alphaMax = subsys->maxStep(xdir);
 
-    Eigen::VectorXd x0, x;
+    Eigen::VectorXd &x0 = subsys->workspace.xls0;
+    Eigen::VectorXd &x = subsys->workspace.xls;
 
     //Save initial values
     subsys->getParams(x0);
@@ -24,8 +24,15 @@
 #define PLANEGCS_GCS_H
 
 #include "SubSystem.h"
+#include "BipartiteGraph.h"
+#include "ThreadPool.h"
+#include "SolutionCache.h"
 #include <boost/concept_check.hpp>
 #include <boost/graph/graph_concepts.hpp>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
 
 #include <Eigen/QR>
 
@@ -55,12 +62,14 @@ namespace GCS
         Converged = 1,      // Found a solution minimizing the error function
         Failed = 2,         // Failed to find any solution
         SuccessfulSolutionInvalid = 3, // This is a solution where the solver succeeded, but the resulting geometry is OCE-invalid
+        Partial = 4         // The time budget ran out, the best iterate found so far is kept
     };
 
     enum Algorithm {
         BFGS = 0,
         LevenbergMarquardt = 1,
-        DogLeg = 2
+        DogLeg = 2,
+        NewtonKrylov = 3 // matrix free, for very large subsystems
     };
 
     enum DogLegGaussStep {
@@ -74,6 +83,12 @@ namespace GCS
         EigenSparseQR = 1
     };
 
+    enum Preconditioner {
+        NoPreconditioner = 0,
+        BlockJacobiPreconditioner = 1,       // matrix free, see SubSystem::factorBlockJacobi
+        IncompleteCholeskyPreconditioner = 2 // of the assembled sparse J^T J, which may fill in
+    };
+
     enum DebugMode {
         NoDebug = 0,
         Minimal = 1,
@@ -100,7 +115,12 @@ namespace GCS
     private:
         VEC_pD plist; // list of the unknown parameters
         VEC_pD pdrivenlist; // list of parameters of driven constraints
-        MAP_pD_I pIndex;
+
+        // The structure of the system is held in immutable parts that a fork shares
+        // with its parent. Writing a part goes through writable (see GCS.cpp), which
+        // copies it first if it is shared, so that a fork copies the constraint graph
+        // or the partition only when it adds or removes a constraint.
+        std::shared_ptr<const MAP_pD_I> pIndex; // index of the unknowns in plist
 
         VEC_pD pDependentParameters; // list of dependent parameters by the system
 
@@ -108,36 +128,172 @@ namespace GCS
         // GCS ignores from a type point
         std::vector< std::vector<double *> > pDependentParametersGroups;
 
-        std::vector<Constraint *> clist;
-        std::map<Constraint *,VEC_pD > c2p; // constraint to parameter adjacency list
-        std::map<double *,std::vector<Constraint *> > p2c; // parameter to constraint adjacency list
+        // slot of a constraint in clist, and its tag and slot in tagIndex
+        struct ConstraintSlot
+        {
+            int slot, tag, tagSlot;
+        };
+        struct ConstraintGraph
+        {
+            std::vector<Constraint *> clist; // removed constraints leave a NULL slot until compactConstraints()
+            int removedSlots;                // number of NULL slots in clist
+            std::map<Constraint *,VEC_pD > c2p; // constraint to parameter adjacency list
+            std::map<double *,std::vector<Constraint *> > p2c; // parameter to constraint adjacency list
+            std::map<Constraint *,ConstraintSlot> clistIndex;
+            std::map<int,std::vector<Constraint *> > tagIndex; // constraints by tag, in no particular order
+            ConstraintGraph() : removedSlots(0) {}
+        };
+        std::shared_ptr<const ConstraintGraph> cgraph;
+        void removeConstraints(const std::vector<Constraint *> &constrvec);
+        void compactConstraints(); // drops the NULL slots of clist, keeping the order of the others
+        void unindexTag(const ConstraintSlot &slot);
 
         std::vector<SubSystem *> subSystems, subSystemsAux;
         void clearSubSystems();
 
+        // block-triangular split of subSystems[cid] in solving order, empty if the
+        // component is not split; blocks sharing a level are independent of each other
+        std::vector< std::vector<SubSystem *> > subSystemBlocks;
+        std::vector< VEC_I > subSystemBlockLevels;
+        void decomposeSubSystem(int cid, std::vector<Constraint *> &clist0, const MAP_pD_pD &locations);
+        int solveBlocks(int cid, bool isFine, Algorithm alg, bool isRedundantsolving);
+        // retry of a failed component from perturbed starts, see multiStarts
+        int solveMultiStart(int cid, bool isFine, Algorithm alg, bool isRedundantsolving);
+
+        // dirty tracking of the components, so that solve skips the unchanged ones
+        std::vector< VEC_D > solvedInputs;  // values of inputParams at the last successful fine solve, empty if none
+        std::vector< bool > componentSolved; // if the subsystems of a component hold a solution to apply
+        bool isSolvedComponent(int cid, bool isFine) const; // evaluated without the subsystems
+        VEC_D componentInputs;   // buffer of solve for the inputs of a component, kept to not allocate
+        bool isCleanComponent(int cid, bool isFine, VEC_D &inputs);
+
+        // the subsystems of a component are built by initSolution, except in a fork,
+        // which builds them on first use
+        std::vector< bool > componentBuilt;
+        void buildSubSystems(int cid);
+        void dropSubSystems(int cid);
+
+        // Copy-on-write state of a fork: a parameter of the parent is relocated to the
+        // storage of the fork when the fork writes it. The unknowns of a component are
+        // relocated together when the fork builds the component, which is about to
+        // write them anyway.
+        const System *parent;                      // NULL unless this system is a fork
+        bool isOwnConstraint(Constraint *constr) const; // not one of the parent
+        MAP_pD_pD relocation;                      // from the parameters to their storage in the fork
+        std::deque<double> relocatedValues;        // the storage, which does not move on growth
+        double *relocated(double *param) const;
+        double *relocate(double *param);
+        void setForkValue(double *param, double value);
+        void getLocations(const VEC_pD &params, MAP_pD_pD &locationsOut) const;
+        // constr bound to the values of this system: its own view, or a view in view for a fork
+        const ParamView &valuesView(Constraint *constr, ParamView &view) const;
+        double constraintError(Constraint *constr) const;
+
+        // Bounded LRU cache of the solutions of the components. The key hashes the
+        // structure of a component (types of the constraints and which parameters they
+        // share) and the values it is solved from (driving values and reference values
+        // of the unknowns), but not where the parameters are allocated, so that the
+        // solutions survive clear and a new set up of the same sketch. What the key
+        // does not describe (e.g. alignment types) is covered by verifying the residual
+        // of a cached solution before using it. The entries hold the values of plists,
+        // found by the key, the structure key and the values of keyParams.
+        SolutionCache solutionCache;
+        std::vector< VEC_pD > keyParams;       // parameters of a component in order of first use, empty until needed
+        std::vector< std::size_t > structureKeys;
+        std::size_t solutionKey(int cid, VEC_D &inputs);
+        bool restoreSolution(int cid, std::size_t key, const VEC_D &inputs, bool isFine);
+        void storeSolution(int cid, std::size_t key, const VEC_D &inputs);
+
         VEC_D reference;
         void setReference();     // copies the current parameter values to reference
         void resetToReference(); // reverts all parameter values to the stored reference
 
-        std::vector< VEC_pD > plists;                    // partitioned plist except equality constraints
-        std::vector< std::vector<Constraint *> > clists; // partitioned clist except equality constraints
-        std::vector< MAP_pD_pD > reductionmaps;          // for simplification of equality constraints
+        // the decoupled components, replaced as a whole by initSolution
+        struct Components
+        {
+            std::vector< VEC_pD > plists;                    // partitioned plist except equality constraints
+            std::vector< std::vector<Constraint *> > clists; // partitioned clist except equality constraints
+            std::vector< MAP_pD_pD > reductionmaps;          // for simplification of equality constraints
+            std::vector< VEC_pD > inputParams;  // all the parameters read by the constraints of a component, sorted
+        };
+        std::shared_ptr<const Components> components;
+
+        // Incremental partition of plist into the decoupled components: a union-find
+        // on the indices of plist, in which addConstraint joins the unknowns of the
+        // new constraint. A removal only marks the set of the constraint, initSolution
+        // then splits the marked sets again from the constraints of their members.
+        struct Partition
+        {
+            VEC_I paramParent;               // union-find forest, a root is its own parent
+            std::vector< VEC_I > paramSets;  // members of the set of each root, empty for the others
+            VEC_I splitParams;               // unknowns whose sets are to be split again
+            std::set<Constraint *> partitionRedundant; // redundant constraints left out of the partition
+        };
+        std::shared_ptr<const Partition> partition;
+        bool isPartitioned;              // if the union-find is up to date with plist and clist
+        int findSet(int i) const;
+        void joinSets(Constraint *constr); // joins the sets of the unknowns of constr
+        void markSplit(Constraint *constr);
+        void splitSet(int root);
+        void updatePartition();
 
         int dofs;
         std::set<Constraint *> redundant;
         VEC_I conflictingTags, redundantTags;
 
+        int structuralDofs; // dofs according to the structure of the system only
+        VEC_I structurallyConflictingTags; // tags of the structurally over-determined part
+
         bool hasUnknowns;  // if plist is filled with the unknown parameters
         bool hasDiagnosis; // if dofs, conflictingTags, redundantTags are up to date
-        bool isInit;       // if plists, clists, reductionmaps are up to date
+        bool isInit;       // if components is up to date
 
         bool emptyDiagnoseMatrix; // false only if there is at least one driving constraint.
 
+        VEC_D dragTargets; // target values of the dragged parameters, not resized during a drag
+        std::vector<Constraint *> dragConstraints; // temporary constraints of the drag session
+        Algorithm dragAlgorithm;
+
+        bool hasDeadline; // if the solvers have to stop at deadline
+        std::chrono::steady_clock::time_point deadline;
+        CancellationToken cancellation; // of the running asynchronous solve
+        bool isInterrupted() const
+          { return (hasDeadline && std::chrono::steady_clock::now() >= deadline) ||
+                   cancellation.isCancelled(); }
+
+        ThreadPool *pool; // created on first use
+        std::mutex poolMutex;
+        ThreadPool &threadPool();
+        std::mutex asyncMutex; // asynchronous solves of the system run one at a time
+
+        int sweepStep(const VEC_I &cids, double *param, double value, bool isFine, Algorithm alg);
+        void applySolution(int cid);
+        void syncSubSystems(int cid); // copies the original parameters of a component into its subsystems
+        Eigen::VectorXd syncValues;   // buffer of syncSubSystems
+
+        int solveCancellable(const CancellationToken &token, bool isFine, Algorithm alg);
+
+        // tolerances of a rough solve (isFine=false) are loosened up to convergenceRough
+        double tolerance(double fine, bool isFine) const
+          { return isFine ? fine : std::max(fine, convergenceRough); }
+        double successError(bool isFine) const // upper bound of the error of a solution
+          { return isFine ? smallF : std::max(smallF, 0.5*convergenceRough*convergenceRough); }
+
         int solve_BFGS(SubSystem *subsys, bool isFine=true, bool isRedundantsolving=false);
-        int solve_LM(SubSystem *subsys, bool isRedundantsolving=false);
-        int solve_DL(SubSystem *subsys, bool isRedundantsolving=false);
+        int solve_LM(SubSystem *subsys, bool isFine=true, bool isRedundantsolving=false);
+        int solve_DL(SubSystem *subsys, bool isFine=true, bool isRedundantsolving=false);
+        int solve_NK(SubSystem *subsys, bool isFine=true, bool isRedundantsolving=false);
+        // implementations for subsystems of Cols parameters and at most MaxRows constraints,
+        // either fixed sizes or Eigen::Dynamic
+        template <int Cols, int MaxRows> int solve_LM(SubSystem *subsys, bool isFine, bool isRedundantsolving);
+        template <int Cols, int MaxRows> int solve_DL(SubSystem *subsys, bool isFine, bool isRedundantsolving);
 
         void makeReducedJacobian(Eigen::MatrixXd &J, std::map<int,int> &jacobianconstraintmap, GCS::VEC_pD &pdiagnoselist, std::map< int , int> &tagmultiplicity);
+        void makeDiagnoseLists(GCS::VEC_pD &pdiagnoselist, VEC_I &cdiagnoselist, std::map< int , int> &tagmultiplicity);
+        void makeStructuralGraph(const GCS::VEC_pD &pdiagnoselist, const VEC_I &cdiagnoselist, BipartiteGraph &graph);
+        void makeStructurallyReducedJacobian(Eigen::MatrixXd &J, std::map<int,int> &jacobianconstraintmap, GCS::VEC_pD &pdiagnoselist,
+                                             std::map< int , int> &tagmultiplicity, int &paramsOffset, int &rankOffset,
+                                             std::vector< VEC_pD > &structuralGroups);
 
         void makeDenseQRDecomposition(  const Eigen::MatrixXd &J,
                                         const std::map<int,int> &jacobianconstraintmap,
@@ -170,6 +326,11 @@ namespace GCS
                                                         int &nonredundantconstrNum
         );
 
+        // the component whose built subsystem solves exactly constrs on params (the
+        // equalities among constrs may be reduced), -1 if there is none
+        int verificationComponent(const std::vector<Constraint *> &constrs, const VEC_pD &params,
+                                  const std::map<Constraint *,int> &componentOf) const;
+
         void eliminateNonZerosOverPivotInUpperTriangularMatrix(Eigen::MatrixXd &R, int rank);
 
 #ifdef EIGEN_SPARSEQR_COMPATIBLE
@@ -197,10 +358,12 @@ namespace GCS
     public:
         int maxIter;
         int maxIterRedundant;
+        int maxIterCorrector; // iterations allowed to the corrector of each sweep step
         bool sketchSizeMultiplier; // if true note that the total number of iterations allowed is MaxIterations *xLength
         bool sketchSizeMultiplierRedundant;
         double convergence;
         double convergenceRedundant;
+        double convergenceRough; // residual tolerance of a rough solve, see solve
         QRAlgorithm qrAlgorithm;
         DogLegGaussStep dogLegGaussStep;
         double qrpivotThreshold;
@@ -217,17 +380,52 @@ namespace GCS
         double DL_tolgRedundant;
         double DL_tolxRedundant;
         double DL_tolfRedundant;
+        int NK_maxIterCG;        // conjugate gradient iterations per Newton step of NewtonKrylov
+        Preconditioner NK_preconditioner; // of the conjugate gradients of NewtonKrylov, factored once per solve
+        bool blockDecomposition; // if true, components are solved as a sequence of structurally square blocks
+        int blockParallelThreshold; // min number of parameters of independent blocks to solve them in parallel
+        int rowParallelThreshold; // min number of constraints of a subsystem to evaluate its rows in parallel
+        bool structuralPrecheck; // if true, diagnose runs the numeric QR only on the structurally over-determined part
+        bool analyticSolving; // if true, subsystems matching a known pattern are solved in closed form
+        bool autoScaling; // if true, the residual rows (not the unknowns) are equilibrated before solving with BFGS or LM
+        int solutionCacheSize; // max number of component solutions remembered by solve and updateDrag, 0 disables the cache
+        int multiStarts; // perturbed starts solved in parallel when a component fails, 0 disables the retry
+        double multiStartRadius; // distance of the farthest start from the reference, relative to the largest unknown (at least 1)
 
     public:
         System();
         /*System(std::vector<Constraint *> clist_);*/
         ~System();
 
-        void clear();
+        // Copy-on-write fork for speculative solves, e.g. to preview an edit before
+        // making it: the fork shares the constraints, the diagnosis and the components
+        // of this system, and copies the values of the parameters only where it writes
+        // them, so that solving, applying and undoing in the fork never change the
+        // parameters of this system. Constraints added to the fork belong to the fork,
+        // removing a shared one only removes it from the fork; the fork copies the
+        // constraint graph on the first of these. This system must outlive its forks
+        // and must not be changed while they exist (rescaleConstraint and
+        // setConstraintTag in a fork change a shared constraint for both); forks of
+        // one system can then be used in parallel, one thread per fork. The caller
+        // deletes the fork.
+        System *fork() const;
+        // the value of param as seen by this system, which is its own value in a fork
+        double *location(double *param) const { return parent ? relocated(param) : param; }
+        double getValue(double *param) const { return *location(param); }
+        void setValue(double *param, double value)
+          { if (parent) setForkValue(param, value); else *param = value; }
+
+        void clear(); // keeps the solution cache, see clearSolutionCache
         void clearByTag(int tagId);
+        void clearSolutionCache();
 
+        // Constraints are indexed by their tag when they are added: the tag of a
+        // constraint of the system must be changed with setConstraintTag, as
+        // clearByTag and calculateConstraintErrorByTag would miss a constraint
+        // retagged with Constraint::setTag.
         int addConstraint(Constraint *constr);
         void removeConstraint(Constraint *constr);
+        void setConstraintTag(Constraint *constr, int tagId);
 
         // basic constraints
         int addConstraintEqual(double *param1, double *param2, int tagId=0, bool driving = true);
@@ -273,6 +471,7 @@ namespace GCS
         int addConstraintPointOnParabolicArc(Point &p, ArcOfParabola &e, int tagId=0, bool driving = true);
         int addConstraintArcOfEllipseRules(ArcOfEllipse &a, int tagId=0, bool driving = true);
         int addConstraintCurveValue(Point &p, Curve &a, double *u, int tagId=0, bool driving = true);
+        int addConstraintPointOnBSpline(Point &p, BSpline &b, double *u, int tagId=0, bool driving = true);
         int addConstraintArcOfHyperbolaRules(ArcOfHyperbola &a, int tagId=0, bool driving = true);
         int addConstraintArcOfParabolaRules(ArcOfParabola &a, int tagId=0, bool driving = true);
         int addConstraintPointOnArc(Point &p, Arc &a, int tagId=0, bool driving = true);
@@ -292,6 +491,7 @@ namespace GCS
         int addConstraintTangent(Circle &c1, Circle &c2, int tagId=0, bool driving = true);
         int addConstraintTangent(Arc &a1, Arc &a2, int tagId=0, bool driving = true);
         int addConstraintTangent(Circle &c, Arc &a, int tagId=0, bool driving = true);
+        int addConstraintTangent(Line &l, BSpline &b, double *u, int tagId=0, bool driving = true);
 
         int addConstraintCircleRadius(Circle &c, double *radius, int tagId=0, bool driving = true);
         int addConstraintArcRadius(Arc &a, double *radius, int tagId=0, bool driving = true);
@@ -342,13 +542,52 @@ namespace GCS
         void declareDrivenParams(VEC_pD &params);
         void initSolution(Algorithm alg=DogLeg);
 
+        // With isFine=false the solvers stop once the residuals are within convergenceRough,
+        // which is enough for previews and interactive frames. A rough solution can be
+        // refined later by refineAsync.
         int solve(bool isFine=true, Algorithm alg=DogLeg, bool isRedundantsolving=false);
         int solve(VEC_pD &params, bool isFine=true, Algorithm alg=DogLeg, bool isRedundantsolving=false);
         int solve(SubSystem *subsys, bool isFine=true, Algorithm alg=DogLeg, bool isRedundantsolving=false);
         int solve(SubSystem *subsysA, SubSystem *subsysB, bool isFine=true, bool isRedundantsolving=false);
+        // Solves within a time budget in milliseconds. When the budget runs out, the
+        // solvers stop at their best iterate and Partial is returned: the solution can
+        // be applied as an approximation and refined later by another solve.
+        // residual returns the total error of the solved subsystems, or of the
+        // temporary constraints for the components that have no other ones.
+        int solveWithDeadline(double budget, double &residual, bool isFine=true, Algorithm alg=DogLeg);
+        // Runs solve on the worker pool of the system. The system must not be used
+        // until the future is ready, except for starting another asynchronous solve,
+        // which waits for the running one (typically cancelled as stale) to stop.
+        // A cancelled solve stops at the next iteration of the solvers, leaves the
+        // parameters at the reference and returns Failed.
+        std::future<int> solveAsync(const CancellationToken &token, bool isFine=true, Algorithm alg=DogLeg);
+        // Fine solve on the worker pool starting from the current parameter values, which
+        // become the reference, typically after applying a rough solution. Same rules
+        // as solveAsync.
+        std::future<int> refineAsync(const CancellationToken &token, Algorithm alg=DogLeg);
+        // Continuation along a driving parameter (e.g. the value of a dimension), which
+        // takes the given values in turn. Each solution is predicted from the tangent
+        // dx/dparam and corrected by at most maxIterCorrector iterations, the step is
+        // halved where the corrector fails. The values of plist after each sample are
+        // stored one after the other in solutions. The parameters, including param,
+        // are restored afterwards.
+        int sweep(double *param, const VEC_D &values, VEC_D &solutions, bool isFine=true, Algorithm alg=DogLeg);
 
         void applySolution();
         void undoSolution();
+
+        // Drag session: the parameters are pulled towards target values by temporary
+        // constraints added once by initDrag, so that the subsystems survive between
+        // the updates and each update starts from the solution of the previous one.
+        // Only the components with temporary constraints are solved, a successful
+        // update is applied and becomes the new reference. With rediagnose=false a
+        // missing diagnosis is not recomputed and no constraint is taken as redundant.
+        // A rough update (isFine=false) is usually enough while dragging.
+        // finishDrag removes the temporary constraints, the system has to be
+        // initialized again afterwards.
+        int initDrag(const VEC_pD &params, Algorithm alg=DogLeg, bool rediagnose=true);
+        int updateDrag(const VEC_D &targets, bool isFine=true);
+        void finishDrag();
         //FIXME: looks like XconvergenceFine is not the solver precision, at least in DogLeg solver.
         // Note: Yes, every solver has a different way of interpreting precision
         // but one has to study what is this needed for in order to decide
@@ -357,6 +596,13 @@ namespace GCS
 
         int diagnose(Algorithm alg=DogLeg);
         int dofsNumber() const { return hasDiagnosis ? dofs : -1; }
+        // Structural diagnosis, it only looks at which parameters each constraint
+        // depends on (no numeric work), so it is cheap enough to run on every edit.
+        // Returns the structural dofs, which are a lower bound of the real dofs
+        int diagnoseStructure();
+        int structuralDofsNumber() const { return structuralDofs; }
+        void getStructurallyConflicting(VEC_I &conflictingOut) const
+          { conflictingOut = structurallyConflictingTags; }
         void getConflicting(VEC_I &conflictingOut) const
           { conflictingOut = hasDiagnosis ? conflictingTags : VEC_I(0); }
         void getRedundant(VEC_I &redundantOut) const
@@ -365,8 +611,18 @@ namespace GCS
           { pdependentparameterlist = pDependentParameters;}
         void getDependentParamsGroups(std::vector<std::vector<double *>> &pdependentparametergroups) const
           { pdependentparametergroups = pDependentParametersGroups;}
+        // the unknowns of each decoupled component found by the last initSolution
+        void getComponents(std::vector<VEC_pD> &componentsOut) const
+          { componentsOut = isInit ? components->plists : std::vector<VEC_pD>(0); }
         bool isEmptyDiagnoseMatrix() const {return emptyDiagnoseMatrix;}
         void invalidatedDiagnosis();
+
+        #ifdef PROFILE_CONSTRAINTS
+        // evaluations of the constraints by type since the last reset, of all the systems,
+        // the most expensive type first; the report is logged as well
+        std::string getConstraintProfile() const;
+        void resetConstraintProfile();
+        #endif
     };
 
 
@@ -27,6 +27,7 @@
 #include "Geo.h"
 
 #include <cassert>
+#include <algorithm>
 
 namespace GCS{
 
@@ -212,16 +213,63 @@ Arc* Arc::Copy()
 }
 
 
+//--------------conic
+
+const MajorRadiusConic::DerivedQuantities &MajorRadiusConic::getDerived(const DeriVector2 &center, const DeriVector2 &f1, const double *b) const
+{
+    DerivedQuantities &q = derived;
+    if (!q.hasFocal || center.x != q.cx || center.y != q.cy || f1.x != q.fx || f1.y != q.fy) {
+        q.cx = center.x; q.cy = center.y;
+        q.fx = f1.x; q.fy = f1.y;
+        q.cfx = f1.x - center.x;
+        q.cfy = f1.y - center.y;
+        q.cf2 = q.cfx*q.cfx + q.cfy*q.cfy;
+        q.cf = sqrt(q.cf2);
+        q.emajx = q.cf == 0. ? 0. : q.cfx/q.cf;
+        q.emajy = q.cf == 0. ? 0. : q.cfy/q.cf;
+        q.hasFocal = true;
+        q.hasRadMaj = false;
+    }
+    if (b && (!q.hasRadMaj || *b != q.b)) {
+        q.b = *b;
+        q.radmaj = radMaj(q.cf2, *b);
+        q.hasRadMaj = true;
+    }
+    return q;
+}
+
+DeriVector2 MajorRadiusConic::getMajorAxis(const DeriVector2 &center, const DeriVector2 &f1) const
+{
+    const DerivedQuantities &q = getDerived(center, f1, 0);
+    double dcfx = f1.dx - center.dx;
+    double dcfy = f1.dy - center.dy;
+    if (q.cf == 0.)
+        return DeriVector2(0., 0., dcfx, dcfy);
+    //the derivative of the focal vector without its collinear part, scaled
+    double dsc = q.emajx*dcfx + q.emajy*dcfy;
+    return DeriVector2(q.emajx, q.emajy,
+                       (dcfx - dsc*q.emajx)/q.cf, (dcfy - dsc*q.emajy)/q.cf);
+}
+
 //--------------ellipse
 
+double Ellipse::radMaj(double cf2, double b) const
+{
+    return sqrt(cf2 + b*b);
+}
+
 //this function is exposed to allow reusing pre-filled derivectors in constraints code
 double Ellipse::getRadMaj(const DeriVector2 &center, const DeriVector2 &f1, double b, double db, double &ret_dRadMaj) const
 {
-    double cf, dcf;
-    cf = f1.subtr(center).length(dcf);
-    DeriVector2 hack (b, cf,
-                      db, dcf);//hack = a nonsense vector to calculate major radius with derivatives, useful just because the calculation formula is the same as vector length formula
-    return hack.length(ret_dRadMaj);
+    // a = sqrt(|f1-c|^2 + b^2)
+    const DerivedQuantities &q = getDerived(center, f1, &b);
+    double dcfx = f1.dx - center.dx;
+    double dcfy = f1.dy - center.dy;
+    if (q.radmaj == 0.)
+        ret_dRadMaj = 1.0; // as DeriVector2::length
+    else
+        ret_dRadMaj = (q.cfx*dcfx + q.cfy*dcfy + b*db)/q.radmaj;
+    return q.radmaj;
 }
 
 //returns major radius. The derivative by derivparam is returned into ret_dRadMaj argument.
@@ -292,7 +340,7 @@ DeriVector2 Ellipse::Value(double u, double du, const double* derivparam) const
     DeriVector2 c(this->center, derivparam);
     DeriVector2 f1(this->focus1, derivparam);
 
-    DeriVector2 emaj = f1.subtr(c).getNormalized();
+    DeriVector2 emaj = getMajorAxis(c, f1);
     DeriVector2 emin = emaj.rotate90ccw();
     double b, db;
     b = *(this->radmin); db = this->radmin==derivparam ? 1.0 : 0.0;
@@ -370,16 +418,20 @@ ArcOfEllipse* ArcOfEllipse::Copy()
 
 //---------------hyperbola
 
+double Hyperbola::radMaj(double cf2, double b) const
+{
+    return sqrt(cf2 - b*b);
+}
+
 //this function is exposed to allow reusing pre-filled derivectors in constraints code
 double Hyperbola::getRadMaj(const DeriVector2 &center, const DeriVector2 &f1, double b, double db, double &ret_dRadMaj) const
 {
-    double cf, dcf;
-    cf = f1.subtr(center).length(dcf);
-    double a, da;
-    a = sqrt(cf*cf - b*b);
-    da = (dcf*cf - db*b)/a;
-    ret_dRadMaj = da;
-    return a;
+    // a = sqrt(|f1-c|^2 - b^2)
+    const DerivedQuantities &q = getDerived(center, f1, &b);
+    double dcfx = f1.dx - center.dx;
+    double dcfy = f1.dy - center.dy;
+    ret_dRadMaj = (q.cfx*dcfx + q.cfy*dcfy - b*db)/q.radmaj;
+    return q.radmaj;
 }
 
 //returns major radius. The derivative by derivparam is returned into ret_dRadMaj argument.
@@ -430,7 +482,7 @@ DeriVector2 Hyperbola::Value(double u, double du, const double* derivparam) cons
     DeriVector2 c(this->center, derivparam);
     DeriVector2 f1(this->focus1, derivparam);
 
-    DeriVector2 emaj = f1.subtr(c).getNormalized();
+    DeriVector2 emaj = getMajorAxis(c, f1);
     DeriVector2 emin = emaj.rotate90ccw();
     double b, db;
     b = *(this->radmin); db = this->radmin==derivparam ? 1.0 : 0.0;
@@ -652,12 +704,196 @@ DeriVector2 BSpline::CalculateNormal(const Point &p, const double* derivparam) c
     return ret;
 }
 
-DeriVector2 BSpline::Value(double /*u*/, double /*du*/, const double* /*derivparam*/) const
+DeriVector2 BSpline::Value(double u, double du, const double* derivparam) const
 {
-    // place holder
-    DeriVector2 ret = DeriVector2();
+    DeriVector2 c, c1, c2;
+    evaluate(u, derivparam, c, c1, c2);
+    return DeriVector2(c.x, c.y, c.dx + c1.x*du, c.dy + c1.y*du);
+}
 
-    return ret;
+DeriVector2 BSpline::Tangent(double u, double du, const double* derivparam) const
+{
+    DeriVector2 c, c1, c2;
+    evaluate(u, derivparam, c, c1, c2);
+    return DeriVector2(c1.x, c1.y, c1.dx + c2.x*du, c1.dy + c2.y*du);
+}
+
+void BSpline::flatten() const
+{
+    flatKnots.clear();
+    flatPeriods.clear();
+    for (int j=0; j < int(knots.size()); j++) {
+        flatKnots.insert(flatKnots.end(), mult[j], j);
+        flatPeriods.insert(flatPeriods.end(), mult[j], 0);
+    }
+
+    // A periodic spline repeats its last knot as the first one of the next period. The
+    // c knots before the last one are repeated one period before the first one, and
+    // the c knots after the first one one period after the last one, so that every
+    // span of the period has its degree knots on both sides.
+    int c = degree + 1 - (mult.empty() ? 0 : mult.front());
+    if (periodic && c > 0) {
+        VEC_I front(flatKnots.end() - mult.back() - c, flatKnots.end() - mult.back());
+        VEC_I back(flatKnots.begin() + mult.front(), flatKnots.begin() + mult.front() + c);
+        flatKnots.insert(flatKnots.end(), back.begin(), back.end());
+        flatPeriods.insert(flatPeriods.end(), c, 1);
+        flatKnots.insert(flatKnots.begin(), front.begin(), front.end());
+        flatPeriods.insert(flatPeriods.begin(), c, -1);
+    }
+}
+
+double BSpline::flatKnot(int i) const
+{
+    double knot = *knots[flatKnots[i]];
+    if (flatPeriods[i] != 0)
+        knot += flatPeriods[i] * (*knots.back() - *knots.front());
+    return knot;
+}
+
+void BSpline::updateBasis(double u) const
+{
+    if (flatKnots.empty())
+        flatten();
+    int p = degree;
+
+    if (basisSpan >= 0 && u == basisU) {
+        bool isSame = true;
+        for (int k=0; k < 2*p && isSame; k++)
+            isSame = (flatKnot(basisSpan - p + 1 + k) == basisKnots[k]);
+        if (isSame)
+            return;
+    }
+
+    // last span whose first knot is not after u, the spans of the first and last knots
+    // are extended beyond the ends of the spline
+    int n = int(poles.size());
+    int low = p;
+    int high = periodic ? n + p - mult.front() : n - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (flatKnot(mid) <= u)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    basisU = u;
+    basisSpan = low;
+    basisKnots.resize(2*p);
+    for (int k=0; k < 2*p; k++)
+        basisKnots[k] = flatKnot(basisSpan - p + 1 + k);
+
+    // Basis functions of the span and their derivatives, after algorithm A2.3 of
+    // Piegl and Tiller, The NURBS Book. basisKnots[p-1] and basisKnots[p] bound the span.
+    ndu.resize((p+1)*(p+1));
+    left.resize(p+1);
+    right.resize(p+1);
+    a.resize(2*(p+1));
+    basis.resize(p+1);
+    basis1.assign(p+1, 0.);
+    basis2.assign(p+1, 0.);
+    auto N = [this, p](int i, int j) -> double & { return ndu[i*(p+1) + j]; };
+
+    N(0,0) = 1.;
+    for (int j=1; j <= p; j++) {
+        left[j] = u - basisKnots[p-j];
+        right[j] = basisKnots[p-1+j] - u;
+        double saved = 0.;
+        for (int r=0; r < j; r++) {
+            N(j,r) = right[r+1] + left[j-r]; // knot differences, lower triangle
+            double temp = N(r,j-1) / N(j,r);
+            N(r,j) = saved + right[r+1]*temp; // basis functions, upper triangle
+            saved = left[j-r]*temp;
+        }
+        N(j,j) = saved;
+    }
+    for (int j=0; j <= p; j++)
+        basis[j] = N(j,p);
+
+    int orders = std::min(2, p);
+    double *ders[3] = { &basis[0], &basis1[0], &basis2[0] };
+    for (int r=0; r <= p; r++) {
+        double *a1 = &a[0], *a2 = &a[p+1];
+        a1[0] = 1.;
+        for (int k=1; k <= orders; k++) {
+            double d = 0.;
+            int rk = r - k, pk = p - k;
+            if (r >= k) {
+                a2[0] = a1[0] / N(pk+1,rk);
+                d = a2[0] * N(rk,pk);
+            }
+            int j1 = rk >= -1 ? 1 : -rk;
+            int j2 = r - 1 <= pk ? k - 1 : p - r;
+            for (int j=j1; j <= j2; j++) {
+                a2[j] = (a1[j] - a1[j-1]) / N(pk+1,rk+j);
+                d += a2[j] * N(rk+j,pk);
+            }
+            if (r <= pk) {
+                a2[k] = -a1[k-1] / N(pk+1,r);
+                d += a2[k] * N(r,pk);
+            }
+            ders[k][r] = d;
+            std::swap(a1, a2);
+        }
+    }
+    double factor = p;
+    for (int k=1; k <= orders; k++) {
+        for (int j=0; j <= p; j++)
+            ders[k][j] *= factor;
+        factor *= p - k;
+    }
+}
+
+void BSpline::evaluate(double u, const double* derivparam,
+                       DeriVector2 &c, DeriVector2 &c1, DeriVector2 &c2) const
+{
+    if (periodic) {
+        double first = *knots.front(), period = *knots.back() - first;
+        if (period > 0.) {
+            u = std::fmod(u - first, period);
+            u += (u < 0. ? period : 0.) + first;
+        }
+    }
+    updateBasis(u);
+
+    // C = A/W with A = sum(N w P) and W = sum(N w) on the poles of the span
+    int p = degree;
+    int n = int(poles.size());
+    double ax=0., ay=0., a1x=0., a1y=0., a2x=0., a2y=0., w=0., w1=0., w2=0.;
+    double dax=0., day=0., da1x=0., da1y=0., dw=0., dw1=0.;
+    for (int j=0; j <= p; j++) {
+        int i = (basisSpan - p + j) % n;
+        double px = *poles[i].x, py = *poles[i].y, wi = *weights[i];
+        ax += basis[j]*wi*px;   ay += basis[j]*wi*py;   w += basis[j]*wi;
+        a1x += basis1[j]*wi*px; a1y += basis1[j]*wi*py; w1 += basis1[j]*wi;
+        a2x += basis2[j]*wi*px; a2y += basis2[j]*wi*py; w2 += basis2[j]*wi;
+        if (!derivparam)
+            continue;
+        if (derivparam == poles[i].x) {
+            dax += basis[j]*wi;
+            da1x += basis1[j]*wi;
+        }
+        if (derivparam == poles[i].y) {
+            day += basis[j]*wi;
+            da1y += basis1[j]*wi;
+        }
+        if (derivparam == weights[i]) {
+            dax += basis[j]*px;   day += basis[j]*py;   dw += basis[j];
+            da1x += basis1[j]*px; da1y += basis1[j]*py; dw1 += basis1[j];
+        }
+    }
+
+    // C' = (A' - W'C)/W, C'' = (A'' - 2W'C' - W''C)/W and the derivatives of C and C'
+    // on derivparam from the ones of A, A', W and W'
+    double cx = ax/w, cy = ay/w;
+    double c1x = (a1x - w1*cx)/w, c1y = (a1y - w1*cy)/w;
+    double c2x = (a2x - 2*w1*c1x - w2*cx)/w, c2y = (a2y - 2*w1*c1y - w2*cy)/w;
+    double dcx = (dax - dw*cx)/w, dcy = (day - dw*cy)/w;
+    double dc1x = (da1x - dw1*cx - w1*dcx - dw*c1x)/w;
+    double dc1y = (da1y - dw1*cy - w1*dcy - dw*c1y)/w;
+
+    c = DeriVector2(cx, cy, dcx, dcy);
+    c1 = DeriVector2(c1x, c1y, dc1x, dc1y);
+    c2 = DeriVector2(c2x, c2y);
 }
 
 int BSpline::PushOwnParams(VEC_pD &pvec)
@@ -166,11 +166,29 @@ namespace GCS
     class MajorRadiusConic: public Curve
     {
     public:
+        MajorRadiusConic(){derived.hasFocal=false;derived.hasRadMaj=false;}
         virtual ~MajorRadiusConic(){}
         virtual double getRadMaj(const DeriVector2 &center, const DeriVector2 &f1, double b, double db, double &ret_dRadMaj) const = 0;
         virtual double getRadMaj(double* derivparam, double &ret_dRadMaj) const = 0;
         virtual double getRadMaj() const = 0;
         //DeriVector2 CalculateNormal(Point &p, double* derivparam = 0) = 0;
+        //normalized major axis (from center to focus1), as f1.subtr(center).getNormalized()
+        DeriVector2 getMajorAxis(const DeriVector2 &center, const DeriVector2 &f1) const;
+    protected:
+        // Values derived from the center, the focus and the minor radius, recomputed only
+        // when these change, so that the error and all the gradients of a constraint in
+        // an iteration share the square roots. The derivatives are obtained from them
+        // without any. Each copy of the curve has its own (see ParamView).
+        struct DerivedQuantities {
+            bool hasFocal, hasRadMaj;
+            double cx, cy, fx, fy, b;  // the values the quantities are derived from
+            double cfx, cfy, cf2, cf;  // focal vector f1-c, its squared length and length
+            double emajx, emajy;       // major axis, (0,0) if cf is zero
+            double radmaj;
+        };
+        mutable DerivedQuantities derived;
+        const DerivedQuantities &getDerived(const DeriVector2 &center, const DeriVector2 &f1, const double *b) const;
+        virtual double radMaj(double cf2, double b) const = 0; // from the squared focal distance
     };
 
     class Ellipse: public MajorRadiusConic
@@ -189,6 +207,8 @@ namespace GCS
         virtual int PushOwnParams(VEC_pD &pvec) override;
         virtual void ReconstructOnNewPvec (VEC_pD &pvec, int &cnt) override;
         virtual Ellipse* Copy() override;
+    protected:
+        virtual double radMaj(double cf2, double b) const override;
     };
 
     class ArcOfEllipse: public Ellipse
@@ -225,6 +245,8 @@ namespace GCS
         virtual int PushOwnParams(VEC_pD &pvec) override;
         virtual void ReconstructOnNewPvec (VEC_pD &pvec, int &cnt) override;
         virtual Hyperbola* Copy() override;
+    protected:
+        virtual double radMaj(double cf2, double b) const override;
     };
 
     class ArcOfHyperbola: public Hyperbola
@@ -276,7 +298,7 @@ namespace GCS
     class BSpline: public Curve
     {
     public:
-        BSpline(){periodic=false;degree=2;}
+        BSpline(){periodic=false;degree=2;basisSpan=-1;basisU=0;}
         virtual ~BSpline(){}
         // parameters
         VEC_P poles;
@@ -294,10 +316,37 @@ namespace GCS
         VEC_I knotpointGeoids; // geoids of knotpoints as to index Geom array
         // interface helpers
         DeriVector2 CalculateNormal(const Point &p, const double* derivparam = 0) const override;
+        // de Boor evaluation of the rational spline, the knots are taken as fixed
+        // (their derivatives are not computed)
         virtual DeriVector2 Value(double u, double du, const double* derivparam = 0) const override;
+        // derivative of Value by u, same arguments
+        DeriVector2 Tangent(double u, double du, const double* derivparam = 0) const;
         virtual int PushOwnParams(VEC_pD &pvec) override;
         virtual void ReconstructOnNewPvec (VEC_pD &pvec, int &cnt) override;
         virtual BSpline* Copy() override;
+    private:
+        // The flattened knot vector, each knot repeated by its multiplicity and padded
+        // by a period on both ends if periodic: the index in knots of each entry and
+        // the number of periods to add to it. Built on first use, as the multiplicities
+        // and the degree are not solver parameters.
+        mutable VEC_I flatKnots;
+        mutable VEC_I flatPeriods;
+        void flatten() const;
+        double flatKnot(int i) const;
+        // Knot span and basis functions (with their first and second derivatives by u)
+        // of the last evaluation, reused while u and the knots the basis depends on are
+        // unchanged, which is the case for all the gradients of an iteration. Each copy
+        // of the spline has its own cache, so a copy must be evaluated by one thread at
+        // a time, as the copies held by a ParamView are.
+        mutable double basisU;
+        mutable int basisSpan;
+        mutable VEC_D basisKnots; // the 2*degree knots around the span
+        mutable VEC_D basis, basis1, basis2;
+        mutable VEC_D ndu, left, right, a; // buffers of the computation
+        void updateBasis(double u) const;
+        // C(u) and C'(u) with their derivatives on derivparam except through u, and C''(u)
+        void evaluate(double u, const double* derivparam,
+                      DeriVector2 &c, DeriVector2 &c1, DeriVector2 &c2) const;
     };
 
 } //namespace GCS
@@ -0,0 +1,64 @@
+/***************************************************************************
+ *   Copyright (c) 2025 PlaneGCS developers                                *
+ *                                                                         *
+ *   This file is part of the FreeCAD CAx development system.              *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU Library General Public           *
+ *   License as published by the Free Software Foundation; either          *
+ *   version 2 of the License, or (at your option) any later version.      *
+ *                                                                         *
+ *   This library  is distributed in the hope that it will be useful,      *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU Library General Public License for more details.                  *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this library; see the file COPYING.LIB. If not,    *
+ *   write to the Free Software Foundation, Inc., 59 Temple Place,         *
+ *   Suite 330, Boston, MA  02111-1307, USA                                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "SolutionCache.h"
+
+namespace GCS
+{
+
+const VEC_D *SolutionCache::find(std::size_t key, std::size_t structure, const VEC_D &inputs)
+{
+    std::unordered_map<std::size_t, std::list<Entry>::iterator>::const_iterator it = index.find(key);
+    if (it == index.end() || it->second->structure != structure || it->second->inputs != inputs)
+        return NULL;
+    entries.splice(entries.begin(), entries, it->second);
+    return &entries.front().solution;
+}
+
+void SolutionCache::store(std::size_t key, std::size_t structure, const VEC_D &inputs,
+                          const VEC_D &solution, int capacity)
+{
+    std::unordered_map<std::size_t, std::list<Entry>::iterator>::iterator it = index.find(key);
+    if (it != index.end())
+        entries.splice(entries.begin(), entries, it->second);
+    else {
+        entries.push_front(Entry());
+        entries.front().key = key;
+        index[key] = entries.begin();
+    }
+    entries.front().structure = structure;
+    entries.front().inputs = inputs;
+    entries.front().solution = solution;
+
+    while (int(entries.size()) > capacity) {
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+}
+
+void SolutionCache::clear()
+{
+    entries.clear();
+    index.clear();
+}
+
+} //namespace GCS
@@ -0,0 +1,63 @@
+/***************************************************************************
+ *   Copyright (c) 2025 PlaneGCS developers                                *
+ *                                                                         *
+ *   This file is part of the FreeCAD CAx development system.              *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU Library General Public           *
+ *   License as published by the Free Software Foundation; either          *
+ *   version 2 of the License, or (at your option) any later version.      *
+ *                                                                         *
+ *   This library  is distributed in the hope that it will be useful,      *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU Library General Public License for more details.                  *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this library; see the file COPYING.LIB. If not,    *
+ *   write to the Free Software Foundation, Inc., 59 Temple Place,         *
+ *   Suite 330, Boston, MA  02111-1307, USA                                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PLANEGCS_SOLUTIONCACHE_H
+#define PLANEGCS_SOLUTIONCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include "Util.h"
+
+namespace GCS
+{
+
+    // Bounded LRU cache of the solutions of components (see System::solutionCacheSize).
+    // An entry is stored under a hash key, and is only found again for the structure
+    // key and the inputs it was stored with, so that two components whose hash keys
+    // collide never take each other's solution.
+    class SolutionCache
+    {
+    private:
+        struct Entry
+        {
+            std::size_t key, structure;
+            VEC_D inputs;   // compared on a match of the key
+            VEC_D solution;
+        };
+        std::list<Entry> entries; // most recently used first
+        std::unordered_map<std::size_t, std::list<Entry>::iterator> index;
+    public:
+        // the solution stored for key, structure and inputs, which becomes the most
+        // recently used one, or NULL if there is none
+        const VEC_D *find(std::size_t key, std::size_t structure, const VEC_D &inputs);
+        // stores solution, replacing the entry of key if any, and drops the least
+        // recently used entries beyond capacity
+        void store(std::size_t key, std::size_t structure, const VEC_D &inputs,
+                   const VEC_D &solution, int capacity);
+        int size() const { return int(entries.size()); }
+        void clear();
+    };
+
+} //namespace GCS
+
+#endif // PLANEGCS_SOLUTIONCACHE_H
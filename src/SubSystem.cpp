@@ -20,33 +20,46 @@
  *                                                                         *
  ***************************************************************************/
 
+#include <algorithm>
 #include <iostream>
 #include <iterator>
+#include <cmath>
 #include "SubSystem.h"
 
 namespace GCS
 {
 
 // SubSystem
-SubSystem::SubSystem(std::vector<Constraint *> &clist_, VEC_pD &params)
-: clist(clist_)
+SubSystem::SubSystem(const std::vector<Constraint *> &clist_, const VEC_pD &params)
+: clist(clist_), pool(NULL), residualErr(0.), isResidualValid(false), isRedirected(false),
+  isScaled(false)
 {
     MAP_pD_pD dummymap;
-    initialize(params, dummymap);
+    initialize(params, dummymap, dummymap);
 }
 
-SubSystem::SubSystem(std::vector<Constraint *> &clist_, VEC_pD &params,
-                     MAP_pD_pD &reductionmap)
-: clist(clist_)
+SubSystem::SubSystem(const std::vector<Constraint *> &clist_, const VEC_pD &params,
+                     const MAP_pD_pD &reductionmap)
+: clist(clist_), pool(NULL), residualErr(0.), isResidualValid(false), isRedirected(false),
+  isScaled(false)
 {
-    initialize(params, reductionmap);
+    initialize(params, reductionmap, MAP_pD_pD());
+}
+
+SubSystem::SubSystem(const std::vector<Constraint *> &clist_, const VEC_pD &params,
+                     const MAP_pD_pD &reductionmap, const MAP_pD_pD &locations)
+: clist(clist_), pool(NULL), residualErr(0.), isResidualValid(false), isRedirected(false),
+  isScaled(false)
+{
+    initialize(params, reductionmap, locations);
 }
 
 SubSystem::~SubSystem()
 {
 }
 
-void SubSystem::initialize(VEC_pD &params, MAP_pD_pD &reductionmap)
+void SubSystem::initialize(const VEC_pD &params, const MAP_pD_pD &reductionmap,
+                           const MAP_pD_pD &locations)
 {
     csize = static_cast<int>(clist.size());
 
@@ -58,7 +71,6 @@ void SubSystem::initialize(VEC_pD &params, MAP_pD_pD &reductionmap)
         SET_pD s2;
         for (std::vector<Constraint *>::iterator constr=clist.begin();
              constr != clist.end(); ++constr) {
-            (*constr)->revertParams(); // ensure that the constraint points to the original parameters
             VEC_pD constr_params = (*constr)->params();
             s2.insert(constr_params.begin(), constr_params.end());
         }
@@ -98,18 +110,28 @@ void SubSystem::initialize(VEC_pD &params, MAP_pD_pD &reductionmap)
     psize = static_cast<int>(plist.size());
     pvals.resize(psize);
     pmap.clear();
-    for (int j=0; j < psize; j++) {
+    for (int j=0; j < psize; j++)
         pmap[plist[j]] = &pvals[j];
-        pvals[j] = *plist[j];
-    }
     for (MAP_pD_I::const_iterator itr=rindex.begin(); itr != rindex.end(); ++itr)
         pmap[itr->first] = &pvals[itr->second];
 
+    smap.clear();
+    for (MAP_pD_pD::const_iterator p=pmap.begin(); p != pmap.end(); ++p) {
+        MAP_pD_pD::const_iterator loc = locations.find(p->first);
+        smap[loc != locations.end() ? loc->second : p->first] = p->second;
+    }
+    for (int j=0; j < psize; j++) {
+        MAP_pD_pD::const_iterator loc = locations.find(plist[j]);
+        pvals[j] = *(loc != locations.end() ? loc->second : plist[j]);
+    }
+
     c2p.clear();
     p2c.clear();
+    c2pindex.assign(csize, VEC_I());
+    c2poffset.assign(csize + 1, 0);
+    int i=0;
     for (std::vector<Constraint *>::iterator constr=clist.begin();
-         constr != clist.end(); ++constr) {
-        (*constr)->revertParams(); // ensure that the constraint points to the original parameters
+         constr != clist.end(); ++constr, i++) {
         VEC_pD constr_params_orig = (*constr)->params();
         SET_pD constr_params;
         for (VEC_pD::const_iterator p=constr_params_orig.begin();
@@ -123,31 +145,47 @@ void SubSystem::initialize(VEC_pD &params, MAP_pD_pD &reductionmap)
 //            jacobi.set(*constr, *p, 0.);
             c2p[*constr].push_back(*p);
             p2c[*p].push_back(*constr);
+            c2pindex[i].push_back(int(*p - &pvals[0]));
+        }
+        c2poffset[i+1] = c2poffset[i] + int(c2pindex[i].size());
+    }
+
+    // the views are bound once, pvals is not reallocated after this point
+    views.resize(csize);
+    locatedViews.clear();
+    if (locations.empty()) {
+        for (i=0; i < csize; i++)
+            clist[i]->bind(views[i], pmap);
+    }
+    else {
+        // the parameters out of pmap are read from their locations as well
+        MAP_pD_pD bindmap(locations);
+        for (MAP_pD_pD::const_iterator p=pmap.begin(); p != pmap.end(); ++p)
+            bindmap[p->first] = p->second;
+        locatedViews.resize(csize);
+        for (i=0; i < csize; i++) {
+            clist[i]->bind(views[i], bindmap);
+            clist[i]->bind(locatedViews[i], locations);
         }
-//        (*constr)->redirectParams(pmap); // redirect parameters to pvec
     }
 }
 
 void SubSystem::redirectParams()
 {
     // copying values to pvals
-    for (MAP_pD_pD::const_iterator p=pmap.begin();
-         p != pmap.end(); ++p)
+    for (MAP_pD_pD::const_iterator p=smap.begin();
+         p != smap.end(); ++p)
         *(p->second) = *(p->first);
 
-    // redirect constraints to point to pvals
-    for (std::vector<Constraint *>::iterator constr=clist.begin();
-         constr != clist.end(); ++constr) {
-        (*constr)->revertParams();  // this line will normally not be necessary
-        (*constr)->redirectParams(pmap);
-    }
+    // from now on the constraints are evaluated through views on pvals
+    isRedirected = true;
+    isResidualValid = false;
 }
 
 void SubSystem::revertParams()
 {
-    for (std::vector<Constraint *>::iterator constr=clist.begin();
-         constr != clist.end(); ++constr)
-        (*constr)->revertParams();
+    isRedirected = false;
+    isResidualValid = false;
 }
 
 void SubSystem::getParamMap(MAP_pD_pD &pmapOut)
@@ -160,7 +198,7 @@ void SubSystem::getParamList(VEC_pD &plistOut)
     plistOut = plist;
 }
 
-void SubSystem::getParams(VEC_pD &params, Eigen::VectorXd &xOut)
+void SubSystem::getParams(const VEC_pD &params, Eigen::VectorXd &xOut)
 {
     if (xOut.size() != int(params.size()))
         xOut.setZero(params.size());
@@ -182,7 +220,7 @@ void SubSystem::getParams(Eigen::VectorXd &xOut)
         xOut[i] = pvals[i];
 }
 
-void SubSystem::setParams(VEC_pD &params, Eigen::VectorXd &xIn)
+void SubSystem::setParams(const VEC_pD &params, Eigen::VectorXd &xIn)
 {
     assert(xIn.size() == int(params.size()));
     for (int j=0; j < int(params.size()); j++) {
@@ -191,6 +229,7 @@ void SubSystem::setParams(VEC_pD &params, Eigen::VectorXd &xIn)
         if (pmapfind != pmap.end())
             *(pmapfind->second) = xIn[j];
     }
+    isResidualValid = false;
 }
 
 void SubSystem::setParams(Eigen::VectorXd &xIn)
@@ -198,6 +237,7 @@ void SubSystem::setParams(Eigen::VectorXd &xIn)
     assert(xIn.size() == psize);
     for (int i=0; i < psize; i++)
         pvals[i] = xIn[i];
+    isResidualValid = false;
 }
 
 void SubSystem::getConstraintList(std::vector<Constraint *> &clist_)
@@ -205,41 +245,61 @@ void SubSystem::getConstraintList(std::vector<Constraint *> &clist_)
     clist_= clist;
 }
 
+// Evaluates every constraint once. While the constraints point to pvals the result
+// is kept until the values change, so that error() followed by calcGrad() (as in
+// BFGS and lineSearch) does not evaluate them again.
+void SubSystem::evalResidual()
+{
+    if (isResidualValid)
+        return;
+
+    residual.resize(csize);
+    forRows([this](int begin, int end) {
+        for (int i=begin; i < end; i++)
+            residual[i] = isScaled ? rowScale[i]*clist[i]->error(cview(i)) : clist[i]->error(cview(i));
+    });
+    residualErr = 0.;
+    for (int i=0; i < csize; i++)
+        residualErr += residual[i]*residual[i];
+    residualErr *= 0.5;
+    // the original parameters may change without notice
+    isResidualValid = isRedirected;
+}
+
+void SubSystem::evalJacobiEntries()
+{
+    Eigen::VectorXd &jvals = workspace.jvals;
+    jvals.resize(c2poffset[csize]);
+    forRows([this, &jvals](int begin, int end) {
+        for (int i=begin; i < end; i++) {
+            const VEC_I &cparams = c2pindex[i];
+            for (int k=0; k < int(cparams.size()); k++)
+                jvals[c2poffset[i] + k] = clist[i]->grad(cview(i), &pvals[cparams[k]]);
+        }
+    });
+}
+
 double SubSystem::error()
 {
-    double err = 0.;
-    for (std::vector<Constraint *>::const_iterator constr=clist.begin();
-         constr != clist.end(); ++constr) {
-        double tmp = (*constr)->error();
-        err += tmp*tmp;
-    }
-    err *= 0.5;
-    return err;
+    evalResidual();
+    return residualErr;
 }
 
 void SubSystem::calcResidual(Eigen::VectorXd &r)
 {
     assert(r.size() == csize);
 
-    int i=0;
-    for (std::vector<Constraint *>::const_iterator constr=clist.begin();
-         constr != clist.end(); ++constr, i++) {
-        r[i] = (*constr)->error();
-    }
+    evalResidual();
+    r = residual;
 }
 
 void SubSystem::calcResidual(Eigen::VectorXd &r, double &err)
 {
     assert(r.size() == csize);
 
-    int i=0;
-    err = 0.;
-    for (std::vector<Constraint *>::const_iterator constr=clist.begin();
-         constr != clist.end(); ++constr, i++) {
-        r[i] = (*constr)->error();
-        err += r[i]*r[i];
-    }
-    err *= 0.5;
+    evalResidual();
+    r = residual;
+    err = residualErr;
 }
 
 /*
@@ -260,49 +320,257 @@ void SubSystem::calcJacobi()
 
 void SubSystem::calcJacobi(VEC_pD &params, Eigen::MatrixXd &jacobi)
 {
-    jacobi.setZero(csize, params.size());
+    // position of each element of pvals in params, -1 if it is not there
+    VEC_I &pcols = workspace.pcols;
+    pcols.assign(psize, -1);
     for (int j=0; j < int(params.size()); j++) {
         MAP_pD_pD::const_iterator
           pmapfind = pmap.find(params[j]);
         if (pmapfind != pmap.end())
-            for (int i=0; i < csize; i++)
-                jacobi(i,j) = clist[i]->grad(pmapfind->second);
+            pcols[pmapfind->second - &pvals[0]] = j;
     }
+
+    // only the parameters of a constraint have a nonzero derivative
+    jacobi.setZero(csize, params.size());
+    forRows([this, &pcols, &jacobi](int begin, int end) {
+        for (int i=begin; i < end; i++) {
+            const VEC_I &cparams = c2pindex[i];
+            for (VEC_I::const_iterator p=cparams.begin(); p != cparams.end(); ++p)
+                if (pcols[*p] >= 0)
+                    jacobi(i,pcols[*p]) = clist[i]->grad(cview(i), &pvals[*p]);
+        }
+    });
 }
 
 void SubSystem::calcJacobi(Eigen::MatrixXd &jacobi)
 {
     calcJacobi(plist, jacobi);
+    if (isScaled)
+        jacobi.array().colwise() *= rowScale.array();
 }
 
 void SubSystem::calcGrad(VEC_pD &params, Eigen::VectorXd &grad)
 {
     assert(grad.size() == int(params.size()));
 
-    grad.setZero();
+    // position of each element of pvals in params, -1 if it is not there
+    VEC_I &pcols = workspace.pcols;
+    pcols.assign(psize, -1);
     for (int j=0; j < int(params.size()); j++) {
         MAP_pD_pD::const_iterator
           pmapfind = pmap.find(params[j]);
-        if (pmapfind != pmap.end()) {
-            // assert(p2c.find(pmapfind->second) != p2c.end());
-            std::vector<Constraint *> constrs=p2c[pmapfind->second];
-            for (std::vector<Constraint *>::const_iterator constr = constrs.begin();
-                 constr != constrs.end(); ++constr)
-                grad[j] += (*constr)->error() * (*constr)->grad(pmapfind->second);
+        if (pmapfind != pmap.end())
+            pcols[pmapfind->second - &pvals[0]] = j;
+    }
+
+    // grad = J^T r, with every residual evaluated once; the sums run in
+    // the same order whatever the number of threads
+    evalResidual();
+    evalJacobiEntries();
+    const Eigen::VectorXd &jvals = workspace.jvals;
+    grad.setZero();
+    for (int i=0; i < csize; i++) {
+        const VEC_I &cparams = c2pindex[i];
+        double ri = isScaled ? residual[i]*rowScale[i] : residual[i];
+        for (int k=0; k < int(cparams.size()); k++) {
+            if (pcols[cparams[k]] >= 0)
+                grad[pcols[cparams[k]]] += ri * jvals[c2poffset[i] + k];
         }
     }
 }
 
 void SubSystem::calcGrad(Eigen::VectorXd &grad)
 {
-    calcGrad(plist, grad);
+    assert(grad.size() == psize);
+
+    evalResidual();
+    evalJacobiEntries();
+    const Eigen::VectorXd &jvals = workspace.jvals;
+    grad.setZero();
+    for (int i=0; i < csize; i++) {
+        const VEC_I &cparams = c2pindex[i];
+        double ri = isScaled ? residual[i]*rowScale[i] : residual[i];
+        for (int k=0; k < int(cparams.size()); k++)
+            grad[cparams[k]] += ri * jvals[c2poffset[i] + k];
+    }
+}
+
+void SubSystem::multJacobi(const Eigen::VectorXd &v, Eigen::VectorXd &Jv)
+{
+    assert(v.size() == psize);
+
+    Jv.resize(csize);
+    forRows([this, &v, &Jv](int begin, int end) {
+        for (int i=begin; i < end; i++) {
+            double sum = 0.;
+            const VEC_I &cparams = c2pindex[i];
+            for (VEC_I::const_iterator p=cparams.begin(); p != cparams.end(); ++p)
+                sum += clist[i]->grad(cview(i), &pvals[*p]) * v[*p];
+            Jv[i] = isScaled ? rowScale[i]*sum : sum;
+        }
+    });
+}
+
+void SubSystem::multJacobiTransposed(const Eigen::VectorXd &w, Eigen::VectorXd &JTw)
+{
+    assert(w.size() == csize);
+
+    evalJacobiEntries();
+    const Eigen::VectorXd &jvals = workspace.jvals;
+    JTw.setZero(psize);
+    for (int i=0; i < csize; i++) {
+        double wi = isScaled ? rowScale[i]*w[i] : w[i];
+        const VEC_I &cparams = c2pindex[i];
+        for (int k=0; k < int(cparams.size()); k++)
+            JTw[cparams[k]] += jvals[c2poffset[i] + k] * wi;
+    }
+}
+
+void SubSystem::calcJacobi(Eigen::SparseMatrix<double> &jacobi)
+{
+    evalJacobiEntries();
+    const Eigen::VectorXd &jvals = workspace.jvals;
+    std::vector<Eigen::Triplet<double> > entries;
+    entries.reserve(jvals.size());
+    for (int i=0; i < csize; i++) {
+        double si = isScaled ? rowScale[i] : 1.;
+        const VEC_I &cparams = c2pindex[i];
+        for (int k=0; k < int(cparams.size()); k++)
+            entries.push_back(Eigen::Triplet<double>(i, cparams[k], si*jvals[c2poffset[i] + k]));
+    }
+    jacobi.resize(csize, psize);
+    jacobi.setFromTriplets(entries.begin(), entries.end());
+}
+
+// max number of unknowns of a block of factorBlockJacobi
+static const int maxBlockSize = 8;
+
+void SubSystem::factorBlockJacobi()
+{
+    SolverWorkspace &ws = workspace;
+
+    // the blocks only depend on the structure of the subsystem
+    if (int(ws.blockOf.size()) != psize) {
+        ws.blockOf.assign(psize, -1);
+        ws.blockPos.assign(psize, 0);
+        ws.blockStart.assign(1, 0);
+        ws.blockParams.clear();
+        ws.factorStart.assign(1, 0);
+        for (int i=0; i < csize; i++) {
+            const VEC_I &cparams = c2pindex[i];
+            bool isNewBlock = true;
+            for (int k=0; k < int(cparams.size()); k++) {
+                int p = cparams[k];
+                if (ws.blockOf[p] != -1)
+                    continue;
+                int size = int(ws.blockParams.size()) - ws.blockStart.back();
+                if (size == maxBlockSize || (size > 0 && isNewBlock)) {
+                    ws.factorStart.push_back(ws.factorStart.back() + size*size);
+                    ws.blockStart.push_back(int(ws.blockParams.size()));
+                    size = 0;
+                }
+                ws.blockOf[p] = int(ws.blockStart.size()) - 1;
+                ws.blockPos[p] = size;
+                ws.blockParams.push_back(p);
+                isNewBlock = false;
+            }
+        }
+        int size = int(ws.blockParams.size()) - ws.blockStart.back();
+        if (size > 0) {
+            ws.factorStart.push_back(ws.factorStart.back() + size*size);
+            ws.blockStart.push_back(int(ws.blockParams.size()));
+        }
+    }
+
+    // diagonal blocks of J^T J, lower triangles only
+    evalJacobiEntries();
+    const Eigen::VectorXd &jvals = ws.jvals;
+    Eigen::VectorXd &F = ws.blockFactors;
+    F.setZero(ws.factorStart.back());
+    for (int i=0; i < csize; i++) {
+        double si2 = isScaled ? rowScale[i]*rowScale[i] : 1.;
+        const VEC_I &cparams = c2pindex[i];
+        for (int k=0; k < int(cparams.size()); k++) {
+            int b = ws.blockOf[cparams[k]];
+            int n = ws.blockStart[b+1] - ws.blockStart[b];
+            double jk = si2*jvals[c2poffset[i] + k];
+            for (int l=0; l < int(cparams.size()); l++) {
+                if (ws.blockOf[cparams[l]] == b && ws.blockPos[cparams[l]] <= ws.blockPos[cparams[k]])
+                    F[ws.factorStart[b] + n*ws.blockPos[cparams[k]] + ws.blockPos[cparams[l]]] +=
+                        jk*jvals[c2poffset[i] + l];
+            }
+        }
+    }
+
+    // Cholesky factorization of each block, the pivots are kept above a small
+    // fraction of the largest diagonal entry so that singular blocks stay usable
+    for (int b=0; b+1 < int(ws.blockStart.size()); b++) {
+        int n = ws.blockStart[b+1] - ws.blockStart[b];
+        double *A = &F[ws.factorStart[b]];
+        double maxDiag = 0.;
+        for (int j=0; j < n; j++)
+            maxDiag = std::max(maxDiag, A[n*j + j]);
+        double minPivot = maxDiag > 0. ? 1e-10*maxDiag : 1.;
+        for (int j=0; j < n; j++) {
+            double d = A[n*j + j];
+            for (int k=0; k < j; k++)
+                d -= A[n*j + k]*A[n*j + k];
+            A[n*j + j] = std::sqrt(std::max(d, minPivot));
+            for (int i=j+1; i < n; i++) {
+                double v = A[n*i + j];
+                for (int k=0; k < j; k++)
+                    v -= A[n*i + k]*A[n*j + k];
+                A[n*i + j] = v/A[n*j + j];
+            }
+        }
+    }
+}
+
+void SubSystem::solveBlockJacobi(const Eigen::VectorXd &s, Eigen::VectorXd &z)
+{
+    assert(s.size() == psize);
+
+    const SolverWorkspace &ws = workspace;
+    z.resize(psize);
+    double y[maxBlockSize];
+    for (int b=0; b+1 < int(ws.blockStart.size()); b++) {
+        int n = ws.blockStart[b+1] - ws.blockStart[b];
+        const int *params = &ws.blockParams[ws.blockStart[b]];
+        const double *L = &ws.blockFactors[ws.factorStart[b]];
+        for (int i=0; i < n; i++) { // L y = s
+            double v = s[params[i]];
+            for (int k=0; k < i; k++)
+                v -= L[n*i + k]*y[k];
+            y[i] = v/L[n*i + i];
+        }
+        for (int i=n-1; i >= 0; i--) { // L^T z = y
+            double v = y[i];
+            for (int k=i+1; k < n; k++)
+                v -= L[n*k + i]*y[k];
+            y[i] = v/L[n*i + i];
+        }
+        for (int i=0; i < n; i++)
+            z[params[i]] = y[i];
+    }
+}
+
+void SubSystem::calcDerivative(double *param, Eigen::VectorXd &dr)
+{
+    dr.resize(csize);
+    for (int i=0; i < csize; i++)
+        dr[i] = clist[i]->grad(cview(i), param);
+    if (isScaled)
+        dr.array() *= rowScale.array();
 }
 
 double SubSystem::maxStep(VEC_pD &params, Eigen::VectorXd &xdir)
 {
     assert(xdir.size() == int(params.size()));
 
-    MAP_pD_D dir;
+    // the keys are the same on every call, the map is kept to avoid allocations
+    MAP_pD_D &dir = workspace.dir;
+    for (MAP_pD_D::iterator it=dir.begin(); it != dir.end(); ++it)
+        it->second = 0.;
     for (int j=0; j < int(params.size()); j++) {
         MAP_pD_pD::const_iterator pmapfind = pmap.find(params[j]);
         if (pmapfind != pmap.end())
@@ -310,9 +578,8 @@ double SubSystem::maxStep(VEC_pD &params, Eigen::VectorXd &xdir)
     }
 
     double alpha=1e10;
-    for (std::vector<Constraint *>::iterator constr=clist.begin();
-         constr != clist.end(); ++constr)
-        alpha = (*constr)->maxStep(dir, alpha);
+    for (int i=0; i < csize; i++)
+        alpha = clist[i]->maxStep(cview(i), dir, alpha);
 
     return alpha;
 }
@@ -322,10 +589,59 @@ double SubSystem::maxStep(Eigen::VectorXd &xdir)
     return maxStep(plist, xdir);
 }
 
+bool SubSystem::equilibrate()
+{
+    // scales are powers of two, so that scaling is exact
+    static const int sweeps = 4;
+    static const double maxScale = 8192.;
+    static const double minGain = 4.;
+
+    isScaled = false;
+    isResidualValid = false;
+    if (psize == 0 || csize == 0)
+        return false;
+
+    Eigen::MatrixXd &J = workspace.J;
+    redirectParams();
+    calcJacobi(J);
+    revertParams();
+
+    rowScale.setOnes(csize);
+    for (int k=0; k < sweeps; k++) {
+        for (int i=0; i < csize; i++) {
+            double norm = J.row(i).lpNorm<Eigen::Infinity>();
+            if (norm > 0.) {
+                double s = std::exp2(std::round(-0.5*std::log2(norm)));
+                J.row(i) *= s;
+                rowScale[i] *= s;
+            }
+        }
+        for (int j=0; j < psize; j++) {
+            double norm = J.col(j).lpNorm<Eigen::Infinity>();
+            if (norm > 0.) {
+                double s = std::exp2(std::round(-0.5*std::log2(norm)));
+                J.col(j) *= s;
+            }
+        }
+    }
+
+    // the column factors only serve the sweeps: scaling the unknowns as well
+    // slowed BFGS down on under-determined sketches, without a gain for LM
+    rowScale /= rowScale.minCoeff();
+    rowScale = rowScale.cwiseMin(maxScale);
+
+    // not worth it for balanced rows
+    if (rowScale.maxCoeff() < minGain)
+        return false;
+
+    isScaled = true;
+    return true;
+}
+
 void SubSystem::applySolution()
 {
-    for (MAP_pD_pD::const_iterator it=pmap.begin();
-         it != pmap.end(); ++it)
+    for (MAP_pD_pD::const_iterator it=smap.begin();
+         it != smap.end(); ++it)
         *(it->first) = *(it->second);
 }
 
@@ -344,7 +660,7 @@ void SubSystem::printResidual()
     double err = 0.;
     for (std::vector<Constraint *>::const_iterator constr=clist.begin();
          constr != clist.end(); ++constr, i++) {
-        r[i] = (*constr)->error();
+        r[i] = (*constr)->error(cview(i));
         err += r[i]*r[i];
     }
     err *= 0.5;
@@ -27,11 +27,44 @@
 #undef max
 
 #include <Eigen/Core>
+#include <Eigen/LU>
+#include <Eigen/Cholesky>
+#include <Eigen/Sparse>
 #include "Constraints.h"
+#include "AnalyticSolver.h"
+#include "qp_eq.h"
+#include "ThreadPool.h"
 
 namespace GCS
 {
 
+    // Buffers of the solvers, kept by each subsystem between its solves, so that
+    // solving again with the same sizes (e.g. while dragging) does not allocate.
+    struct SolverWorkspace
+    {
+        Eigen::VectorXd x, x0, x_new, xbest, xdir, xdir1, grad, h, y, Dy, Bh;
+        Eigen::VectorXd g, fx, fx_new, Jh, Ah, h_sd, h_gn, h_dl, b, diag, c;
+        Eigen::VectorXd resA, lambda, lambda0, lambdadir;
+        Eigen::VectorXd xls0, xls;   // lineSearch
+        Eigen::VectorXd r, s, z, d, Jd; // conjugate gradients of solve_NK
+        Eigen::VectorXd jvals;       // nonzero jacobian entries, row by row in the order of c2pindex
+        Eigen::MatrixXd A, B, D, J, J_new, JJt, Y, Z;
+        Eigen::FullPivLU<Eigen::MatrixXd> lu, luJJt;
+        Eigen::LDLT<Eigen::MatrixXd> ldlt;
+        Eigen::SparseMatrix<double> Js, JtJ;
+        Eigen::IncompleteCholesky<double> ic; // optional preconditioner of solve_NK
+        // block-Jacobi preconditioner of solve_NK: the unknowns of block b are
+        // blockParams[blockStart[b]..blockStart[b+1]), its Cholesky factor is
+        // stored row by row from blockFactors[factorStart[b]]
+        VEC_I blockOf, blockPos, blockStart, blockParams, factorStart;
+        Eigen::VectorXd blockFactors;
+        QPWorkspace qp;
+        VEC_pD plistAB;              // parameters of the subsystem and its auxiliary one
+        MAP_pD_D dir;                // directions of maxStep
+        VEC_I pcols;                 // columns of calcGrad
+        AnalyticPattern pattern;
+    };
+
     class SubSystem
     {
     private:
@@ -39,15 +72,41 @@ namespace GCS
         std::vector<Constraint *> clist;
         VEC_pD plist;      // pointers to the original parameters
         MAP_pD_pD pmap;    // redirection map from the original parameters to pvals
+        MAP_pD_pD smap;    // from where the values of the original parameters are kept to pvals
         VEC_D pvals;       // current variables vector (psize)
 //        JacobianMatrix jacobi;  // jacobi matrix of the residuals
         std::map<Constraint *,VEC_pD > c2p; // constraint to parameter adjacency list
         std::map<double *,std::vector<Constraint *> > p2c; // parameter to constraint adjacency list
-        void initialize(VEC_pD &params, MAP_pD_pD &reductionmap); // called by the constructors
+        std::vector<VEC_I> c2pindex; // indices in pvals of the parameters of each constraint of clist
+        VEC_I c2poffset;             // position of the entries of each constraint in workspace.jvals
+        // rows are evaluated in chunks by the pool if there is one, and are written to
+        // separate slots, so that the results do not depend on the number of threads
+        ThreadPool *pool;
+        template <typename Body> void forRows(const Body &body); // body(begin, end)
+        void evalJacobiEntries(); // fills workspace.jvals
+        // residuals at the current pvals, shared by error, calcResidual and calcGrad
+        Eigen::VectorXd residual;
+        double residualErr;
+        bool isResidualValid;
+        bool isRedirected;
+        std::vector<ParamView> views; // views[i] binds clist[i] to pvals
+        std::vector<ParamView> locatedViews; // clist[i] on the locations, empty without locations
+        void evalResidual();
+        // equilibration, the solvers see the residuals rowScale*e; all but
+        // calcJacobi with a parameter list are scaled
+        Eigen::VectorXd rowScale;
+        bool isScaled;
+        void initialize(const VEC_pD &params, const MAP_pD_pD &reductionmap,
+                        const MAP_pD_pD &locations); // called by the constructors
     public:
-        SubSystem(std::vector<Constraint *> &clist_, VEC_pD &params);
-        SubSystem(std::vector<Constraint *> &clist_, VEC_pD &params,
-                  MAP_pD_pD &reductionmap);
+        SubSystem(const std::vector<Constraint *> &clist_, const VEC_pD &params);
+        SubSystem(const std::vector<Constraint *> &clist_, const VEC_pD &params,
+                  const MAP_pD_pD &reductionmap);
+        // locations maps the parameters whose values are not kept in the parameters
+        // themselves to where they are kept (see System::fork), the subsystem then
+        // reads and applies the values there
+        SubSystem(const std::vector<Constraint *> &clist_, const VEC_pD &params,
+                  const MAP_pD_pD &reductionmap, const MAP_pD_pD &locations);
         ~SubSystem();
 
         int pSize() { return psize; };
@@ -59,12 +118,33 @@ namespace GCS
         void getParamMap(MAP_pD_pD &pmapOut);
         void getParamList(VEC_pD &plistOut);
 
-        void getParams(VEC_pD &params, Eigen::VectorXd &xOut);
+        void getParams(const VEC_pD &params, Eigen::VectorXd &xOut);
         void getParams(Eigen::VectorXd &xOut);
-        void setParams(VEC_pD &params, Eigen::VectorXd &xIn);
+        void setParams(const VEC_pD &params, Eigen::VectorXd &xIn);
         void setParams(Eigen::VectorXd &xIn);
 
         void getConstraintList(std::vector<Constraint *> &clist_);
+        // the i-th constraint and the view it is evaluated through: on pvals while
+        // redirected, on the original parameters (or their locations) otherwise
+        // (the constraints themselves are never changed)
+        Constraint *constraint(int i) const { return clist[i]; }
+        const ParamView &cview(int i) const
+        { return isRedirected ? views[i] :
+                 locatedViews.empty() ? clist[i]->ownView() : locatedViews[i]; }
+
+        // to be called after writing pvals through the pointers of getParamMap
+        void paramsChanged() { isResidualValid = false; }
+
+        // evaluates the residuals and the jacobian with the pool (null for serially)
+        void setThreadPool(ThreadPool *pool_) { pool = pool_; }
+
+        // Scales the residuals by the row factors of a Ruiz equilibration of the
+        // jacobian at the current values of the original parameters, until
+        // clearScaling. Rows are only scaled up, so that a scaled residual below a
+        // tolerance is an unscaled one below it as well. Returns false (and does not
+        // scale) if the rows are already balanced.
+        bool equilibrate();
+        void clearScaling() { isScaled = false; isResidualValid = false; }
 
         double error();
         void calcResidual(Eigen::VectorXd &r);
@@ -73,10 +153,32 @@ namespace GCS
         void calcJacobi(Eigen::MatrixXd &jacobi);
         void calcGrad(VEC_pD &params, Eigen::VectorXd &grad);
         void calcGrad(Eigen::VectorXd &grad);
+        // products with the jacobian evaluated constraint by constraint, without forming it
+        void multJacobi(const Eigen::VectorXd &v, Eigen::VectorXd &Jv);
+        void multJacobiTransposed(const Eigen::VectorXd &w, Eigen::VectorXd &JTw);
+        void calcJacobi(Eigen::SparseMatrix<double> &jacobi); // scaled, as calcJacobi(jacobi)
+        // Block-Jacobi preconditioner M = L L^T of J^T J, whose diagonal blocks are
+        // summed from the jacobian entries constraint by constraint, so that neither
+        // J nor J^T J is formed. A block holds the unknowns first met together in a
+        // constraint (e.g. the coordinates of a point), at most 8 of them.
+        void factorBlockJacobi();
+        void solveBlockJacobi(const Eigen::VectorXd &s, Eigen::VectorXd &z); // z = M^-1 s
+        // derivatives of the residuals (scaled as well) on a parameter that need not be in plist
+        void calcDerivative(double *param, Eigen::VectorXd &dr);
 
         double maxStep(VEC_pD &params, Eigen::VectorXd &xdir);
         double maxStep(Eigen::VectorXd &xdir);
 
+        SolverWorkspace workspace;
+
+        // variants for the fixed size vectors and matrices of the small subsystem solvers
+        template <typename Derived> void getParams(Eigen::MatrixBase<Derived> &xOut);
+        template <typename Derived> void setParams(const Eigen::MatrixBase<Derived> &xIn);
+        template <typename Derived> void calcResidual(Eigen::MatrixBase<Derived> &r);
+        template <typename Derived> void calcResidual(Eigen::MatrixBase<Derived> &r, double &err);
+        template <typename Derived> void calcJacobi(Eigen::MatrixBase<Derived> &jacobi);
+        template <typename Derived> double maxStep(const Eigen::MatrixBase<Derived> &xdir);
+
         void applySolution();
         void analyse(Eigen::MatrixXd &J, Eigen::MatrixXd &ker, Eigen::MatrixXd &img);
         void report();
@@ -86,6 +188,82 @@ namespace GCS
 
     double lineSearch(SubSystem *subsys, Eigen::VectorXd &xdir);
 
+    template <typename Body>
+    void SubSystem::forRows(const Body &body)
+    {
+        // enough rows per chunk to hide the cost of handing it to a worker, and
+        // few enough to balance constraints of very different costs
+        if (pool)
+            pool->parallelFor(csize, 256, body);
+        else
+            body(0, csize);
+    }
+
+    // pvals[j] holds the value of plist[j], so that no lookup in pmap is needed
+
+    template <typename Derived>
+    void SubSystem::getParams(Eigen::MatrixBase<Derived> &xOut)
+    {
+        for (int i=0; i < psize; i++)
+            xOut[i] = pvals[i];
+    }
+
+    template <typename Derived>
+    void SubSystem::setParams(const Eigen::MatrixBase<Derived> &xIn)
+    {
+        assert(xIn.size() == psize);
+        for (int i=0; i < psize; i++)
+            pvals[i] = xIn[i];
+        isResidualValid = false;
+    }
+
+    template <typename Derived>
+    void SubSystem::calcResidual(Eigen::MatrixBase<Derived> &r)
+    {
+        assert(r.size() == csize);
+        for (int i=0; i < csize; i++)
+            r[i] = clist[i]->error(cview(i));
+        if (isScaled)
+            r.array() *= rowScale.array();
+    }
+
+    template <typename Derived>
+    void SubSystem::calcResidual(Eigen::MatrixBase<Derived> &r, double &err)
+    {
+        assert(r.size() == csize);
+        err = 0.;
+        for (int i=0; i < csize; i++) {
+            r[i] = isScaled ? rowScale[i]*clist[i]->error(cview(i)) : clist[i]->error(cview(i));
+            err += r[i]*r[i];
+        }
+        err *= 0.5;
+    }
+
+    template <typename Derived>
+    void SubSystem::calcJacobi(Eigen::MatrixBase<Derived> &jacobi)
+    {
+        assert(jacobi.rows() == csize && jacobi.cols() == psize);
+        for (int j=0; j < psize; j++)
+            for (int i=0; i < csize; i++)
+                jacobi(i,j) = clist[i]->grad(cview(i), &pvals[j]);
+        if (isScaled)
+            jacobi.array().colwise() *= rowScale.array();
+    }
+
+    template <typename Derived>
+    double SubSystem::maxStep(const Eigen::MatrixBase<Derived> &xdir)
+    {
+        assert(xdir.size() == psize);
+        MAP_pD_D &dir = workspace.dir;
+        for (int j=0; j < psize; j++)
+            dir[&pvals[j]] = xdir[j];
+
+        double alpha=1e10;
+        for (int i=0; i < csize; i++)
+            alpha = clist[i]->maxStep(cview(i), dir, alpha);
+        return alpha;
+    }
+
 } //namespace GCS
 
 #endif // PLANEGCS_SUBSYSTEM_H
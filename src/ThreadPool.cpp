@@ -0,0 +1,116 @@
+/***************************************************************************
+ *   Copyright (c) 2025 PlaneGCS developers                                *
+ *                                                                         *
+ *   This file is part of the FreeCAD CAx development system.              *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU Library General Public           *
+ *   License as published by the Free Software Foundation; either          *
+ *   version 2 of the License, or (at your option) any later version.      *
+ *                                                                         *
+ *   This library  is distributed in the hope that it will be useful,      *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU Library General Public License for more details.                  *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this library; see the file COPYING.LIB. If not,    *
+ *   write to the Free Software Foundation, Inc., 59 Temple Place,         *
+ *   Suite 330, Boston, MA  02111-1307, USA                                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+namespace GCS
+{
+
+ThreadPool::ThreadPool(int threads)
+: stopping(false)
+{
+    if (threads <= 0)
+        threads = std::max(1, int(std::thread::hardware_concurrency()));
+    for (int i=0; i < threads; i++)
+        workers.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (std::size_t i=0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::parallelFor(int n, int chunk, const std::function<void(int, int)> &body)
+{
+    int chunks = (n + chunk - 1)/chunk;
+    int helpers = std::min(chunks - 1, size());
+    if (helpers <= 0) {
+        body(0, n);
+        return;
+    }
+
+    // shared with the helpers, which may only start once all the chunks are taken
+    struct Chunks
+    {
+        std::function<void(int, int)> body;
+        int n, chunk, count;
+        std::atomic<int> next, done;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    std::shared_ptr<Chunks> state = std::make_shared<Chunks>();
+    state->body = body;
+    state->n = n;
+    state->chunk = chunk;
+    state->count = chunks;
+    state->next = 0;
+    state->done = 0;
+
+    std::function<void()> run = [state]() {
+        int k;
+        while ((k = state->next++) < state->count) {
+            state->body(k*state->chunk, std::min(state->n, (k+1)*state->chunk));
+            if (++state->done == state->count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i=0; i < helpers; i++)
+            tasks.push_back(run);
+    }
+    condition.notify_all();
+
+    run();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state]() { return state->done == state->count; });
+}
+
+void ThreadPool::work()
+{
+    while (1) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            // pending tasks are still run, their futures would be broken otherwise
+            if (tasks.empty())
+                return;
+            task = tasks.front();
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+} //namespace GCS
@@ -0,0 +1,95 @@
+/***************************************************************************
+ *   Copyright (c) 2025 PlaneGCS developers                                *
+ *                                                                         *
+ *   This file is part of the FreeCAD CAx development system.              *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU Library General Public           *
+ *   License as published by the Free Software Foundation; either          *
+ *   version 2 of the License, or (at your option) any later version.      *
+ *                                                                         *
+ *   This library  is distributed in the hope that it will be useful,      *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU Library General Public License for more details.                  *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this library; see the file COPYING.LIB. If not,    *
+ *   write to the Free Software Foundation, Inc., 59 Temple Place,         *
+ *   Suite 330, Boston, MA  02111-1307, USA                                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PLANEGCS_THREADPOOL_H
+#define PLANEGCS_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace GCS
+{
+
+    // Flag shared by all the copies of a token, used to cancel a running solve
+    // from another thread. A default constructed token is never cancelled.
+    class CancellationToken
+    {
+    private:
+        std::shared_ptr< std::atomic<bool> > cancelled;
+    public:
+        CancellationToken() : cancelled(std::make_shared< std::atomic<bool> >(false)) {}
+
+        void cancel() { *cancelled = true; }
+        bool isCancelled() const { return *cancelled; }
+    };
+
+    // Fixed set of worker threads executing the submitted tasks in submission order
+    class ThreadPool
+    {
+    private:
+        std::vector<std::thread> workers;
+        std::deque< std::function<void()> > tasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping;
+
+        void work();
+    public:
+        explicit ThreadPool(int threads=0); // 0 means one per hardware thread
+        ~ThreadPool();
+
+        int size() const { return int(workers.size()); }
+
+        // Calls body(begin, end) for the chunks [begin, end) of [0, n), each at most
+        // chunk long, on the calling thread and on the idle workers, and returns once
+        // all are done. The calling thread takes chunks too, so that it is safe to call
+        // from a task of the pool itself.
+        void parallelFor(int n, int chunk, const std::function<void(int, int)> &body);
+
+        template <typename F>
+        std::future<typename std::result_of<F()>::type> submit(F task)
+        {
+            typedef typename std::result_of<F()>::type R;
+            // std::function needs a copyable target
+            std::shared_ptr< std::packaged_task<R()> > packaged =
+                std::make_shared< std::packaged_task<R()> >(task);
+            std::future<R> result = packaged->get_future();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks.push_back([packaged]() { (*packaged)(); });
+            }
+            condition.notify_one();
+            return result;
+        }
+    };
+
+} //namespace GCS
+
+#endif // PLANEGCS_THREADPOOL_H
@@ -27,15 +27,20 @@
 #include <iostream>
 #include <Eigen/QR>
 
+#include "qp_eq.h"
+
 using namespace Eigen;
 
 // minimizes ( 0.5 * x^T * H * x + g^T * x ) under the condition ( A*x + c = 0 )
 // it returns the solution in x, the row-space of A in Y, and the null space of A in Z
 int qp_eq(MatrixXd &H, VectorXd &g, MatrixXd &A, VectorXd &c,
-          VectorXd &x, MatrixXd &Y, MatrixXd &Z)
+          VectorXd &x, MatrixXd &Y, MatrixXd &Z, QPWorkspace &ws)
 {
-    FullPivHouseholderQR<MatrixXd> qrAT(A.transpose());
-    MatrixXd Q = qrAT.matrixQ ();
+    FullPivHouseholderQR<MatrixXd> &qrAT = ws.qrAT;
+    qrAT.compute(A.transpose());
+    ws.workQ.resize(qrAT.rows());
+    qrAT.matrixQ().evalTo(ws.Q, ws.workQ);
+    MatrixXd &Q = ws.Q;
 
     size_t params_num = qrAT.rows();
     size_t constr_num = qrAT.cols();
@@ -48,22 +53,40 @@ int qp_eq(MatrixXd &H, VectorXd &g, MatrixXd &A, VectorXd &c,
     // Q = [Q1,Q2], R=[R1;0]
     // Y = Q1 * inv(R^T) * P^T
     // Z = Q2
-    Y = qrAT.matrixQR().topRows(constr_num)
-                       .triangularView<Upper>()
-                       .transpose()
-                       .solve<OnTheRight>(Q.leftCols(rank))
-        * qrAT.colsPermutation().transpose();
+    ws.Y1 = Q.leftCols(rank);
+    qrAT.matrixQR().topRows(constr_num)
+                   .triangularView<Upper>()
+                   .transpose()
+                   .solveInPlace<OnTheRight>(ws.Y1);
+    Y = ws.Y1 * qrAT.colsPermutation().transpose();
     if (params_num == rank)
-        x = - Y * c;
+        x.noalias() = - Y * c;
     else {
         Z = Q.rightCols(params_num-rank);
 
-        MatrixXd ZTHZ = Z.transpose() * H * Z;
-        VectorXd rhs = Z.transpose() * (H * Y * c - g);
+        ws.HZ.noalias() = H * Z;
+        ws.ZTHZ.noalias() = Z.transpose() * ws.HZ;
+        ws.Yc.noalias() = Y * c;
+        ws.HYc.noalias() = H * ws.Yc;
+        ws.HYc -= g;
+        ws.rhs.noalias() = Z.transpose() * ws.HYc;
 
-        VectorXd y = ZTHZ.colPivHouseholderQr().solve(rhs);
+        // ws.y = ws.ZTHZ.colPivHouseholderQr().solve(ws.rhs), in the buffers of ws
+        ColPivHouseholderQR<MatrixXd> &qr = ws.qrZTHZ;
+        qr.compute(ws.ZTHZ);
+        Index nonzero = qr.nonzeroPivots();
+        ws.rhs.applyOnTheLeft(qr.householderQ().setLength(nonzero).adjoint());
+        qr.matrixQR().topLeftCorner(nonzero, nonzero)
+                     .triangularView<Upper>()
+                     .solveInPlace(ws.rhs.topRows(nonzero));
+        ws.y.resize(qr.cols());
+        for (Index i=0; i < nonzero; ++i)
+            ws.y[qr.colsPermutation().indices().coeff(i)] = ws.rhs[i];
+        for (Index i=nonzero; i < qr.cols(); ++i)
+            ws.y[qr.colsPermutation().indices().coeff(i)] = 0.;
 
-        x = - Y * c + Z * y;
+        x.noalias() = - Y * c;
+        x.noalias() += Z * ws.y;
     }
 
     return 0;
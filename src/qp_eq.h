@@ -19,7 +19,23 @@
  *   Suite 330, Boston, MA  02111-1307, USA                                *
  *                                                                         *
  ***************************************************************************/
+
+#ifndef PLANEGCS_QP_EQ_H
+#define PLANEGCS_QP_EQ_H
+
 #include <Eigen/Dense>
 
+// buffers of qp_eq, kept between calls of the same sizes so that they do not allocate
+struct QPWorkspace
+{
+    Eigen::FullPivHouseholderQR<Eigen::MatrixXd> qrAT;
+    Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qrZTHZ;
+    Eigen::MatrixXd Q, Y1, HZ, ZTHZ;
+    Eigen::RowVectorXd workQ;
+    Eigen::VectorXd Yc, HYc, rhs, y;
+};
+
 int qp_eq(Eigen::MatrixXd &H, Eigen::VectorXd &g, Eigen::MatrixXd &A, Eigen::VectorXd &c,
-          Eigen::VectorXd &x, Eigen::MatrixXd &Y, Eigen::MatrixXd &Z);
+          Eigen::VectorXd &x, Eigen::MatrixXd &Y, Eigen::MatrixXd &Z, QPWorkspace &ws);
+
+#endif // PLANEGCS_QP_EQ_H